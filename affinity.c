@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "rtree.h"
+
+// ---------------- Thread placement and scaling curves ----------------
+//
+// readCpuTopology lists the CPUs this process may run on (its affinity
+// mask) with their package, core and NUMA node from sysfs, and ranks SMT
+// siblings within each core. placeThreads turns a pinning policy into one
+// CPU per thread:
+//
+//   PIN_NONE     no pinning, the scheduler places threads
+//   PIN_COMPACT  fill a core's SMT siblings, then the next core, package
+//                by package
+//   PIN_SCATTER  one thread per core round-robin over the packages, SMT
+//                siblings only once every core has one
+//   PIN_CORES    first SMT sibling of every core only; more threads than
+//                cores wrap around
+//   PIN_LIST     an explicit CPU list ("0,2,8-11"), used round-robin
+//
+// The interactive run reads a policy from the RTREE_PIN environment
+// variable for its thread pool. `rtree_cpu_baseline scaling` sweeps thread
+// counts under every policy and writes throughput and parallel efficiency
+// per point to Log/scaling_curve.json.
+
+#define CPU_SYSFS "/sys/devices/system/cpu"
+
+static const char *const pinNames[] = {"none", "compact", "scatter", "cores", "list"};
+
+static int readSysInt(const char *fmt, int cpu, int fallback)
+{
+    char path[128];
+    snprintf(path, sizeof(path), fmt, cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return fallback;
+    int v;
+    if (fscanf(f, "%d", &v) != 1) v = fallback;
+    fclose(f);
+    return v;
+}
+
+// Parse "0,2,8-11" into out; returns the count
+static int parsePinList(const char *s, int *out, int max)
+{
+    int n = 0;
+    while (*s) {
+        char *e;
+        long a = strtol(s, &e, 10), b = a;
+        if (e == s) break;
+        if (*e == '-') b = strtol(e + 1, &e, 10);
+        for (long c = a; c <= b && n < max; c++) out[n++] = (int)c;
+        if (*e != ',') break;
+        s = e + 1;
+    }
+    return n;
+}
+
+CpuTopology *readCpuTopology(void)
+{
+    CpuTopology *t = (CpuTopology *)calloc(1, sizeof(CpuTopology));
+    cpu_set_t mask;
+    if (!t) {
+        perror("Unable to allocate CPU topology");
+        exit(EXIT_FAILURE);
+    }
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+        CPU_ZERO(&mask);
+        for (int c = 0; c < sysconf(_SC_NPROCESSORS_ONLN) && c < CPU_SETSIZE; c++) CPU_SET(c, &mask);
+    }
+    int n = CPU_COUNT(&mask);
+    t->cpu = (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    t->package = (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    t->core = (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    t->node = (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    t->smt = (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+    if (!t->cpu || !t->package || !t->core || !t->node || !t->smt) {
+        perror("Unable to allocate CPU topology");
+        exit(EXIT_FAILURE);
+    }
+
+    NumaTopology *numa = readNumaTopology();
+    for (int c = 0; c < CPU_SETSIZE && t->numCpus < n; c++) {
+        if (!CPU_ISSET(c, &mask)) continue;
+        int i = t->numCpus++;
+        t->cpu[i] = c;
+        t->package[i] = readSysInt(CPU_SYSFS "/cpu%d/topology/physical_package_id", c, 0);
+        t->core[i] = readSysInt(CPU_SYSFS "/cpu%d/topology/core_id", c, c);
+        t->node[i] = 0;
+        for (int nd = 0; nd < numa->numNodes; nd++)
+            for (int k = numa->cpuStart[nd]; k < numa->cpuStart[nd + 1]; k++)
+                if (numa->cpus[k] == c) t->node[i] = nd;
+    }
+    freeNumaTopology(numa);
+
+    // SMT rank: how many CPUs of the same core come before this one
+    for (int i = 0; i < t->numCpus; i++) {
+        t->smt[i] = 0;
+        for (int j = 0; j < i; j++)
+            if (t->package[j] == t->package[i] && t->core[j] == t->core[i]) t->smt[i]++;
+        if (t->smt[i] == 0) t->numCores++;
+        if (t->smt[i] + 1 > t->threadsPerCore) t->threadsPerCore = t->smt[i] + 1;
+    }
+    return t;
+}
+
+void freeCpuTopology(CpuTopology *t)
+{
+    if (!t) return;
+    free(t->cpu);
+    free(t->package);
+    free(t->core);
+    free(t->node);
+    free(t->smt);
+    free(t);
+}
+
+// "none", "compact", "scatter", "cores", or a CPU list (PIN_LIST); -1 if
+// the string is none of these.
+int parsePinPolicy(const char *s)
+{
+    for (int p = PIN_NONE; p < PIN_LIST; p++)
+        if (strcmp(s, pinNames[p]) == 0) return p;
+    int cpus[4];
+    return parsePinList(s, cpus, 4) > 0 ? PIN_LIST : -1;
+}
+
+const char *pinPolicyName(int policy)
+{
+    return policy >= PIN_NONE && policy <= PIN_LIST ? pinNames[policy] : "?";
+}
+
+static const CpuTopology *sortTopo;
+static int sortPolicy;
+
+// Placement order of two topology entries under sortPolicy
+static int comparePlacement(const void *A, const void *B)
+{
+    const CpuTopology *t = sortTopo;
+    int a = *(const int *)A, b = *(const int *)B;
+    int ka[4], kb[4];
+    if (sortPolicy == PIN_SCATTER) {
+        // Rank of the core within its package, so packages alternate
+        int ra = 0, rb = 0;
+        for (int j = 0; j < t->numCpus; j++) {
+            if (t->smt[j] != 0) continue;
+            ra += t->package[j] == t->package[a] && t->core[j] < t->core[a];
+            rb += t->package[j] == t->package[b] && t->core[j] < t->core[b];
+        }
+        int ka2[4] = {t->smt[a], ra, t->package[a], t->cpu[a]}, kb2[4] = {t->smt[b], rb, t->package[b], t->cpu[b]};
+        memcpy(ka, ka2, sizeof(ka));
+        memcpy(kb, kb2, sizeof(kb));
+    } else {
+        int ka2[4] = {t->package[a], t->core[a], t->smt[a], t->cpu[a]};
+        int kb2[4] = {t->package[b], t->core[b], t->smt[b], t->cpu[b]};
+        memcpy(ka, ka2, sizeof(ka));
+        memcpy(kb, kb2, sizeof(kb));
+    }
+    for (int k = 0; k < 4; k++)
+        if (ka[k] != kb[k]) return (ka[k] > kb[k]) - (ka[k] < kb[k]);
+    return 0;
+}
+
+// CPU for each of numThreads threads (-1: not pinned). `list` is only read
+// for PIN_LIST. Returns the number of distinct CPUs used.
+int placeThreads(const CpuTopology *t, int policy, const char *list, int numThreads, int *out)
+{
+    for (int i = 0; i < numThreads; i++) out[i] = -1;
+    if (policy == PIN_NONE || t->numCpus == 0) return 0;
+    int *order = (int *)malloc((size_t)t->numCpus * sizeof(int));
+    if (!order) {
+        perror("Unable to allocate thread placement");
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    if (policy == PIN_LIST) {
+        n = parsePinList(list ? list : "", order, t->numCpus);
+    } else {
+        for (int i = 0; i < t->numCpus; i++)
+            if (policy != PIN_CORES || t->smt[i] == 0) order[n++] = i;
+        sortTopo = t;
+        sortPolicy = policy;
+        qsort(order, (size_t)n, sizeof(int), comparePlacement);
+        for (int i = 0; i < n; i++) order[i] = t->cpu[order[i]];
+    }
+    for (int i = 0; i < numThreads && n > 0; i++) out[i] = order[i % n];
+    free(order);
+    return n < numThreads ? n : numThreads;
+}
+
+// Pin the calling thread to one CPU
+int pinThreadToCpu(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Placement for the interactive thread pool from RTREE_PIN; NULL (and
+// *policy PIN_NONE) when it is unset or unknown. Free the result.
+int *pinPlacementFromEnv(const CpuTopology *t, int numThreads, int *policy)
+{
+    const char *s = getenv("RTREE_PIN");
+    *policy = s ? parsePinPolicy(s) : PIN_NONE;
+    if (*policy < 0) {
+        fprintf(stderr, "RTREE_PIN=%s not understood, threads are not pinned\n", s);
+        *policy = PIN_NONE;
+    }
+    if (*policy == PIN_NONE) return NULL;
+    int *cpus = (int *)malloc((size_t)numThreads * sizeof(int));
+    if (!cpus) {
+        perror("Unable to allocate thread placement");
+        exit(EXIT_FAILURE);
+    }
+    placeThreads(t, *policy, s, numThreads, cpus);
+    return cpus;
+}
+
+// ---- scaling curve ----
+
+#define SCALING_REPEATS 3
+
+// Sweep 1..maxThreads (every count, or powers of two plus maxThreads when
+// `every` is 0) under each policy; best of SCALING_REPEATS runs per point.
+// lists[p] is the CPU list of policies[p] when that is PIN_LIST.
+void scalingCurve(Node *root, Rect *queries, int numQuery, int maxThreads, const int *policies, int numPolicies,
+                  const char *const *lists, int every, long long expected)
+{
+    CpuTopology *topo = readCpuTopology();
+    int *results = (int *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(int));
+    int *cpus = (int *)malloc((size_t)maxThreads * sizeof(int));
+    if (!results || !cpus) {
+        perror("Unable to allocate scaling buffers");
+        exit(EXIT_FAILURE);
+    }
+    mkdir("Log", 0777);
+    FILE *json = fopen("Log/scaling_curve.json", "w");
+    int ok = 1;
+
+    printf("\n[Scaling curve] %d CPUs available, %d cores, %d threads per core, %d queries\n", topo->numCpus,
+           topo->numCores, topo->threadsPerCore, numQuery);
+    printf("%-8s %8s %6s %10s %12s %9s %11s\n", "policy", "threads", "CPUs", "time (s)", "queries/s", "speedup",
+           "efficiency");
+    if (json)
+        fprintf(json, "{\n  \"cpus\": %d,\n  \"cores\": %d,\n  \"threadsPerCore\": %d,\n  \"queries\": %d,\n"
+                      "  \"points\": [",
+                topo->numCpus, topo->numCores, topo->threadsPerCore, numQuery);
+    int firstPoint = 1;
+    for (int p = 0; p < numPolicies; p++) {
+        const char *list = policies[p] == PIN_LIST ? lists[p] : NULL;
+        const char *label = list ? list : pinPolicyName(policies[p]);
+        double base = 0;
+        for (int n = 1; n <= maxThreads; n = every || n == maxThreads ? n + 1 : (n * 2 < maxThreads ? n * 2 : maxThreads)) {
+            int used = placeThreads(topo, policies[p], list, n, cpus);
+            double best = 0;
+            for (int r = 0; r < SCALING_REPEATS; r++) {
+                double t0 = nowSeconds();
+                run_thread_pool_query_pinned(queries, results, root, numQuery, n, 1000,
+                                             policies[p] == PIN_NONE ? NULL : cpus);
+                double dt = nowSeconds() - t0;
+                if (r == 0 || dt < best) best = dt;
+            }
+            long long hits = 0;
+            for (int i = 0; i < numQuery; i++) hits += results[i];
+            ok &= hits == expected;
+            double qps = best > 0 ? numQuery / best : 0;
+            if (n == 1) base = qps;
+            double speedup = base > 0 ? qps / base : 0;
+            printf("%-8s %8d %6d %10.4f %12.0f %8.2fx %10.1f%%\n", label, n,
+                   policies[p] == PIN_NONE ? n : used, best, qps, speedup, 100.0 * speedup / n);
+            if (json) {
+                fprintf(json, "%s\n    {\"policy\": \"%s\", \"threads\": %d, \"seconds\": %.6f, \"qps\": %.1f, "
+                              "\"speedup\": %.4f, \"efficiency\": %.4f}",
+                        firstPoint ? "" : ",", label, n, best, qps, speedup, speedup / n);
+                firstPoint = 0;
+            }
+        }
+    }
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+        printf("📁 Scaling curve saved to: Log/scaling_curve.json\n");
+    }
+    printf("%s Scaling results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+    free(results);
+    free(cpus);
+    freeCpuTopology(topo);
+}
+
+// ./rtree_cpu_baseline scaling <data.csv> <queries.csv> [maxThreads] [all|policy|cpu-list]...
+// Thread counts 1..maxThreads (default: online CPUs); RTREE_SCALING=pow2
+// keeps only powers of two plus maxThreads.
+int scalingMain(int argc, char **argv)
+{
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s scaling <data.csv> <queries.csv> [maxThreads] [all|none|compact|scatter|cores|"
+                        "cpu-list]...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int numRects, numQuery;
+    Rect *rects = readRectsFromFile(argv[2], &numRects);
+    Rect *queries = readRectsFromFile(argv[3], &numQuery);
+    if (!rects || !queries) return EXIT_FAILURE;
+    int maxThreads = argc >= 5 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (maxThreads < 1) maxThreads = 1;
+
+    int policies[8], numPolicies = 0;
+    const char *lists[8] = {NULL};
+    for (int a = 5; a < argc && numPolicies < 8; a++) {
+        int p = strcmp(argv[a], "all") == 0 ? -2 : parsePinPolicy(argv[a]);
+        if (p == -1) {
+            fprintf(stderr, "unknown policy %s\n", argv[a]);
+            return EXIT_FAILURE;
+        }
+        if (p == PIN_LIST) lists[numPolicies] = argv[a];
+        if (p != -2) policies[numPolicies++] = p;
+    }
+    if (numPolicies == 0)
+        for (int p = PIN_NONE; p < PIN_LIST; p++) policies[numPolicies++] = p;
+
+    Node *root = createRTree_STR_2(rects, 0, numRects - 1);
+    Zsorting(queries, numQuery);
+    long long expected = 0;
+    for (int i = 0; i < numQuery; i++) expected += searchRTree(root, queries[i], i);
+    const char *mode = getenv("RTREE_SCALING");
+    scalingCurve(root, queries, numQuery, maxThreads, policies, numPolicies, lists,
+                 !(mode && strcmp(mode, "pow2") == 0), expected);
+    freeRTree(root);
+    free(rects);
+    free(queries);
+    return EXIT_SUCCESS;
+}
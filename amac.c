@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "rtree.h"
+
+// ---------------- Interleaved (AMAC) multi-query traversal ----------------
+//
+// searchRTree visits one node at a time and stalls on every pointer chase once
+// the tree no longer fits in the LLC. Here each thread keeps up to `group`
+// queries in flight. Every query is a small state machine: a step works only
+// on memory that was prefetched when the step was scheduled, issues the
+// prefetches for what it needs next, and then yields to the next query in the
+// ring. By the time the ring wraps around the lines are (hopefully) in cache.
+//
+// Stages of one query:
+//   EXPAND  internal node is cached -> prefetch every child Node (their MBRs)
+//   FILTER  child MBRs are cached   -> test them all, remember survivors
+//   SCAN    leaf payload is cached  -> count overlapping rectangles
+// After FILTER/SCAN the next surviving child is popped and its payload
+// (children array or rects) is prefetched.
+
+#define AMAC_MAX_DEPTH 32
+#define AMAC_MASK_WORDS ((FANOUT + 63) / 64)
+
+enum { AMAC_EXPAND = 0, AMAC_FILTER = 1, AMAC_SCAN = 2 };
+
+typedef struct {
+    Node *node;                       // internal node whose children were filtered
+    uint64_t mask[AMAC_MASK_WORDS];   // children still to visit
+} AmacFrame;
+
+typedef struct {
+    Rect query;
+    int qidx;
+    int stage;
+    int count;
+    int top;
+    Node *cur;   // node whose payload was prefetched for the next step
+    AmacFrame frames[AMAC_MAX_DEPTH];
+} AmacState;
+
+static inline void amacPrefetchPayload(const Node *n)
+{
+    // First lines of the leaf rects / children array; the hardware prefetcher
+    // picks up the rest of a sequential leaf scan.
+    const char *p = n->isLeaf ? (const char *)n->rects : (const char *)n->children;
+    __builtin_prefetch(p, 0, 1);
+    __builtin_prefetch(p + 64, 0, 1);
+    __builtin_prefetch(p + 128, 0, 1);
+    __builtin_prefetch(p + 192, 0, 1);
+}
+
+// Schedule `n` (whose MBR already overlaps the query) as the next step.
+static inline void amacSchedule(AmacState *s, Node *n)
+{
+    s->cur = n;
+    s->stage = n->isLeaf ? AMAC_SCAN : AMAC_EXPAND;
+    amacPrefetchPayload(n);
+}
+
+// Load query `qidx` into a slot. Returns 0 if the query misses the root.
+static inline int amacStart(AmacState *s, Node *root, const Rect *queries, int qidx)
+{
+    s->query = queries[qidx];
+    s->qidx = qidx;
+    s->count = 0;
+    s->top = 0;
+    if (!isOverlap_inline(&root->mbr, s->query))
+        return 0;
+    amacSchedule(s, root);
+    return 1;
+}
+
+// Pop the next surviving child from the frame stack and schedule it.
+// Returns 0 when the traversal of this query is finished.
+static inline int amacAdvance(AmacState *s)
+{
+    while (s->top > 0) {
+        AmacFrame *f = &s->frames[s->top - 1];
+        for (int w = 0; w < AMAC_MASK_WORDS; w++) {
+            if (f->mask[w]) {
+                int bit = __builtin_ctzll(f->mask[w]);
+                f->mask[w] &= f->mask[w] - 1;
+                amacSchedule(s, f->node->children[w * 64 + bit]);
+                return 1;
+            }
+        }
+        s->top--;
+    }
+    return 0;
+}
+
+// Run one step of a query. Returns 0 once the query has completed.
+static inline int amacStep(AmacState *s)
+{
+    Node *node = s->cur;
+
+    switch (s->stage) {
+    case AMAC_EXPAND:
+        if (node->count > FANOUT || s->top >= AMAC_MAX_DEPTH) {
+            // Wider or deeper than anything group_nodes_STR builds; finish inline
+            s->count += searchRTree(node, s->query, s->qidx);
+            break;
+        }
+        for (int i = 0; i < node->count; i++)
+            __builtin_prefetch(&node->children[i]->mbr, 0, 1);
+        s->stage = AMAC_FILTER;
+        return 1;
+
+    case AMAC_FILTER: {
+        AmacFrame *f = &s->frames[s->top];
+        int any = 0;
+        for (int w = 0; w < AMAC_MASK_WORDS; w++) f->mask[w] = 0;
+        for (int i = 0; i < node->count; i++) {
+            if (isOverlap_inline(&node->children[i]->mbr, s->query)) {
+                f->mask[i >> 6] |= 1ULL << (i & 63);
+                any = 1;
+            }
+        }
+        if (any) {
+            f->node = node;
+            s->top++;
+        }
+        break;
+    }
+
+    default: // AMAC_SCAN
+        s->count += searchLeaf(node, s->query);
+        break;
+    }
+
+    return amacAdvance(s);
+}
+
+// Fill `slot` with the next query that actually reaches the tree; queries that
+// miss the root MBR are answered immediately. Returns 0 when none are left.
+static int amacRefill(AmacState *slot, Node *root, const Rect *queries, int *results,
+                      int *nextQuery, int numQuery)
+{
+    while (*nextQuery < numQuery) {
+        int qi = (*nextQuery)++;
+        if (amacStart(slot, root, queries, qi))
+            return 1;
+        results[qi] = 0;
+    }
+    return 0;
+}
+
+// Answer queries[0..numQuery) writing counts to results[], keeping `group`
+// traversals interleaved on the calling thread.
+void searchRTree_AMAC(Node *root, const Rect *queries, int *results, int numQuery, int group)
+{
+    if (numQuery <= 0) return;
+    if (!root) {
+        for (int i = 0; i < numQuery; i++) results[i] = 0;
+        return;
+    }
+    if (group < 1) group = 1;
+    if (group > numQuery) group = numQuery;
+
+    AmacState *states = (AmacState *)malloc((size_t)group * sizeof(AmacState));
+    if (!states) {
+        perror("Unable to allocate AMAC states");
+        exit(EXIT_FAILURE);
+    }
+
+    int nextQuery = 0;
+    int active = 0;
+    while (active < group &&
+           amacRefill(&states[active], root, queries, results, &nextQuery, numQuery))
+        active++;
+
+    // Round-robin over the ring; a finished slot is refilled with the next
+    // query, or retired by swapping in the last active slot.
+    int k = 0;
+    while (active > 0) {
+        AmacState *s = &states[k];
+        if (!amacStep(s)) {
+            results[s->qidx] = s->count;
+            if (!amacRefill(s, root, queries, results, &nextQuery, numQuery)) {
+                states[k] = states[--active];
+                if (k >= active) k = 0;
+                continue;
+            }
+        }
+        if (++k >= active) k = 0;
+    }
+
+    free(states);
+}
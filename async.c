@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "rtree.h"
+
+// ---------------- Asynchronous query submission ----------------
+//
+// A QueryPool keeps its worker threads alive between calls. submitQueries
+// queues an array of queries and returns a ticket at once; workers take the
+// submissions in order, chunk by chunk, and each finished chunk is reported
+// as a QueryCompletion {ticket, first, count, hits}. results[first ..
+// first + count) of that submission are final when its completion is seen.
+//
+// Completions go to the submission's callback (run on the worker thread) or,
+// without one, to a bounded lock-free completion queue: many producers (the
+// workers), one consumer (the caller), one sequence number per slot. When the
+// queue is full workers yield until the caller drains it.
+//
+// Taking a chunk is a short critical section on the submission queue, which is
+// paid once per chunk; searching and reporting happen outside it.
+
+typedef struct Submission {
+    uint32_t ticket;
+    QuerySearchFn search;
+    const void *index;
+    const Rect *queries;
+    int *results;
+    int numQuery;
+    int chunk;
+    int next;                     // first query not yet handed out
+    int chunksLeft;               // chunks not yet reported
+    QueryCallback callback;
+    void *user;
+    struct Submission *nextSub;
+} Submission;
+
+typedef struct {
+    _Atomic size_t seq;
+    QueryCompletion c;
+} CompletionSlot;
+
+struct QueryPool {
+    Node *root;
+    int numThreads;
+    pthread_t *threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t workCond;      // workers wait for submissions
+    pthread_cond_t doneCond;      // waitTicket waits for finished tickets
+    Submission *head, *tail;      // submissions with chunks left to hand out
+    uint32_t nextTicket;
+    uint32_t finishedBelow;       // every ticket below this one is finished
+    unsigned char *finished;      // per ticket, from finishedBelow on
+    int finishedCap;
+    int stop;
+    _Atomic long inFlight;        // chunks submitted but not yet reported
+
+    CompletionSlot *ring;
+    size_t mask;
+    _Atomic size_t ringTail;      // next slot producers claim
+    size_t ringHead;              // next slot the consumer reads
+};
+
+// ---- completion queue ----
+
+static int completionPush(QueryPool *p, const QueryCompletion *c)
+{
+    size_t pos = atomic_load_explicit(&p->ringTail, memory_order_relaxed);
+    for (;;) {
+        CompletionSlot *slot = &p->ring[pos & p->mask];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&p->ringTail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->c = *c;
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        } else if (diff < 0) {
+            return 0;                           // full
+        } else {
+            pos = atomic_load_explicit(&p->ringTail, memory_order_relaxed);
+        }
+    }
+}
+
+// Take up to max completions without blocking. Single consumer only.
+int pollCompletions(QueryPool *p, QueryCompletion *out, int max)
+{
+    int n = 0;
+    while (n < max) {
+        CompletionSlot *slot = &p->ring[p->ringHead & p->mask];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != p->ringHead + 1) break;
+        out[n++] = slot->c;
+        atomic_store_explicit(&slot->seq, p->ringHead + p->mask + 1, memory_order_release);
+        p->ringHead++;
+    }
+    return n;
+}
+
+// Like pollCompletions, but wait for at least one completion while queue
+// chunks are still in flight. Returns 0 once nothing is outstanding.
+int waitCompletions(QueryPool *p, QueryCompletion *out, int max)
+{
+    for (;;) {
+        int n = pollCompletions(p, out, max);
+        if (n > 0) return n;
+        if (atomic_load(&p->inFlight) == 0) return pollCompletions(p, out, max);
+        sched_yield();
+    }
+}
+
+// ---- tickets ----
+
+static void markFinished(QueryPool *p, uint32_t ticket)
+{
+    p->finished[ticket - p->finishedBelow] = 1;
+    int shift = 0;
+    while (p->finishedBelow + (uint32_t)shift < p->nextTicket && p->finished[shift]) shift++;
+    if (shift > 0) {
+        memmove(p->finished, p->finished + shift, p->nextTicket - p->finishedBelow - (uint32_t)shift);
+        memset(p->finished + (p->nextTicket - p->finishedBelow - (uint32_t)shift), 0, (size_t)shift);
+        p->finishedBelow += (uint32_t)shift;
+    }
+    pthread_cond_broadcast(&p->doneCond);
+}
+
+// A ticket not issued yet is not finished; finished[] does not cover it
+static int isFinished(const QueryPool *p, uint32_t ticket)
+{
+    if (ticket < p->finishedBelow) return 1;
+    return ticket < p->nextTicket && p->finished[ticket - p->finishedBelow];
+}
+
+int ticketDone(QueryPool *p, uint32_t ticket)
+{
+    pthread_mutex_lock(&p->lock);
+    int done = isFinished(p, ticket);
+    pthread_mutex_unlock(&p->lock);
+    return done;
+}
+
+// Block until every chunk of `ticket` has run. With the completion queue,
+// the caller must keep draining it or the workers can stall on a full ring.
+void waitTicket(QueryPool *p, uint32_t ticket)
+{
+    pthread_mutex_lock(&p->lock);
+    while (!isFinished(p, ticket)) pthread_cond_wait(&p->doneCond, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// ---- workers ----
+
+static void *pool_worker(void *arg)
+{
+    QueryPool *p = (QueryPool *)arg;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (!p->head && !p->stop) pthread_cond_wait(&p->workCond, &p->lock);
+        if (!p->head) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        Submission *s = p->head;
+        int start = s->next;
+        int end = start + s->chunk < s->numQuery ? start + s->chunk : s->numQuery;
+        s->next = end;
+        if (end == s->numQuery) {
+            p->head = s->nextSub;
+            if (!p->head) p->tail = NULL;
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        QueryCompletion c = {.ticket = s->ticket, .first = start, .count = end - start, .hits = 0};
+        double t0 = nowSeconds();
+        for (int i = start; i < end; i++) {
+            s->results[i] = s->search(s->index, s->queries[i]);
+            c.hits += s->results[i];
+        }
+        c.ns = (long long)((nowSeconds() - t0) * 1e9);
+        if (s->callback) {
+            s->callback(&c, s->user);
+        } else {
+            while (!completionPush(p, &c)) sched_yield();
+        }
+        atomic_fetch_sub(&p->inFlight, 1);
+
+        pthread_mutex_lock(&p->lock);
+        if (--s->chunksLeft == 0) {
+            markFinished(p, s->ticket);
+            free(s);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+// queueCapacity is rounded up to a power of two. root may be NULL for a
+// pool that only takes submitIndexQueries.
+QueryPool *createQueryPool(Node *root, int numThreads, int queueCapacity)
+{
+    QueryPool *p = (QueryPool *)calloc(1, sizeof(QueryPool));
+    if (!p) {
+        perror("Unable to allocate query pool");
+        exit(EXIT_FAILURE);
+    }
+    size_t cap = 2;
+    while (cap < (size_t)queueCapacity) cap <<= 1;
+    p->ring = (CompletionSlot *)malloc(cap * sizeof(CompletionSlot));
+    p->numThreads = numThreads < 1 ? 1 : numThreads;
+    p->threads = (pthread_t *)malloc((size_t)p->numThreads * sizeof(pthread_t));
+    p->finishedCap = 64;
+    p->finished = (unsigned char *)calloc((size_t)p->finishedCap, 1);
+    if (!p->ring || !p->threads || !p->finished) {
+        perror("Unable to allocate query pool");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < cap; i++) atomic_init(&p->ring[i].seq, i);
+    p->mask = cap - 1;
+    atomic_init(&p->ringTail, 0);
+    atomic_init(&p->inFlight, 0);
+    p->root = root;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->workCond, NULL);
+    pthread_cond_init(&p->doneCond, NULL);
+    for (int t = 0; t < p->numThreads; t++) pthread_create(&p->threads[t], NULL, pool_worker, p);
+    return p;
+}
+
+static int searchTreeIndex(const void *index, Rect q)
+{
+    return searchRTree((Node *)index, q, 0);
+}
+
+// Queue queries[0 .. numQuery) against the pool's tree in chunks of `chunk`
+// and return its ticket. queries and results must stay valid until the
+// ticket is finished. With a NULL callback the chunk completions go to the
+// completion queue.
+uint32_t submitQueries(QueryPool *p, const Rect *queries, int *results, int numQuery, int chunk,
+                       QueryCallback callback, void *user)
+{
+    return submitIndexQueries(p, searchTreeIndex, p->root, queries, results, numQuery, chunk,
+                              callback, user);
+}
+
+// Same as submitQueries against any index; search(index, q) runs on the
+// workers, so one pool can serve many indexes.
+uint32_t submitIndexQueries(QueryPool *p, QuerySearchFn search, const void *index, const Rect *queries,
+                            int *results, int numQuery, int chunk, QueryCallback callback, void *user)
+{
+    Submission *s = (Submission *)malloc(sizeof(Submission));
+    if (!s) {
+        perror("Unable to allocate query submission");
+        exit(EXIT_FAILURE);
+    }
+    if (chunk < 1) chunk = 1;
+    *s = (Submission){.search = search, .index = index, .queries = queries, .results = results, .numQuery = numQuery, .chunk = chunk,
+                      .chunksLeft = (numQuery + chunk - 1) / chunk, .callback = callback, .user = user};
+
+    pthread_mutex_lock(&p->lock);
+    s->ticket = p->nextTicket++;
+    uint32_t live = p->nextTicket - p->finishedBelow;
+    if (live > (uint32_t)p->finishedCap) {
+        p->finished = (unsigned char *)realloc(p->finished, (size_t)p->finishedCap * 2);
+        if (!p->finished) {
+            perror("Unable to grow ticket table");
+            exit(EXIT_FAILURE);
+        }
+        memset(p->finished + p->finishedCap, 0, (size_t)p->finishedCap);
+        p->finishedCap *= 2;
+    }
+    uint32_t ticket = s->ticket;
+    if (s->chunksLeft == 0) {
+        markFinished(p, ticket);
+        free(s);
+    } else {
+        atomic_fetch_add(&p->inFlight, s->chunksLeft);
+        if (p->tail) p->tail->nextSub = s;
+        else p->head = s;
+        p->tail = s;
+        pthread_cond_broadcast(&p->workCond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ticket;
+}
+
+// Finish the queued work, then stop the workers.
+void destroyQueryPool(QueryPool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->workCond);
+    pthread_mutex_unlock(&p->lock);
+    // Workers may wait on a full queue, so keep draining it
+    QueryCompletion sink[256];
+    while (atomic_load(&p->inFlight) > 0) {
+        if (pollCompletions(p, sink, 256) == 0) sched_yield();
+    }
+    for (int t = 0; t < p->numThreads; t++) pthread_join(p->threads[t], NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->workCond);
+    pthread_cond_destroy(&p->doneCond);
+    free(p->threads);
+    free(p->finished);
+    free(p->ring);
+    free(p);
+}
+
+// ---- benchmark ----
+
+static void countHits(const QueryCompletion *c, void *user)
+{
+    atomic_fetch_add((_Atomic long long *)user, c->hits);
+}
+
+// Blocking run against consuming chunk results as they finish: time until
+// the first results are usable, total time, and the totals of both.
+void asyncQueryBenchmark(Node *root, const Rect *queries, int numQuery, int numThreads,
+                         long long expected)
+{
+    int *results = (int *)malloc((size_t)numQuery * sizeof(int));
+    QueryCompletion done[256];
+    QueryPool *p = createQueryPool(root, numThreads, 4096);
+    int ok = 1;
+    printf("\n[Async submission] %d threads\n", numThreads);
+    printf("%-28s %10s %10s %14s\n", "mode", "first (s)", "total (s)", "overlaps");
+
+    // Whole array in one chunk per thread: results only when everything is done
+    double t0 = nowSeconds();
+    uint32_t ticket = submitQueries(p, queries, results, numQuery, (numQuery + numThreads - 1) / numThreads,
+                                    NULL, NULL);
+    long long hits = 0;
+    int n;
+    while ((n = waitCompletions(p, done, 256)) > 0)
+        for (int i = 0; i < n; i++) hits += done[i].hits;
+    waitTicket(p, ticket);
+    double total = nowSeconds() - t0;
+    printf("%-28s %10.4f %10.4f %14lld\n", "blocking (one batch)", total, total, hits);
+    ok &= hits == expected;
+
+    // Same array in chunks of 1000, consumed from the completion queue
+    static const int chunks[] = {1000, 100};
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        t0 = nowSeconds();
+        ticket = submitQueries(p, queries, results, numQuery, chunks[c], NULL, NULL);
+        double first = -1;
+        hits = 0;
+        while ((n = waitCompletions(p, done, 256)) > 0) {
+            if (first < 0) first = nowSeconds() - t0;
+            for (int i = 0; i < n; i++) {
+                // The chunk's slots of results are already final here
+                long long sum = 0;
+                for (int q = done[i].first; q < done[i].first + done[i].count; q++) sum += results[q];
+                ok &= sum == done[i].hits;
+                hits += done[i].hits;
+            }
+        }
+        waitTicket(p, ticket);
+        total = nowSeconds() - t0;
+        char name[64];
+        snprintf(name, sizeof(name), "completion queue, chunk %d", chunks[c]);
+        printf("%-28s %10.4f %10.4f %14lld\n", name, first, total, hits);
+        ok &= hits == expected;
+    }
+
+    // One ticket per 64 queries, results reported through a callback
+    _Atomic long long cbHits;
+    atomic_init(&cbHits, 0);
+    t0 = nowSeconds();
+    uint32_t last = 0;
+    for (int q = 0; q < numQuery; q += 64) {
+        int count = numQuery - q < 64 ? numQuery - q : 64;
+        last = submitQueries(p, queries + q, results + q, count, count, countHits, &cbHits);
+    }
+    for (uint32_t t = ticket + 1; t <= last; t++) waitTicket(p, t);
+    total = nowSeconds() - t0;
+    printf("%-28s %10s %10.4f %14lld\n", "callback, ticket per 64", "-", total, atomic_load(&cbHits));
+    ok &= atomic_load(&cbHits) == expected;
+
+    destroyQueryPool(p);
+    free(results);
+    printf("%s Async results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+}
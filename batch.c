@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Batch updates with local STR re-packing ----------------
+//
+// rtreeBatchUpdate applies a batch of inserts and deletes to a tree in place
+// and only rebuilds what the batch touches. The changes are routed down the
+// tree (inserts by least enlargement, deletes to a subtree that holds an
+// equal rect, one copy per delete) and grouped per child. At the level above the leaves, the
+// touched leaves of one parent are pooled with their inserts, the deletes are
+// removed, and the pool is packed again with the STR leaf tiling of
+// createRTree_STR_2. Untouched siblings are kept as they are.
+//
+// On the way back up every touched node gets its MBR recomputed. A node that
+// ends up with more than FANOUT children is replaced by STR-packed siblings
+// (packLevel_STR), which its parent absorbs the same way; if the root splits,
+// group_nodes_STR builds the new top levels. All leaves stay at one depth.
+//
+// The tree must not be queried while it is being updated; use the snapshot
+// or LSM paths for that.
+
+typedef struct {
+    Rect r;                         // first, so compareRectLex sorts these
+    int index;
+} DeleteRef;
+
+// Copies of r below n, counting no further than limit
+static int subtreeCount(const Node *n, Rect r, int limit)
+{
+    if (n->mbr.xmin > r.xmin || n->mbr.ymin > r.ymin || n->mbr.xmax < r.xmax || n->mbr.ymax < r.ymax)
+        return 0;
+    int found = 0;
+    if (n->isLeaf) {
+        for (int i = 0; i < n->count && found < limit; i++)
+            if (compareRectLex(&n->rects[i], &r) == 0) found++;
+        return found;
+    }
+    for (int i = 0; i < n->count && found < limit; i++)
+        found += subtreeCount(n->children[i], r, limit - found);
+    return found;
+}
+
+static int bestChild(const Node *n, Rect r)
+{
+    int best = 0;
+    long long bestEnl = 0, bestArea = 0;
+    for (int i = 0; i < n->count; i++) {
+        const MBR *m = &n->children[i]->mbr;
+        MBR u = unionJoin((MBR *)m, &r);
+        long long area = ((long long)m->xmax - m->xmin) * ((long long)m->ymax - m->ymin);
+        long long enl = ((long long)u.xmax - u.xmin) * ((long long)u.ymax - u.ymin) - area;
+        if (i == 0 || enl < bestEnl || (enl == bestEnl && area < bestArea)) {
+            best = i;
+            bestEnl = enl;
+            bestArea = area;
+        }
+    }
+    return best;
+}
+
+// Stable counting sort of rects by target child; start[c]..start[c+1] is the
+// share of child c. Entries with target -1 are dropped.
+static Rect *bucketByChild(const Rect *rects, const int *target, int n, int numChildren, int *start)
+{
+    memset(start, 0, (size_t)(numChildren + 1) * sizeof(int));
+    for (int i = 0; i < n; i++)
+        if (target[i] >= 0) start[target[i] + 1]++;
+    for (int c = 0; c < numChildren; c++) start[c + 1] += start[c];
+    Rect *out = (Rect *)malloc((size_t)(start[numChildren] > 0 ? start[numChildren] : 1) * sizeof(Rect));
+    int *fill = (int *)malloc((size_t)(numChildren > 0 ? numChildren : 1) * sizeof(int));
+    if (!out || !fill) {
+        perror("Unable to allocate batch buckets");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(fill, start, (size_t)numChildren * sizeof(int));
+    for (int i = 0; i < n; i++)
+        if (target[i] >= 0) out[fill[target[i]]++] = rects[i];
+    free(fill);
+    return out;
+}
+
+static void recomputeNodeMBR(Node *n)
+{
+    initMBR(&n->mbr);
+    for (int i = 0; i < n->count; i++) n->mbr = unionJoin(&n->mbr, &n->children[i]->mbr);
+}
+
+// STR-pack pool[0..n) minus del into fresh leaves.
+static Node **repackLeaves(Rect *pool, int n, Rect *del, int nd, int *outCount, BatchUpdateStats *st)
+{
+    int removed = 0;
+    if (nd > 0) n = subtractRects(pool, n, del, nd, &removed);
+    st->deleted += removed;
+    st->missing += nd - removed;
+    st->rectsRepacked += n;
+    return packLeaves_STR(pool, 0, n - 1, outCount);
+}
+
+static void pushChild(Node ***children, int *count, int *cap, Node *c)
+{
+    if (*count == *cap) {
+        *cap *= 2;
+        *children = (Node **)realloc(*children, (size_t)*cap * sizeof(Node *));
+        if (!*children) {
+            perror("Unable to grow batch children");
+            exit(EXIT_FAILURE);
+        }
+    }
+    (*children)[(*count)++] = c;
+}
+
+// Apply the batch below `node` (an internal node). Returns the nodes that
+// replace it at the same height (node itself when it did not overflow);
+// *outCount may be 0 if everything below it was deleted.
+static Node **applyBatch(Node *node, const Rect *ins, int ni, const Rect *del, int nd,
+                         int *outCount, BatchUpdateStats *st)
+{
+    int nc = node->count;
+    int *target = (int *)malloc((size_t)(ni > nd ? ni : nd) * sizeof(int) + sizeof(int));
+    int *insStart = (int *)malloc((size_t)(nc + 1) * sizeof(int));
+    int *delStart = (int *)malloc((size_t)(nc + 1) * sizeof(int));
+    if (!target || !insStart || !delStart) {
+        perror("Unable to allocate batch routing");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < ni; i++) target[i] = bestChild(node, ins[i]);
+    Rect *insB = bucketByChild(ins, target, ni, nc, insStart);
+    // Equal deletes are handed to the children in order, each child taking
+    // as many as it holds copies, so duplicates are not all sent to one
+    DeleteRef *order = (DeleteRef *)malloc((size_t)(nd > 0 ? nd : 1) * sizeof(DeleteRef));
+    if (!order) {
+        perror("Unable to allocate batch routing");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < nd; i++) order[i] = (DeleteRef){del[i], i};
+    qsort(order, (size_t)nd, sizeof(DeleteRef), compareRectLex);
+    for (int g = 0; g < nd;) {
+        int e = g + 1, k = g;
+        while (e < nd && compareRectLex(&order[e].r, &order[g].r) == 0) e++;
+        for (int c = 0; c < nc && k < e; c++)
+            for (int copies = subtreeCount(node->children[c], order[g].r, e - k); copies > 0; copies--)
+                target[order[k++].index] = c;
+        for (; k < e; k++) {
+            target[order[k].index] = -1;
+            st->missing++;
+        }
+        g = e;
+    }
+    free(order);
+    Rect *delB = bucketByChild(del, target, nd, nc, delStart);
+    free(target);
+
+    // New child list: untouched children first, then replacements
+    int cap = nc + 16, count = 0;
+    Node **children = (Node **)malloc((size_t)cap * sizeof(Node *));
+    if (!children) {
+        perror("Unable to allocate batch children");
+        exit(EXIT_FAILURE);
+    }
+
+    if (node->children[0]->isLeaf) {
+        // Pool every touched leaf with its inserts and re-pack them together
+        long long poolSize = insStart[nc];
+        for (int c = 0; c < nc; c++)
+            if (insStart[c + 1] > insStart[c] || delStart[c + 1] > delStart[c])
+                poolSize += node->children[c]->count;
+        Rect *pool = (Rect *)malloc((size_t)(poolSize > 0 ? poolSize : 1) * sizeof(Rect));
+        if (!pool) {
+            perror("Unable to allocate batch pool");
+            exit(EXIT_FAILURE);
+        }
+        int k = 0;
+        for (int c = 0; c < nc; c++) {
+            Node *leaf = node->children[c];
+            if (insStart[c + 1] == insStart[c] && delStart[c + 1] == delStart[c]) {
+                pushChild(&children, &count, &cap, leaf);
+                continue;
+            }
+            memcpy(pool + k, leaf->rects, (size_t)leaf->count * sizeof(Rect));
+            k += leaf->count;
+            st->leavesRepacked++;
+            freeRTree(leaf);
+        }
+        memcpy(pool + k, insB, (size_t)insStart[nc] * sizeof(Rect));
+        k += insStart[nc];
+        st->inserted += insStart[nc];
+
+        int nl;
+        Node **leaves = repackLeaves(pool, k, delB, delStart[nc], &nl, st);
+        for (int i = 0; i < nl; i++) pushChild(&children, &count, &cap, leaves[i]);
+        free(leaves);
+        free(pool);
+    } else {
+        for (int c = 0; c < nc; c++) {
+            Node *child = node->children[c];
+            int ci = insStart[c + 1] - insStart[c], cd = delStart[c + 1] - delStart[c];
+            if (ci == 0 && cd == 0) {
+                pushChild(&children, &count, &cap, child);
+                continue;
+            }
+            int nr;
+            Node **repl = applyBatch(child, insB + insStart[c], ci, delB + delStart[c], cd, &nr, st);
+            for (int i = 0; i < nr; i++) pushChild(&children, &count, &cap, repl[i]);
+            free(repl);
+        }
+    }
+    free(insB);
+    free(delB);
+    free(insStart);
+    free(delStart);
+
+    Node **out;
+    if (count == 0) {
+        free(node->children);
+        free(node);
+        free(children);
+        *outCount = 0;
+        return NULL;
+    }
+    if (count <= FANOUT) {
+        free(node->children);
+        node->children = children;
+        node->count = count;
+        recomputeNodeMBR(node);
+        out = (Node **)malloc(sizeof(Node *));
+        out[0] = node;
+        *outCount = 1;
+        return out;
+    }
+    // Overflow: split into STR-packed siblings at this height
+    out = packLevel_STR(children, count, FANOUT, outCount);
+    free(children);
+    free(node->children);
+    free(node);
+    return out;
+}
+
+// Apply inserts and deletes (by exact value) to `root` in place and return the
+// new root. Both arrays are reordered. `stats` may be NULL.
+Node *rtreeBatchUpdate(Node *root, Rect *inserts, int numInserts, Rect *deletes, int numDeletes,
+                       BatchUpdateStats *stats)
+{
+    BatchUpdateStats st = {0};
+    Node **top;
+    int nt;
+
+    if (!root) {
+        st.inserted = numInserts;
+        st.missing = numDeletes;
+        top = repackLeaves(inserts, numInserts, NULL, 0, &nt, &st);
+    } else if (root->isLeaf) {
+        int n = root->count + numInserts;
+        Rect *pool = (Rect *)malloc((size_t)(n > 0 ? n : 1) * sizeof(Rect));
+        if (!pool) {
+            perror("Unable to allocate batch pool");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(pool, root->rects, (size_t)root->count * sizeof(Rect));
+        memcpy(pool + root->count, inserts, (size_t)numInserts * sizeof(Rect));
+        st.inserted = numInserts;
+        st.leavesRepacked = 1;
+        freeRTree(root);
+        top = repackLeaves(pool, n, deletes, numDeletes, &nt, &st);
+        free(pool);
+    } else {
+        top = applyBatch(root, inserts, numInserts, deletes, numDeletes, &nt, &st);
+    }
+
+    Node *newRoot = nt > 0 ? group_nodes_STR(top, nt, FANOUT) : NULL;
+    free(top);
+    if (stats) *stats = st;
+    return newRoot;
+}
+
+// ---- benchmark: local batch update vs full rebuild ----
+
+// Batches of 1% of the data (half deletes of existing rects, half new rects)
+// drawn from windows of growing size, applied with rtreeBatchUpdate and with
+// a full createRTree_STR_2 rebuild; both trees must answer the queries alike.
+void batchUpdateBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries, int numQuery)
+{
+    static const double fractions[] = {0.001, 0.01, 0.10, 1.0};
+    const int nf = (int)(sizeof(fractions) / sizeof(fractions[0]));
+    if (!root || numRects < 100) return;
+
+    int half = numRects / 200;
+    double W = (double)root->mbr.xmax - root->mbr.xmin;
+    double H = (double)root->mbr.ymax - root->mbr.ymin;
+    int *inWindow = (int *)malloc((size_t)numRects * sizeof(int));
+    Rect *ins = (Rect *)malloc((size_t)half * sizeof(Rect));
+    Rect *del = (Rect *)malloc((size_t)half * sizeof(Rect));
+    Rect *all = (Rect *)malloc((size_t)(numRects + half) * sizeof(Rect));
+    char *deleted = (char *)calloc((size_t)numRects, 1);
+    if (!inWindow || !ins || !del || !all || !deleted) {
+        perror("Unable to allocate batch benchmark");
+        exit(EXIT_FAILURE);
+    }
+    srand(7);
+
+    printf("\n=== Batch update vs full rebuild (batch of %d inserts + %d deletes) ===\n", half, half);
+    printf("%8s %10s %10s %12s %12s %9s %6s\n", "window", "leaves", "repacked", "batch ms",
+           "rebuild ms", "speedup", "match");
+    for (int f = 0; f < nf; f++) {
+        // Pick the batch from a window around a random data rect
+        const Rect *c = &rects[rand() % numRects];
+        double side = sqrt(fractions[f]);
+        int cx = c->xmin / 2 + c->xmax / 2, cy = c->ymin / 2 + c->ymax / 2;
+        Rect win = fractions[f] >= 1.0 ? root->mbr
+                 : (Rect){cx - (int)(side * W / 2), cy - (int)(side * H / 2),
+                          cx + (int)(side * W / 2), cy + (int)(side * H / 2)};
+        int nw = 0;
+        for (int i = 0; i < numRects; i++)
+            if (isOverlap_inline((const MBR *)&win, rects[i])) inWindow[nw++] = i;
+        if (nw == 0) continue;
+        // Partial shuffle for distinct deletes; inserts are shifted copies
+        int nd = half < nw ? half : nw;
+        for (int i = 0; i < nd; i++) {
+            int j = i + rand() % (nw - i);
+            int tmp = inWindow[i];
+            inWindow[i] = inWindow[j];
+            inWindow[j] = tmp;
+            del[i] = rects[inWindow[i]];
+        }
+        for (int i = 0; i < half; i++) {
+            Rect r = rects[inWindow[rand() % nw]];
+            int dx = rand() % 64 - 32, dy = rand() % 64 - 32;
+            ins[i] = (Rect){r.xmin + dx, r.ymin + dy, r.xmax + dx, r.ymax + dy};
+        }
+
+        // Full rebuild: apply the batch to the array by marking the deleted
+        // indices (untimed), then time only the bulk load from scratch
+        for (int i = 0; i < nd; i++) deleted[inWindow[i]] = 1;
+        int n = 0;
+        for (int i = 0; i < numRects; i++)
+            if (!deleted[i]) all[n++] = rects[i];
+        memcpy(all + n, ins, (size_t)half * sizeof(Rect));
+        n += half;
+        for (int i = 0; i < nd; i++) deleted[inWindow[i]] = 0;
+        double t0 = nowSeconds();
+        Node *rebuilt = createRTree_STR_2(all, 0, n - 1);
+        double rebuildTime = nowSeconds() - t0;
+
+        Node *updated = cloneRTree(root);
+        BatchUpdateStats st;
+        t0 = nowSeconds();
+        updated = rtreeBatchUpdate(updated, ins, half, del, nd, &st);
+        double batchTime = nowSeconds() - t0;
+
+        long long a = 0, b = 0;
+        for (int q = 0; q < numQuery; q++) {
+            a += searchRTree(updated, queries[q], q);
+            b += searchRTree(rebuilt, queries[q], q);
+        }
+        char label[16];
+        snprintf(label, sizeof(label), "%.1f%%", fractions[f] * 100);
+        printf("%8s %10d %10lld %12.2f %12.2f %8.2fx %6s\n", label, st.leavesRepacked,
+               st.rectsRepacked, batchTime * 1e3, rebuildTime * 1e3, rebuildTime / batchTime,
+               a == b && st.deleted == nd ? "✅" : "❌");
+        freeRTree(updated);
+        freeRTree(rebuilt);
+    }
+    free(inWindow);
+    free(ins);
+    free(del);
+    free(all);
+    free(deleted);
+}
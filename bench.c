@@ -0,0 +1,402 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "rtree.h"
+
+// ---------------- Performance regression suite ----------------
+//
+// `make bench` runs `rtree_cpu_baseline bench Log/bench.json <baseline>`.
+// Every run uses the same fixed-seed synthetic workloads, one uniform and
+// one clustered. For each workload it builds the pointer tree and every
+// SpatialIndexOps engine and takes BENCH_REPEATS build time and
+// throughput samples of each one. A sample repeats the build or the query
+// set for at least BENCH_MIN_SAMPLE_S, since a single build or pass lasts
+// only a few ms and is dominated by timer and scheduler noise. The build
+// time and query throughput (median and median absolute deviation), the
+// index bytes and the hit total are written as JSON, one result per line.
+//
+// Against a baseline written the same way (`make bench-baseline`), a time
+// metric regresses when it is worse by more than BENCH_TOL (relative)
+// and by more than BENCH_SIGMA times the combined noise of both runs
+// (1.4826 x MAD, the normal-consistent spread). Memory regresses when it
+// grows by more than BENCH_MEM_TOL. A different hit total is always a
+// failure, since the workloads are deterministic, and so is an engine
+// whose total differs from the pointer tree's, with or without a baseline.
+// The exit status is nonzero on any of these, so make fails.
+
+#define BENCH_REPEATS 5
+#define BENCH_RECTS 200000
+#define BENCH_QUERIES 2000
+#define BENCH_SPACE 1000000
+#define BENCH_MAX_RESULTS 256
+#define BENCH_MIN_SAMPLE_S 0.1
+
+typedef struct {
+    char workload[32];
+    char engine[32];
+    char metric[16];
+    double median, mad;
+    int n;
+} BenchResult;
+
+enum { BENCH_LOWER_BETTER, BENCH_HIGHER_BETTER, BENCH_EXACT_MEMORY, BENCH_EXACT_VALUE };
+
+static unsigned int benchRand(unsigned int *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 1;
+}
+
+// Uniform in [0, n)
+static int benchUniform(unsigned int *seed, int n)
+{
+    return (int)(((unsigned long long)benchRand(seed) << 16 ^ benchRand(seed)) % (unsigned long long)n);
+}
+
+static Rect benchBox(int cx, int cy, int w, int h)
+{
+    Rect r = {cx - w / 2, cy - h / 2, cx - w / 2 + w, cy - h / 2 + h};
+    return r;
+}
+
+// Fixed-seed data and Z-sorted queries: "uniform" spreads small boxes over
+// the space; "clustered" puts them around 24 centers with a triangular
+// (sum of two uniforms) spread, and centers queries on data boxes.
+static void benchWorkload(int clustered, Rect *rects, Rect *queries)
+{
+    unsigned int seed = clustered ? 4902u : 4901u;
+    int cx[24], cy[24];
+    for (int c = 0; c < 24; c++) {
+        cx[c] = benchUniform(&seed, BENCH_SPACE);
+        cy[c] = benchUniform(&seed, BENCH_SPACE);
+    }
+    for (int i = 0; i < BENCH_RECTS; i++) {
+        int w = 1 + benchUniform(&seed, 200), h = 1 + benchUniform(&seed, 200);
+        int x, y;
+        if (clustered) {
+            int c = benchUniform(&seed, 24);
+            x = cx[c] + benchUniform(&seed, 40000) + benchUniform(&seed, 40000) - 40000;
+            y = cy[c] + benchUniform(&seed, 40000) + benchUniform(&seed, 40000) - 40000;
+        } else {
+            x = benchUniform(&seed, BENCH_SPACE);
+            y = benchUniform(&seed, BENCH_SPACE);
+        }
+        rects[i] = benchBox(x, y, w, h);
+    }
+    for (int i = 0; i < BENCH_QUERIES; i++) {
+        int w = 2000 + benchUniform(&seed, 18000), h = 2000 + benchUniform(&seed, 18000);
+        if (clustered) {
+            const Rect *r = &rects[benchUniform(&seed, BENCH_RECTS)];
+            queries[i] = benchBox((r->xmin + r->xmax) / 2, (r->ymin + r->ymax) / 2, w, h);
+        } else {
+            queries[i] = benchBox(benchUniform(&seed, BENCH_SPACE), benchUniform(&seed, BENCH_SPACE), w, h);
+        }
+    }
+    Zsorting(queries, BENCH_QUERIES);
+}
+
+static int compareDouble(const void *A, const void *B)
+{
+    double a = *(const double *)A, b = *(const double *)B;
+    return (a > b) - (a < b);
+}
+
+// Median and median absolute deviation of v (reordered)
+static void benchStats(double *v, int n, double *median, double *mad)
+{
+    qsort(v, (size_t)n, sizeof(double), compareDouble);
+    *median = n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+    double dev[BENCH_REPEATS];
+    for (int i = 0; i < n; i++) dev[i] = fabs(v[i] - *median);
+    qsort(dev, (size_t)n, sizeof(double), compareDouble);
+    *mad = n % 2 ? dev[n / 2] : (dev[n / 2 - 1] + dev[n / 2]) / 2;
+}
+
+static void addResult(BenchResult *out, int *count, const char *workload, const char *engine, const char *metric,
+                      double *samples, int n)
+{
+    BenchResult *r = &out[(*count)++];
+    snprintf(r->workload, sizeof(r->workload), "%s", workload);
+    snprintf(r->engine, sizeof(r->engine), "%s", engine);
+    snprintf(r->metric, sizeof(r->metric), "%s", metric);
+    r->n = n;
+    if (n > 1) {
+        benchStats(samples, n, &r->median, &r->mad);
+    } else {
+        r->median = samples[0];
+        r->mad = 0;
+    }
+}
+
+// Queries per second over whole passes of the query set lasting at least
+// BENCH_MIN_SAMPLE_S: through the thread pool when `pool` is set, else
+// sequentially on `idx`, or on `root` when idx is NULL. *hits is the
+// overlap total of one pass.
+static double sampleQps(Node *root, const SpatialIndex *idx, int pool, Rect *queries, int *results,
+                        int numThreads, long long *hits)
+{
+    int passes = 0;
+    double t0 = nowSeconds(), dt;
+    do {
+        long long h = 0;
+        if (pool) {
+            run_thread_pool_query_pinned(queries, results, root, BENCH_QUERIES, numThreads, 100, NULL);
+            for (int i = 0; i < BENCH_QUERIES; i++) h += results[i];
+        } else if (idx)
+            for (int i = 0; i < BENCH_QUERIES; i++) h += spatialIndexSearch(idx, queries[i]);
+        else
+            for (int i = 0; i < BENCH_QUERIES; i++) h += searchRTree(root, queries[i], i);
+        *hits = h;
+        passes++;
+    } while ((dt = nowSeconds() - t0) < BENCH_MIN_SAMPLE_S);
+    return (double)passes * BENCH_QUERIES / dt;
+}
+
+// One workload on the pointer tree (also through the thread pool) and on
+// every engine. Samples are taken in rounds over all indexes, so slow
+// drift of the machine during the run shows up in every metric's spread
+// instead of biasing whichever index happened to run at the time.
+// *mismatches counts the pool run and engines whose total differs from the
+// sequential pointer tree.
+static int benchRun(const char *workload, const Rect *rects, Rect *queries, int numThreads, BenchResult *out,
+                    int count, int *mismatches)
+{
+    const SpatialIndexOps *engines[] = {&rtreeIndexOps, &gridIndexOps, &quadtreeIndexOps,
+                                        selectKernelOps(rects, BENCH_RECTS)};
+    enum { NUM_ENGINES = sizeof(engines) / sizeof(engines[0]) };
+    double build[NUM_ENGINES + 1][BENCH_REPEATS], qps[NUM_ENGINES + 1][BENCH_REPEATS], par[BENCH_REPEATS], value;
+    long long hits[NUM_ENGINES + 1];
+    SpatialIndex *idx[NUM_ENGINES] = {NULL};
+    int *results = (int *)malloc(BENCH_QUERIES * sizeof(int));
+    Rect *copy = (Rect *)malloc(BENCH_RECTS * sizeof(Rect));
+    if (!results || !copy) {
+        perror("Unable to allocate benchmark buffers");
+        exit(EXIT_FAILURE);
+    }
+
+    // Build samples are the mean over as many builds as fill
+    // BENCH_MIN_SAMPLE_S; the last build of each index is kept
+    Node *root = NULL;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        int builds = 0;
+        double spent = 0;
+        do {
+            // The loader reorders its input, so each build gets a copy
+            memcpy(copy, rects, BENCH_RECTS * sizeof(Rect));
+            if (root) freeRTree(root);
+            double t0 = nowSeconds();
+            root = createRTree_STR_2(copy, 0, BENCH_RECTS - 1);
+            spent += nowSeconds() - t0;
+            builds++;
+        } while (spent < BENCH_MIN_SAMPLE_S);
+        build[0][r] = spent / builds;
+        for (int k = 0; k < NUM_ENGINES; k++) {
+            builds = 0;
+            spent = 0;
+            do {
+                if (idx[k]) freeSpatialIndex(idx[k]);
+                double t0 = nowSeconds();
+                idx[k] = buildSpatialIndex(engines[k], rects, BENCH_RECTS);
+                spent += nowSeconds() - t0;
+                builds++;
+            } while (spent < BENCH_MIN_SAMPLE_S);
+            build[k + 1][r] = spent / builds;
+        }
+    }
+
+    long long poolHits;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        qps[0][r] = sampleQps(root, NULL, 0, queries, results, numThreads, &hits[0]);
+        par[r] = sampleQps(root, NULL, 1, queries, results, numThreads, &poolHits);
+        for (int k = 0; k < NUM_ENGINES; k++)
+            qps[k + 1][r] = sampleQps(NULL, idx[k], 0, queries, results, numThreads, &hits[k + 1]);
+    }
+
+    if (poolHits != hits[0]) {
+        (*mismatches)++;
+        printf("❌ thread pool on %s: %lld overlaps, pointer tree has %lld\n", workload, poolHits, hits[0]);
+    }
+    addResult(out, &count, workload, "pointer", "build_s", build[0], BENCH_REPEATS);
+    addResult(out, &count, workload, "pointer", "qps", qps[0], BENCH_REPEATS);
+    addResult(out, &count, workload, "pointer", "pool_qps", par, BENCH_REPEATS);
+    value = (double)rtreeBytes(root);
+    addResult(out, &count, workload, "pointer", "bytes", &value, 1);
+    value = (double)hits[0];
+    addResult(out, &count, workload, "pointer", "hits", &value, 1);
+    freeRTree(root);
+
+    for (int k = 0; k < NUM_ENGINES; k++) {
+        addResult(out, &count, workload, engines[k]->name, "build_s", build[k + 1], BENCH_REPEATS);
+        addResult(out, &count, workload, engines[k]->name, "qps", qps[k + 1], BENCH_REPEATS);
+        value = (double)spatialIndexBytes(idx[k]);
+        addResult(out, &count, workload, engines[k]->name, "bytes", &value, 1);
+        value = (double)hits[k + 1];
+        addResult(out, &count, workload, engines[k]->name, "hits", &value, 1);
+        if (hits[k + 1] != hits[0]) {
+            (*mismatches)++;
+            printf("❌ %s on %s: %lld overlaps, pointer tree has %lld\n", engines[k]->name, workload, hits[k + 1],
+                   hits[0]);
+        }
+        freeSpatialIndex(idx[k]);
+    }
+    free(results);
+    free(copy);
+    return count;
+}
+
+static int writeBenchJson(const char *path, const BenchResult *r, int n, int numThreads)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("Unable to open benchmark output");
+        return -1;
+    }
+    fprintf(f, "{\n  \"rects\": %d,\n  \"queries\": %d,\n  \"repeats\": %d,\n  \"threads\": %d,\n  \"results\": [\n",
+            BENCH_RECTS, BENCH_QUERIES, BENCH_REPEATS, numThreads);
+    for (int i = 0; i < n; i++)
+        fprintf(f, "    {\"workload\": \"%s\", \"engine\": \"%s\", \"metric\": \"%s\", \"median\": %.9g, "
+                   "\"mad\": %.9g, \"n\": %d}%s\n",
+                r[i].workload, r[i].engine, r[i].metric, r[i].median, r[i].mad, r[i].n, i + 1 < n ? "," : "");
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return 0;
+}
+
+// Results of a file written by writeBenchJson; -1 if it cannot be read
+static int readBenchJson(const char *path, BenchResult *r, int max)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[512];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), f)) {
+        const char *p = strstr(line, "{\"workload\"");
+        if (!p) continue;
+        BenchResult *b = &r[n];
+        if (sscanf(p, "{\"workload\": \"%31[^\"]\", \"engine\": \"%31[^\"]\", \"metric\": \"%15[^\"]\", "
+                      "\"median\": %lf, \"mad\": %lf, \"n\": %d",
+                   b->workload, b->engine, b->metric, &b->median, &b->mad, &b->n) == 6)
+            n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static int metricKind(const char *metric)
+{
+    if (strcmp(metric, "bytes") == 0) return BENCH_EXACT_MEMORY;
+    if (strcmp(metric, "hits") == 0) return BENCH_EXACT_VALUE;
+    return strstr(metric, "qps") ? BENCH_HIGHER_BETTER : BENCH_LOWER_BETTER;
+}
+
+static double envDouble(const char *name, double fallback)
+{
+    const char *s = getenv(name);
+    return s && *s ? atof(s) : fallback;
+}
+
+// Print every metric against the baseline; returns the regression count
+static int compareBench(const BenchResult *cur, int n, const BenchResult *base, int numBase)
+{
+    double tol = envDouble("BENCH_TOL", 0.10), sigma = envDouble("BENCH_SIGMA", 3.0);
+    double memTol = envDouble("BENCH_MEM_TOL", 0.02);
+    int regressions = 0;
+    printf("\n[Bench] against baseline (time: worse by > %.0f%% and > %.1f sigma, memory: > %.1f%%)\n", tol * 100,
+           sigma, memTol * 100);
+    printf("%-10s %-9s %-9s %14s %14s %9s %8s  %s\n", "workload", "engine", "metric", "baseline", "current",
+           "change", "sigma", "verdict");
+    for (int i = 0; i < n; i++) {
+        const BenchResult *c = &cur[i], *b = NULL;
+        for (int j = 0; j < numBase && !b; j++)
+            if (!strcmp(base[j].workload, c->workload) && !strcmp(base[j].engine, c->engine) &&
+                !strcmp(base[j].metric, c->metric))
+                b = &base[j];
+        if (!b) {
+            printf("%-10s %-9s %-9s %14s %14.6g %9s %8s  new\n", c->workload, c->engine, c->metric, "-", c->median,
+                   "", "");
+            continue;
+        }
+        int kind = metricKind(c->metric);
+        // Worsening as a share of the baseline; positive is worse
+        double worse = b->median != 0 ? (kind == BENCH_HIGHER_BETTER ? b->median - c->median : c->median - b->median) /
+                                            fabs(b->median)
+                                      : 0;
+        double noise = 1.4826 * sqrt(b->mad * b->mad + c->mad * c->mad);
+        double z = noise > 0 ? fabs(c->median - b->median) / noise : INFINITY;
+        const char *verdict = "ok";
+        if (kind == BENCH_EXACT_VALUE) {
+            if (c->median != b->median) verdict = "CHANGED";
+        } else if (kind == BENCH_EXACT_MEMORY) {
+            if (worse > memTol) verdict = "REGRESSION";
+        } else if (worse > tol && z > sigma) {
+            verdict = "REGRESSION";
+        } else if (-worse > tol && z > sigma) {
+            verdict = "improved";
+        }
+        if (verdict[0] == 'R' || verdict[0] == 'C') regressions++;
+        printf("%-10s %-9s %-9s %14.6g %14.6g %+8.1f%% %8.1f  %s\n", c->workload, c->engine, c->metric, b->median,
+               c->median, kind == BENCH_HIGHER_BETTER ? -100 * worse : 100 * worse, isinf(z) ? 0.0 : z, verdict);
+    }
+    return regressions;
+}
+
+// ./rtree_cpu_baseline bench <out.json> [baseline.json]
+int benchMain(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s bench <out.json> [baseline.json]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int maxResults = BENCH_MAX_RESULTS;
+    BenchResult *results = (BenchResult *)malloc((size_t)maxResults * sizeof(BenchResult));
+    BenchResult *base = (BenchResult *)malloc((size_t)maxResults * sizeof(BenchResult));
+    Rect *rects = (Rect *)malloc(BENCH_RECTS * sizeof(Rect));
+    Rect *queries = (Rect *)malloc(BENCH_QUERIES * sizeof(Rect));
+    if (!results || !base || !rects || !queries) {
+        perror("Unable to allocate benchmark workload");
+        exit(EXIT_FAILURE);
+    }
+    static const char *const workloads[] = {"uniform", "clustered"};
+    int n = 0, mismatches = 0;
+    for (int w = 0; w < 2; w++) {
+        printf("[Bench] %s: %d rects, %d queries, %d repeats\n", workloads[w], BENCH_RECTS, BENCH_QUERIES,
+               BENCH_REPEATS);
+        benchWorkload(w, rects, queries);
+        n = benchRun(workloads[w], rects, queries, numThreads, results, n, &mismatches);
+    }
+    mkdir("Log", 0777);
+    // A wrong total fails the run whether or not there is a baseline
+    int status = mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (writeBenchJson(argv[2], results, n, numThreads) == 0)
+        printf("📁 Benchmark results saved to: %s\n", argv[2]);
+    else
+        status = EXIT_FAILURE;
+
+    if (argc >= 4) {
+        int numBase = readBenchJson(argv[3], base, maxResults);
+        if (numBase < 0) {
+            printf("No baseline at %s; record one with `make bench-baseline`\n", argv[3]);
+        } else {
+            int regressions = compareBench(results, n, base, numBase);
+            printf("%s %d regression%s against %s\n", regressions ? "❌" : "✅", regressions,
+                   regressions == 1 ? "" : "s", argv[3]);
+            if (regressions) status = EXIT_FAILURE;
+        }
+    } else {
+        for (int i = 0; i < n; i++)
+            printf("%-10s %-9s %-9s %14.6g ± %.3g\n", results[i].workload, results[i].engine, results[i].metric,
+                   results[i].median, results[i].mad);
+    }
+    if (mismatches)
+        printf("❌ %d overlap total%s disagreed with the pointer tree\n", mismatches, mismatches == 1 ? "" : "s");
+    free(results);
+    free(base);
+    free(rects);
+    free(queries);
+    return status;
+}
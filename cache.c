@@ -0,0 +1,435 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "rtree.h"
+
+// ---------------- Query result cache ----------------
+//
+// A ResultCache sits in front of a SpatialIndex and keeps the ids reported
+// for recent windows. The data space is cut into CACHE_SHARD_SIDE x
+// CACHE_SHARD_SIDE cells and a window lives in the shard of the cell holding
+// its center; every shard has its own lock, slots, exact-match hash chains
+// and share of the byte budget. A lookup:
+//
+//   exact hit      the same window is cached: return its ids
+//   contained hit  a cached window of the shard contains it: filter that
+//                  window's ids (the one with the fewest) against the rects,
+//                  since every rect meeting the inner window meets the outer
+//   miss           report ids from the index, then cache them
+//
+// A containing window in another shard is not found; that only costs the
+// hit. Slots are recycled with CLOCK, as in the paged tree's buffer pool.
+// Ids are positions in the rect array given to the cache, so an update that
+// keeps positions only has to drop the cached windows meeting the old and
+// new rects (resultCacheInvalidate). A miss queries the index without the
+// shard lock; if an invalidation ran in the meantime its ids may be stale,
+// so it is returned but not cached. resultCacheSetIndex must not run while
+// queries are in flight.
+
+#define CACHE_SHARD_SIDE 4
+#define CACHE_SHARDS (CACHE_SHARD_SIDE * CACHE_SHARD_SIDE)
+#define CACHE_SHARD_SLOTS 512
+#define CACHE_BUCKETS 1024
+#define CACHE_STACK_IDS 1024
+
+typedef struct {
+    uint32_t *ids;
+    int count;
+    int next;                       // hash chain, -1 ends it
+    unsigned char used;
+    unsigned char referenced;
+} CacheSlot;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Rect windows[CACHE_SHARD_SLOTS];  // apart from the slots for the containment scan
+    CacheSlot slots[CACHE_SHARD_SLOTS];
+    int buckets[CACHE_BUCKETS];
+    int numUsed, hand;
+    size_t bytes;
+    unsigned long generation;       // bumped by every resultCacheInvalidate
+    long long exactHits, containedHits, misses;
+    long long exactNs, containedNs, missNs;
+    long long inserts, evictions, invalidated;
+} CacheShard;
+
+struct ResultCache {
+    const SpatialIndex *index;
+    const Rect *rects;
+    MBR bounds;
+    long long spanX, spanY;
+    size_t shardBudget;             // id bytes per shard
+    CacheShard shards[CACHE_SHARDS];
+};
+
+static inline unsigned cacheHash(Rect r)
+{
+    uint64_t h = (uint32_t)r.xmin * 0x9E3779B1u;
+    h = (h ^ (uint32_t)r.ymin) * 0x85EBCA77u;
+    h = (h ^ (uint32_t)r.xmax) * 0xC2B2AE3Du;
+    h = (h ^ (uint32_t)r.ymax) * 0x27D4EB2Fu;
+    return (unsigned)(h ^ (h >> 29)) & (CACHE_BUCKETS - 1);
+}
+
+static inline int sameWindow(Rect a, Rect b)
+{
+    return a.xmin == b.xmin && a.ymin == b.ymin && a.xmax == b.xmax && a.ymax == b.ymax;
+}
+
+static inline int containsWindow(Rect outer, Rect inner)
+{
+    return outer.xmin <= inner.xmin && outer.ymin <= inner.ymin && outer.xmax >= inner.xmax &&
+           outer.ymax >= inner.ymax;
+}
+
+static CacheShard *shardOfWindow(ResultCache *c, Rect q)
+{
+    long long cx = ((long long)q.xmin + q.xmax) / 2 - c->bounds.xmin;
+    long long cy = ((long long)q.ymin + q.ymax) / 2 - c->bounds.ymin;
+    long long sx = cx * CACHE_SHARD_SIDE / c->spanX, sy = cy * CACHE_SHARD_SIDE / c->spanY;
+    sx = sx < 0 ? 0 : sx >= CACHE_SHARD_SIDE ? CACHE_SHARD_SIDE - 1 : sx;
+    sy = sy < 0 ? 0 : sy >= CACHE_SHARD_SIDE ? CACHE_SHARD_SIDE - 1 : sy;
+    return &c->shards[sy * CACHE_SHARD_SIDE + sx];
+}
+
+static void setBounds(ResultCache *c, const Rect *rects, int numRects)
+{
+    MBR b = {0, 0, 0, 0};
+    if (numRects > 0) b = rects[0];
+    for (int i = 1; i < numRects; i++) b = unionJoin(&b, (MBR *)&rects[i]);
+    c->bounds = b;
+    c->spanX = (long long)b.xmax - b.xmin + 1;
+    c->spanY = (long long)b.ymax - b.ymin + 1;
+}
+
+ResultCache *createResultCache(const SpatialIndex *index, const Rect *rects, int numRects, size_t budgetBytes)
+{
+    ResultCache *c = (ResultCache *)calloc(1, sizeof(ResultCache));
+    if (!c) {
+        perror("Unable to allocate result cache");
+        exit(EXIT_FAILURE);
+    }
+    c->index = index;
+    c->rects = rects;
+    c->shardBudget = budgetBytes / CACHE_SHARDS;
+    setBounds(c, rects, numRects);
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        pthread_mutex_init(&c->shards[s].lock, NULL);
+        for (int b = 0; b < CACHE_BUCKETS; b++) c->shards[s].buckets[b] = -1;
+    }
+    return c;
+}
+
+// ---- slots (shard lock held) ----
+
+static int findExact(const CacheShard *sh, Rect q)
+{
+    for (int i = sh->buckets[cacheHash(q)]; i >= 0; i = sh->slots[i].next)
+        if (sameWindow(sh->windows[i], q)) return i;
+    return -1;
+}
+
+static void removeSlot(CacheShard *sh, int i)
+{
+    int *link = &sh->buckets[cacheHash(sh->windows[i])];
+    while (*link != i) link = &sh->slots[*link].next;
+    *link = sh->slots[i].next;
+    sh->bytes -= (size_t)sh->slots[i].count * sizeof(uint32_t);
+    free(sh->slots[i].ids);
+    sh->slots[i] = (CacheSlot){NULL, 0, -1, 0, 0};
+    sh->numUsed--;
+}
+
+// CLOCK: give referenced slots a second chance
+static void evictOne(CacheShard *sh)
+{
+    for (;;) {
+        int i = sh->hand;
+        sh->hand = (sh->hand + 1) % CACHE_SHARD_SLOTS;
+        if (!sh->slots[i].used) continue;
+        if (sh->slots[i].referenced) {
+            sh->slots[i].referenced = 0;
+            continue;
+        }
+        removeSlot(sh, i);
+        sh->evictions++;
+        return;
+    }
+}
+
+static void insertSlot(ResultCache *c, CacheShard *sh, Rect q, const uint32_t *ids, int count)
+{
+    size_t need = (size_t)count * sizeof(uint32_t);
+    if (need > c->shardBudget / 4 || findExact(sh, q) >= 0) return;
+    while (sh->numUsed == CACHE_SHARD_SLOTS || (sh->numUsed > 0 && sh->bytes + need > c->shardBudget))
+        evictOne(sh);
+    int i = 0;
+    while (sh->slots[i].used) i++;
+    uint32_t *copy = (uint32_t *)malloc(need ? need : 1);
+    if (!copy) {
+        perror("Unable to allocate cached result");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, ids, need);
+    unsigned b = cacheHash(q);
+    sh->windows[i] = q;
+    sh->slots[i] = (CacheSlot){copy, count, sh->buckets[b], 1, 1};
+    sh->buckets[b] = i;
+    sh->numUsed++;
+    sh->bytes += need;
+    sh->inserts++;
+}
+
+// ---- queries ----
+
+// Count of rects overlapping q; the first maxOut of their ids go to `ids`
+// (may be NULL).
+int resultCacheQuery(ResultCache *c, Rect q, uint32_t *ids, int maxOut)
+{
+    CacheShard *sh = shardOfWindow(c, q);
+    long long t0 = (long long)(nowSeconds() * 1e9);
+
+    pthread_mutex_lock(&sh->lock);
+    int hit = findExact(sh, q);
+    if (hit >= 0) {
+        CacheSlot *s = &sh->slots[hit];
+        s->referenced = 1;
+        int n = s->count;
+        if (ids) memcpy(ids, s->ids, (size_t)(n < maxOut ? n : maxOut) * sizeof(uint32_t));
+        sh->exactHits++;
+        sh->exactNs += (long long)(nowSeconds() * 1e9) - t0;
+        pthread_mutex_unlock(&sh->lock);
+        return n;
+    }
+    int best = -1;
+    for (int i = 0; i < CACHE_SHARD_SLOTS; i++)
+        if (sh->slots[i].used && containsWindow(sh->windows[i], q) &&
+            (best < 0 || sh->slots[i].count < sh->slots[best].count))
+            best = i;
+    if (best >= 0) {
+        CacheSlot *s = &sh->slots[best];
+        s->referenced = 1;
+        int n = 0;
+        for (int k = 0; k < s->count; k++) {
+            if (!isOverlap_inline(&c->rects[s->ids[k]], q)) continue;
+            if (ids && n < maxOut) ids[n] = s->ids[k];
+            n++;
+        }
+        sh->containedHits++;
+        sh->containedNs += (long long)(nowSeconds() * 1e9) - t0;
+        pthread_mutex_unlock(&sh->lock);
+        return n;
+    }
+    unsigned long generation = sh->generation;
+    pthread_mutex_unlock(&sh->lock);
+
+    uint32_t stackIds[CACHE_STACK_IDS];
+    uint32_t *found = stackIds;
+    int n = spatialIndexReport(c->index, q, found, CACHE_STACK_IDS);
+    if (n > CACHE_STACK_IDS) {
+        found = (uint32_t *)malloc((size_t)n * sizeof(uint32_t));
+        if (!found) {
+            perror("Unable to allocate result ids");
+            exit(EXIT_FAILURE);
+        }
+        n = spatialIndexReport(c->index, q, found, n);
+    }
+    if (ids) memcpy(ids, found, (size_t)(n < maxOut ? n : maxOut) * sizeof(uint32_t));
+
+    pthread_mutex_lock(&sh->lock);
+    // An invalidation since the lookup may have missed these ids
+    if (sh->generation == generation) insertSlot(c, sh, q, found, n);
+    sh->misses++;
+    sh->missNs += (long long)(nowSeconds() * 1e9) - t0;
+    pthread_mutex_unlock(&sh->lock);
+    if (found != stackIds) free(found);
+    return n;
+}
+
+int resultCacheSearch(const void *cache, Rect q)
+{
+    return resultCacheQuery((ResultCache *)cache, q, NULL, 0);
+}
+
+// Drop the cached windows meeting any of the n changed rects (the old and
+// new version of every updated rect), or every window if changed is NULL.
+void resultCacheInvalidate(ResultCache *c, const Rect *changed, int n)
+{
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        CacheShard *sh = &c->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        sh->generation++;
+        for (int i = 0; i < CACHE_SHARD_SLOTS; i++) {
+            if (!sh->slots[i].used) continue;
+            int hit = !changed;
+            for (int k = 0; k < n && !hit; k++) hit = isOverlap_inline(&sh->windows[i], changed[k]);
+            if (!hit) continue;
+            removeSlot(sh, i);
+            sh->invalidated++;
+        }
+        pthread_mutex_unlock(&sh->lock);
+    }
+}
+
+// Point the cache at an index rebuilt over `rects`, whose positions (ids)
+// must match the old array; invalidate the changed windows first.
+void resultCacheSetIndex(ResultCache *c, const SpatialIndex *index, const Rect *rects)
+{
+    c->index = index;
+    c->rects = rects;
+}
+
+size_t resultCacheBytes(const ResultCache *c)
+{
+    size_t bytes = sizeof(ResultCache);
+    for (int s = 0; s < CACHE_SHARDS; s++) bytes += c->shards[s].bytes;
+    return bytes;
+}
+
+void printResultCacheStats(ResultCache *c)
+{
+    long long v[9] = {0};
+    int entries = 0;
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        CacheShard *sh = &c->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        long long w[9] = {sh->exactHits, sh->containedHits, sh->misses, sh->exactNs, sh->containedNs,
+                          sh->missNs, sh->inserts, sh->evictions, sh->invalidated};
+        for (int k = 0; k < 9; k++) v[k] += w[k];
+        entries += sh->numUsed;
+        pthread_mutex_unlock(&sh->lock);
+    }
+    long long total = v[0] + v[1] + v[2];
+    if (total == 0) total = 1;
+    printf("  lookups %lld: exact %.1f%% (%.2f us), contained %.1f%% (%.2f us), miss %.1f%% (%.2f us)\n",
+           v[0] + v[1] + v[2], 100.0 * v[0] / total, v[0] ? v[3] / 1e3 / v[0] : 0.0, 100.0 * v[1] / total,
+           v[1] ? v[4] / 1e3 / v[1] : 0.0, 100.0 * v[2] / total, v[2] ? v[5] / 1e3 / v[2] : 0.0);
+    printf("  %d windows cached in %.2f MB, %lld inserted, %lld evicted, %lld invalidated\n", entries,
+           resultCacheBytes(c) / (1024.0 * 1024.0), v[6], v[7], v[8]);
+}
+
+void destroyResultCache(ResultCache *c)
+{
+    if (!c) return;
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        for (int i = 0; i < CACHE_SHARD_SLOTS; i++) free(c->shards[s].slots[i].ids);
+        pthread_mutex_destroy(&c->shards[s].lock);
+    }
+    free(c);
+}
+
+// ---- benchmark ----
+
+#define CACHE_HOT 256
+#define CACHE_BUDGET (32u << 20)
+#define CACHE_MOVED 200
+
+// Stream with repeats: 40% one of CACHE_HOT windows (skewed), 30% a window
+// nested in one of them, 30% the next window of the query set.
+static Rect *makeCacheStream(const Rect *queries, int numQuery, int n)
+{
+    Rect *w = (Rect *)malloc((size_t)n * sizeof(Rect));
+    if (!w) {
+        perror("Unable to allocate cache stream");
+        exit(EXIT_FAILURE);
+    }
+    unsigned int seed = 45u;
+    int hot = numQuery < CACHE_HOT ? numQuery : CACHE_HOT;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned r = seed >> 8;
+        int h = (int)(((long long)(r % hot) * ((r >> 9) % hot)) / hot);
+        Rect base = queries[(long long)h * numQuery / hot];
+        int kind = (int)((r >> 18) % 10);
+        if (kind < 4) {
+            w[i] = base;
+        } else if (kind < 7) {
+            long long width = (long long)base.xmax - base.xmin, height = (long long)base.ymax - base.ymin;
+            long long nw = width * (20 + (r >> 4) % 61) / 100, nh = height * (20 + (r >> 11) % 61) / 100;
+            long long ox = (width - nw) * ((r >> 3) % 101) / 100, oy = (height - nh) * ((r >> 13) % 101) / 100;
+            w[i] = (Rect){(int)(base.xmin + ox), (int)(base.ymin + oy), (int)(base.xmin + ox + nw),
+                          (int)(base.ymin + oy + nh)};
+        } else {
+            w[i] = queries[i % numQuery];
+        }
+    }
+    return w;
+}
+
+static double runStream(QueryPool *pool, QuerySearchFn search, const void *index, const Rect *w, int *results,
+                        int n)
+{
+    QueryCompletion sink[256];
+    double t0 = nowSeconds();
+    uint32_t ticket = submitIndexQueries(pool, search, index, w, results, n, 256, NULL, NULL);
+    while (waitCompletions(pool, sink, 256) > 0) {
+    }
+    waitTicket(pool, ticket);
+    return nowSeconds() - t0;
+}
+
+// Run a repeating stream through the index alone and through the cache
+// (cold, then warm), move some rects, invalidate, and check again.
+void resultCacheBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, int numThreads)
+{
+    if (numRects <= 0 || numQuery <= 0) return;
+    int n = 2 * numQuery;
+    Rect *data = (Rect *)malloc((size_t)numRects * sizeof(Rect));
+    int *expect = (int *)malloc((size_t)n * sizeof(int));
+    int *got = (int *)malloc((size_t)n * sizeof(int));
+    if (!data || !expect || !got) {
+        perror("Unable to allocate cache benchmark buffers");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(data, rects, (size_t)numRects * sizeof(Rect));
+    Rect *w = makeCacheStream(queries, numQuery, n);
+    SpatialIndex *idx = buildSpatialIndex(&rtreeIndexOps, data, numRects);
+    QueryPool *pool = createQueryPool(NULL, numThreads, 4096);
+    ResultCache *c = createResultCache(idx, data, numRects, CACHE_BUDGET);
+    int ok = 1;
+
+    printf("\n[Result cache] %d shards, %.0f MB budget, %d windows (40%% repeated, 30%% nested), %d threads\n",
+           CACHE_SHARDS, CACHE_BUDGET / (1024.0 * 1024.0), n, numThreads);
+    double base = runStream(pool, spatialIndexSearch, idx, w, expect, n);
+    printf("%-22s %10.4f s\n", "index only", base);
+    for (int pass = 0; pass < 2; pass++) {
+        double t = runStream(pool, resultCacheSearch, c, w, got, n);
+        for (int i = 0; i < n; i++) ok &= got[i] == expect[i];
+        printf("%-22s %10.4f s (%.2fx)\n", pass ? "cache, warm" : "cache, cold", t, t > 0 ? base / t : 0.0);
+    }
+    printResultCacheStats(c);
+
+    // Move CACHE_MOVED rects by half their size, rebuild and invalidate
+    Rect changed[2 * CACHE_MOVED];
+    int moved = numRects < CACHE_MOVED ? numRects : CACHE_MOVED;
+    for (int k = 0; k < moved; k++) {
+        Rect *r = &data[(long long)k * numRects / moved];
+        changed[2 * k] = *r;
+        int dx = (r->xmax - r->xmin) / 2 + 1, dy = (r->ymax - r->ymin) / 2 + 1;
+        r->xmin += dx;
+        r->xmax += dx;
+        r->ymin += dy;
+        r->ymax += dy;
+        changed[2 * k + 1] = *r;
+    }
+    SpatialIndex *updated = buildSpatialIndex(&rtreeIndexOps, data, numRects);
+    resultCacheInvalidate(c, changed, 2 * moved);
+    resultCacheSetIndex(c, updated, data);
+    runStream(pool, spatialIndexSearch, updated, w, expect, n);
+    double t = runStream(pool, resultCacheSearch, c, w, got, n);
+    for (int i = 0; i < n; i++) ok &= got[i] == expect[i];
+    printf("%-22s %10.4f s after moving %d rects\n", "cache, invalidated", t, moved);
+    printResultCacheStats(c);
+    printf("%s Cached results %s the index\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+
+    destroyResultCache(c);
+    destroyQueryPool(pool);
+    freeSpatialIndex(idx);
+    freeSpatialIndex(updated);
+    free(w);
+    free(got);
+    free(expect);
+    free(data);
+}
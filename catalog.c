@@ -0,0 +1,363 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "rtree.h"
+
+// ---------------- Index catalog ----------------
+//
+// An IndexCatalog holds any number of named indexes at once: pointer trees
+// built from the dataset loaders or handed in, and linearized trees loaded
+// from a saveFlatTree snapshot. Every index is charged its footprint
+// (rtreeBytes / flatTreeBytes) against the catalog's memory budget, and an add
+// that would exceed the budget is refused.
+//
+// All indexes share one QueryPool. catalogQueryMixed takes queries tagged
+// with an index, groups them per index, submits every group to the pool and
+// waits; the pool's workers move from one index to the next instead of one
+// thread set per index competing for the same cores. Per-index query, hit
+// and busy-time counters are kept from the chunk completions.
+
+#define CATALOG_NAME 32
+#define CATALOG_CHUNK 512
+#define CATALOG_MIXED_BATCH (1 << 20)     // queries per catalogQueryMixed call in main
+
+typedef struct {
+    char name[CATALOG_NAME];
+    char source[64];
+    int kind;                       // CATALOG_TREE or CATALOG_FLAT
+    Node *root;
+    FlatTree *flat;
+    int owned;                      // freed with the catalog
+    int numRects;
+    size_t bytes;
+    _Atomic long long queries;
+    _Atomic long long hits;
+    _Atomic long long busyNs;       // worker time spent on this index
+} CatalogEntry;
+
+enum { CATALOG_TREE, CATALOG_FLAT };
+
+struct IndexCatalog {
+    CatalogEntry **entries;
+    int count, cap;
+    size_t budget;                  // 0 = unlimited
+    size_t used;
+    QueryPool *pool;
+};
+
+IndexCatalog *createIndexCatalog(size_t memoryBudget, int numThreads)
+{
+    IndexCatalog *cat = (IndexCatalog *)calloc(1, sizeof(IndexCatalog));
+    if (!cat) {
+        perror("Unable to allocate index catalog");
+        exit(EXIT_FAILURE);
+    }
+    cat->budget = memoryBudget;
+    cat->pool = createQueryPool(NULL, numThreads, 4096);
+    return cat;
+}
+
+void catalogSetBudget(IndexCatalog *cat, size_t memoryBudget)
+{
+    cat->budget = memoryBudget;
+}
+
+size_t catalogBytes(const IndexCatalog *cat)
+{
+    return cat->used;
+}
+
+int catalogFind(const IndexCatalog *cat, const char *name)
+{
+    for (int i = 0; i < cat->count; i++)
+        if (strcmp(cat->entries[i]->name, name) == 0) return i;
+    return -1;
+}
+
+static int addEntry(IndexCatalog *cat, const char *name, const char *source, int kind, Node *root,
+                    FlatTree *flat, int owned, int numRects, size_t bytes)
+{
+    if (catalogFind(cat, name) >= 0) {
+        fprintf(stderr, "Index %s already exists\n", name);
+        return -1;
+    }
+    if (cat->budget && cat->used + bytes > cat->budget) {
+        fprintf(stderr, "Index %s (%.2f MB) exceeds the catalog budget (%.2f of %.2f MB used)\n", name,
+                bytes / (1024.0 * 1024.0), cat->used / (1024.0 * 1024.0), cat->budget / (1024.0 * 1024.0));
+        return -1;
+    }
+    if (cat->count == cat->cap) {
+        cat->cap = cat->cap ? cat->cap * 2 : 8;
+        cat->entries = (CatalogEntry **)realloc(cat->entries, (size_t)cat->cap * sizeof(CatalogEntry *));
+        if (!cat->entries) {
+            perror("Unable to grow index catalog");
+            exit(EXIT_FAILURE);
+        }
+    }
+    CatalogEntry *e = (CatalogEntry *)calloc(1, sizeof(CatalogEntry));
+    if (!e) {
+        perror("Unable to allocate catalog entry");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    snprintf(e->source, sizeof(e->source), "%s", source);
+    e->kind = kind;
+    e->root = root;
+    e->flat = flat;
+    e->owned = owned;
+    e->numRects = numRects;
+    e->bytes = bytes;
+    cat->used += bytes;
+    cat->entries[cat->count] = e;
+    return cat->count++;
+}
+
+// Register an existing tree. With owned set the catalog frees it.
+int catalogAddTree(IndexCatalog *cat, const char *name, Node *root, int numRects, int owned)
+{
+    return addEntry(cat, name, "tree", CATALOG_TREE, root, NULL, owned, numRects, rtreeBytes(root));
+}
+
+// Load one of the six datasets (the options of selectDataDataset) and build
+// it with createRTree_STR_2. Returns the index number or -1.
+int catalogAddDataset(IndexCatalog *cat, const char *name, int option)
+{
+    int numRects;
+    Rect *rects = selectDataDataset(&numRects, option);
+    if (!rects) {
+        fprintf(stderr, "Index %s: unable to read %s\n", name, dataDatasetPath(option));
+        return -1;
+    }
+    Node *root = createRTree_STR_2(rects, 0, numRects - 1);
+    free(rects);
+    int idx = addEntry(cat, name, dataDatasetPath(option), CATALOG_TREE, root, NULL, 1, numRects,
+                       rtreeBytes(root));
+    if (idx < 0) freeRTree(root);
+    return idx;
+}
+
+// Map a saveFlatTree snapshot as an index.
+int catalogAddSnapshot(IndexCatalog *cat, const char *name, const char *path)
+{
+    FlatTree *flat = loadFlatTree(path);
+    if (!flat) {
+        fprintf(stderr, "Index %s: unable to load snapshot %s\n", name, path);
+        return -1;
+    }
+    int idx = addEntry(cat, name, path, CATALOG_FLAT, NULL, flat, 1, (int)flat->numRects, flatTreeBytes(flat));
+    if (idx < 0) freeFlatTree(flat);
+    return idx;
+}
+
+void catalogRemove(IndexCatalog *cat, int index)
+{
+    CatalogEntry *e = cat->entries[index];
+    if (e->owned) {
+        if (e->kind == CATALOG_TREE) freeRTree(e->root);
+        else freeFlatTree(e->flat);
+    }
+    cat->used -= e->bytes;
+    free(e);
+    memmove(cat->entries + index, cat->entries + index + 1, (size_t)(cat->count - index - 1) * sizeof(CatalogEntry *));
+    cat->count--;
+}
+
+static int searchTreeEntry(const void *index, Rect q)
+{
+    return searchRTree(((const CatalogEntry *)index)->root, q, 0);
+}
+
+static int searchFlatEntry(const void *index, Rect q)
+{
+    return searchFlatTree(((const CatalogEntry *)index)->flat, q);
+}
+
+static void groupDone(const QueryCompletion *c, void *user)
+{
+    CatalogEntry *e = (CatalogEntry *)user;
+    atomic_fetch_add(&e->queries, c->count);
+    atomic_fetch_add(&e->hits, c->hits);
+    atomic_fetch_add(&e->busyNs, c->ns);
+}
+
+// Answer every window against its catalog index, with the group of each
+// index running on the shared pool. results follow the order of queries. Returns the total count.
+long long catalogQueryMixed(IndexCatalog *cat, const CatalogQuery *queries, int numQuery, int *results)
+{
+    int *groupCount = (int *)calloc((size_t)cat->count + 1, sizeof(int));
+    int *slot = (int *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(int));
+    Rect *grouped = (Rect *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(Rect));
+    int *groupResults = (int *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(int));
+    uint32_t *tickets = (uint32_t *)malloc(((size_t)cat->count + 1) * sizeof(uint32_t));
+    if (!groupCount || !slot || !grouped || !groupResults || !tickets) {
+        perror("Unable to allocate mixed batch");
+        exit(EXIT_FAILURE);
+    }
+    // Counting sort by index keeps each group contiguous and in caller order
+    for (int i = 0; i < numQuery; i++) {
+        results[i] = 0;
+        if (queries[i].index >= 0 && queries[i].index < cat->count) groupCount[queries[i].index + 1]++;
+    }
+    for (int g = 0; g < cat->count; g++) groupCount[g + 1] += groupCount[g];
+    int *fill = (int *)malloc(((size_t)cat->count + 1) * sizeof(int));
+    memcpy(fill, groupCount, ((size_t)cat->count + 1) * sizeof(int));
+    for (int i = 0; i < numQuery; i++) {
+        int g = queries[i].index;
+        if (g < 0 || g >= cat->count) continue;
+        slot[fill[g]] = i;
+        grouped[fill[g]++] = queries[i].window;
+    }
+    free(fill);
+
+    int numTickets = 0;
+    for (int g = 0; g < cat->count; g++) {
+        int n = groupCount[g + 1] - groupCount[g];
+        if (n == 0) continue;
+        CatalogEntry *e = cat->entries[g];
+        tickets[numTickets++] = submitIndexQueries(cat->pool, e->kind == CATALOG_TREE ? searchTreeEntry : searchFlatEntry,
+                                                   e, grouped + groupCount[g], groupResults + groupCount[g], n,
+                                                   CATALOG_CHUNK, groupDone, e);
+    }
+    for (int t = 0; t < numTickets; t++) waitTicket(cat->pool, tickets[t]);
+
+    long long total = 0;
+    int numGrouped = groupCount[cat->count];
+    for (int k = 0; k < numGrouped; k++) {
+        results[slot[k]] = groupResults[k];
+        total += groupResults[k];
+    }
+    free(groupCount);
+    free(slot);
+    free(grouped);
+    free(groupResults);
+    free(tickets);
+    return total;
+}
+
+void printIndexCatalog(const IndexCatalog *cat)
+{
+    printf("%-16s %-5s %10s %10s %12s %14s %10s %s\n", "index", "kind", "rects", "MB", "queries", "hits",
+           "busy (s)", "source");
+    for (int i = 0; i < cat->count; i++) {
+        const CatalogEntry *e = cat->entries[i];
+        printf("%-16s %-5s %10d %10.2f %12lld %14lld %10.4f %s\n", e->name,
+               e->kind == CATALOG_TREE ? "tree" : "flat", e->numRects, e->bytes / (1024.0 * 1024.0),
+               atomic_load(&e->queries), atomic_load(&e->hits), atomic_load(&e->busyNs) / 1e9, e->source);
+    }
+    if (cat->budget)
+        printf("%.2f of %.2f MB budget in use\n", cat->used / (1024.0 * 1024.0), cat->budget / (1024.0 * 1024.0));
+    else
+        printf("%.2f MB in use, no budget\n", cat->used / (1024.0 * 1024.0));
+}
+
+void destroyIndexCatalog(IndexCatalog *cat)
+{
+    destroyQueryPool(cat->pool);
+    while (cat->count > 0) catalogRemove(cat, cat->count - 1);
+    free(cat->entries);
+    free(cat);
+}
+
+// ---- benchmark ----
+
+typedef struct {
+    QueryPool *pool;
+    uint32_t ticket;
+} OwnPool;
+
+// The current tree, a snapshot of it and one more dataset in one catalog:
+// a mixed batch on the shared pool against one pool per index.
+void catalogBenchmark(Node *root, int numRects, const Rect *queries, int numQuery, int dataset_option,
+                      int numThreads, long long expected)
+{
+    static const char *names[] = {"uniform", "sports-999k", "sports-1.7m", "parks", "cemetery", "lakes"};
+    const char *snapPath = "Log/catalog_snapshot.flat";
+    IndexCatalog *cat = createIndexCatalog(0, numThreads);
+    printf("\n[Index catalog] shared pool of %d threads\n", numThreads);
+
+    catalogAddTree(cat, "current", root, numRects, 0);
+    FlatTree *flat = createFlatTree(root, FLAT_BFS);
+    mkdir("Log", 0777);
+    int saved = saveFlatTree(flat, snapPath) == 0;
+    freeFlatTree(flat);
+    if (saved) catalogAddSnapshot(cat, "current-snap", snapPath);
+    int other = dataset_option == 5 ? 4 : 5;
+    catalogAddDataset(cat, names[other - 1], other);
+
+    // A further copy must not fit once the budget is what is in use
+    catalogSetBudget(cat, catalogBytes(cat));
+    Node *copy = cloneRTree(root);
+    int refused = catalogAddTree(cat, "current-copy", copy, numRects, 1) < 0;
+    if (refused) freeRTree(copy);
+    catalogSetBudget(cat, 0);
+
+    // Every query against every index, interleaved
+    int numIdx = cat->count;
+    long long total = (long long)numQuery * numIdx;
+    CatalogQuery *mixed = (CatalogQuery *)malloc((size_t)total * sizeof(CatalogQuery));
+    int *results = (int *)malloc((size_t)total * sizeof(int));
+    if (!mixed || !results) {
+        perror("Unable to allocate catalog benchmark");
+        exit(EXIT_FAILURE);
+    }
+    for (int q = 0; q < numQuery; q++)
+        for (int i = 0; i < numIdx; i++) mixed[(long long)q * numIdx + i] = (CatalogQuery){i, queries[q]};
+
+    // catalogQueryMixed takes an int count; feed it bounded slices
+    double t0 = nowSeconds();
+    long long hits = 0;
+    for (long long k = 0; k < total; k += CATALOG_MIXED_BATCH) {
+        int n = total - k < CATALOG_MIXED_BATCH ? (int)(total - k) : CATALOG_MIXED_BATCH;
+        hits += catalogQueryMixed(cat, mixed + k, n, results + k);
+    }
+    double sharedTime = nowSeconds() - t0;
+
+    // Reference: per index sums, and one pool per index all running at once
+    int ok = refused;
+    long long *perIndex = (long long *)calloc((size_t)numIdx, sizeof(long long));
+    for (long long k = 0; k < total; k++) perIndex[k % numIdx] += results[k];
+    Rect *windows = (Rect *)malloc((size_t)numQuery * sizeof(Rect));
+    int *own = (int *)malloc((size_t)numQuery * numIdx * sizeof(int));
+    OwnPool *pools = (OwnPool *)malloc((size_t)numIdx * sizeof(OwnPool));
+    for (int q = 0; q < numQuery; q++) windows[q] = queries[q];
+    t0 = nowSeconds();
+    for (int i = 0; i < numIdx; i++) {
+        CatalogEntry *e = cat->entries[i];
+        pools[i].pool = createQueryPool(NULL, numThreads, 4096);
+        pools[i].ticket = submitIndexQueries(pools[i].pool, e->kind == CATALOG_TREE ? searchTreeEntry : searchFlatEntry,
+                                             e, windows, own + (size_t)i * numQuery, numQuery, CATALOG_CHUNK,
+                                             NULL, NULL);
+    }
+    for (int i = 0; i < numIdx; i++) {
+        QueryCompletion sink[256];
+        while (waitCompletions(pools[i].pool, sink, 256) > 0) {}
+        waitTicket(pools[i].pool, pools[i].ticket);
+    }
+    double ownTime = nowSeconds() - t0;
+    for (int i = 0; i < numIdx; i++) destroyQueryPool(pools[i].pool);
+
+    for (int i = 0; i < numIdx; i++) {
+        long long ref = 0;
+        for (int q = 0; q < numQuery; q++) ref += own[(size_t)i * numQuery + q];
+        ok &= ref == perIndex[i];
+        if (cat->entries[i]->root == root || cat->entries[i]->kind == CATALOG_FLAT) ok &= perIndex[i] == expected;
+    }
+    printIndexCatalog(cat);
+    printf("Mixed batch of %lld queries over %d indexes: shared pool %.4f s, one pool per index %.4f s (%lld overlaps)\n",
+           total, numIdx, sharedTime, ownTime, hits);
+    printf("Budget check: a copy of the current tree was %s\n", refused ? "refused" : "accepted");
+    printf("%s Catalog results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+
+    free(mixed);
+    free(results);
+    free(perIndex);
+    free(windows);
+    free(own);
+    free(pools);
+    destroyIndexCatalog(cat);
+    if (saved) remove(snapPath);
+}
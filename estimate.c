@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Approximate counts with error bounds ----------------
+//
+// The estimator is a compact copy of the tree without leaf payloads: every
+// node keeps its MBR and the number of rects below it, and every leaf keeps a
+// systematic sample of APPROX_SAMPLE of its rects (about 3% of a full leaf).
+// A query walks this summary only:
+//
+//   node inside the window    -> all its rects are hits (exact)
+//   node disjoint             -> none are hits (exact)
+//   leaf partially overlapped -> between 0 and count hits; the hit fraction
+//                                is estimated from the leaf's sample
+//
+// This gives a guaranteed [lowerBound, upperBound] and a 95% interval from
+// the sampling variance of every partial leaf (without replacement, with an
+// Agresti-Coull adjusted fraction so all-hit or no-hit samples still carry
+// uncertainty). With a target relative error the exact searchRTree runs
+// whenever the interval is wider.
+
+#define APPROX_Z 1.96
+#define APPROX_SAMPLE 32
+
+// DFS copy of `node` at slot `idx`; children are laid out contiguously.
+static long long approxCopy(ApproxEstimator *e, const Node *node, int idx, int *next)
+{
+    ApproxNode *a = &e->nodes[idx];
+    a->mbr = node->mbr;
+    if (node->isLeaf) {
+        int s = node->count < APPROX_SAMPLE ? node->count : APPROX_SAMPLE;
+        a->first = -1;
+        a->count = s;
+        a->rects = node->count;
+        a->sample = e->numSamples;
+        // Leaves are Y-sorted runs, so an even stride spreads the sample
+        for (int i = 0; i < s; i++)
+            e->samples[e->numSamples++] = node->rects[(long long)i * node->count / s];
+        return node->count;
+    }
+
+    a->first = *next;
+    a->count = node->count;
+    a->sample = -1;
+    *next += node->count;
+    long long total = 0;
+    for (int i = 0; i < node->count; i++)
+        total += approxCopy(e, node->children[i], a->first + i, next);
+    a->rects = total;
+    return total;
+}
+
+static void countNodes(const Node *node, int *nodes, int *leaves)
+{
+    (*nodes)++;
+    if (node->isLeaf) {
+        (*leaves)++;
+        return;
+    }
+    for (int i = 0; i < node->count; i++) countNodes(node->children[i], nodes, leaves);
+}
+
+ApproxEstimator *createApproxEstimator(Node *root)
+{
+    ApproxEstimator *e = (ApproxEstimator *)calloc(1, sizeof(ApproxEstimator));
+    if (!e) {
+        perror("Unable to allocate estimator");
+        exit(EXIT_FAILURE);
+    }
+    if (!root) return e;
+
+    int leaves = 0;
+    countNodes(root, &e->numNodes, &leaves);
+    e->nodes = (ApproxNode *)malloc((size_t)e->numNodes * sizeof(ApproxNode));
+    e->samples = (Rect *)malloc((size_t)leaves * APPROX_SAMPLE * sizeof(Rect));
+    if (!e->nodes || !e->samples) {
+        perror("Unable to allocate estimator nodes");
+        exit(EXIT_FAILURE);
+    }
+    int next = 1;
+    approxCopy(e, root, 0, &next);
+    return e;
+}
+
+static inline int mbrContains(const MBR *outer, const MBR *inner)
+{
+    return outer->xmin <= inner->xmin && outer->ymin <= inner->ymin &&
+           outer->xmax >= inner->xmax && outer->ymax >= inner->ymax;
+}
+
+ApproxCount approxCount(const ApproxEstimator *e, Node *root, Rect q, double targetRelErr)
+{
+    ApproxCount r = {0};
+    if (e->numNodes == 0) return r;
+
+    int stack[4096];
+    int top = 0;
+    double variance = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const ApproxNode *a = &e->nodes[stack[--top]];
+        if (!isOverlap_inline(&a->mbr, q)) continue;
+        if (mbrContains(&q, &a->mbr)) {
+            r.lowerBound += a->rects;
+            r.upperBound += a->rects;
+            r.estimate += (double)a->rects;
+            continue;
+        }
+        if (a->first >= 0 && top + a->count > (int)(sizeof(stack) / sizeof(stack[0]))) {
+            // FANOUT-wide trees need (FANOUT - 1) slots per level; 4096 is ~32 levels
+            fprintf(stderr, "approxCount: summary deeper than its stack\n");
+            exit(EXIT_FAILURE);
+        }
+        if (a->first >= 0) {
+            for (int c = 0; c < a->count; c++)
+                stack[top++] = a->first + c;
+            continue;
+        }
+
+        // Partially covered leaf: estimate from its sample
+        const Rect *smp = &e->samples[a->sample];
+        int hits = 0;
+        for (int i = 0; i < a->count; i++)
+            if (isOverlap_inline((const MBR *)&smp[i], q)) hits++;
+        double N = (double)a->rects, n = a->count;
+        double p = hits / n;
+        double pa = (hits + 2.0) / (n + 4.0);
+        double fpc = N > 1 ? (N - n) / (N - 1) : 0;
+        r.upperBound += a->rects;
+        r.estimate += N * p;
+        variance += N * N * pa * (1 - pa) / n * fpc;
+    }
+
+    double half = APPROX_Z * sqrt(variance);
+    r.low = r.estimate - half;
+    r.high = r.estimate + half;
+    if (r.low < (double)r.lowerBound) r.low = (double)r.lowerBound;
+    if (r.high > (double)r.upperBound) r.high = (double)r.upperBound;
+
+    // Accuracy target: fall back to the exact count when the interval is wider
+    if (targetRelErr > 0 && (r.high - r.low) / 2 > targetRelErr * (r.estimate > 1 ? r.estimate : 1)) {
+        int exact = searchRTree(root, q, 0);
+        r.estimate = r.low = r.high = exact;
+        r.lowerBound = r.upperBound = exact;
+        r.exact = 1;
+    }
+    return r;
+}
+
+size_t approxEstimatorBytes(const ApproxEstimator *e)
+{
+    return e ? sizeof(*e) + (size_t)e->numNodes * sizeof(ApproxNode) +
+               (size_t)e->numSamples * sizeof(Rect) : 0;
+}
+
+void freeApproxEstimator(ApproxEstimator *e)
+{
+    if (!e) return;
+    free(e->nodes);
+    free(e->samples);
+    free(e);
+}
+
+// Compare approximate counts against exact[] for a query set: time per query,
+// mean per-query relative error, total absolute error over total hits,
+// interval coverage, and the cost of an accuracy target.
+void approxBenchmark(const ApproxEstimator *e, Node *root, const Rect *queries, int numQuery,
+                     const int *exact, double exactTime)
+{
+    static const double targets[] = {0.0, 0.10, 0.02};
+    if (numQuery <= 0) return;
+
+    printf("\n=== Approximate counts (single thread, estimator %.2f MB) ===\n",
+           approxEstimatorBytes(e) / (1024.0 * 1024.0));
+    printf("%8s %12s %10s %10s %10s %10s %10s\n", "target", "us/query", "speedup", "mean err",
+           "total err", "covered", "fallback");
+    for (int t = 0; t < 3; t++) {
+        double errSum = 0, absSum = 0, exactSum = 0;
+        int covered = 0, fallbacks = 0;
+        double t0 = nowSeconds();
+        for (int i = 0; i < numQuery; i++) {
+            ApproxCount a = approxCount(e, root, queries[i], targets[t]);
+            double ex = exact[i];
+            errSum += fabs(a.estimate - ex) / (ex > 1 ? ex : 1);
+            absSum += fabs(a.estimate - ex);
+            exactSum += ex;
+            if (ex >= a.low - 0.5 && ex <= a.high + 0.5) covered++;
+            fallbacks += a.exact;
+        }
+        double dt = nowSeconds() - t0;
+        char label[16];
+        if (targets[t] > 0) snprintf(label, sizeof(label), "%.0f%%", targets[t] * 100);
+        else snprintf(label, sizeof(label), "none");
+        printf("%8s %12.2f %9.2fx %9.2f%% %9.2f%% %9.1f%% %9.1f%%\n", label, dt * 1e6 / numQuery,
+               exactTime / dt, 100.0 * errSum / numQuery, 100.0 * absSum / (exactSum > 1 ? exactSum : 1),
+               100.0 * covered / numQuery,
+               100.0 * fallbacks / numQuery);
+    }
+}
@@ -0,0 +1,458 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rtree.h"
+
+// ---------------- Pointer-free linearized tree ----------------
+//
+// A FlatTree is an immutable copy of a built Node tree: every node lives in one
+// contiguous FlatNode array and every leaf rectangle in one contiguous Rect
+// array. Children of a node are always stored next to each other, so a node
+// only needs a 32-bit index of its first child (or first rect) and a count.
+// The whole thing has no pointers inside, which means it can be written to a
+// file, mmap'ed back at any address and shared read-only between processes.
+//
+// Two node orders are supported:
+//   FLAT_BFS  level by level, the root group first
+//   FLAT_VEB  van Emde Boas order over sibling groups: the top half of the
+//             tree is laid out recursively, followed by each bottom subtree,
+//             so a root-to-leaf path touches few distinct pages at any scale.
+
+#define FLAT_MAGIC "STRFLAT1"
+#define FLAT_STACK 2048
+
+typedef struct {
+    char magic[8];
+    uint32_t numNodes;
+    uint32_t numRects;
+    uint32_t order;
+    uint32_t height;
+} FlatHeader;
+
+// Breadth-first enumeration of the pointer tree. Children of the node with
+// BFS id i occupy ids [first[i], first[i] + nodes[i]->count).
+typedef struct {
+    Node **nodes;
+    uint32_t *first;
+    uint32_t *depth;
+    uint32_t n;
+    uint32_t height;
+} BfsIndex;
+
+static int bfsEnumerate(Node *root, BfsIndex *b)
+{
+    uint32_t cap = 1024;
+    b->nodes = (Node **)malloc(cap * sizeof(Node *));
+    b->depth = (uint32_t *)malloc(cap * sizeof(uint32_t));
+    if (!b->nodes || !b->depth) return -1;
+
+    b->nodes[0] = root;
+    b->depth[0] = 0;
+    b->n = 1;
+    b->height = 1;
+    for (uint32_t i = 0; i < b->n; i++) {
+        Node *nd = b->nodes[i];
+        if (nd->isLeaf) continue;
+        if (b->n + (uint32_t)nd->count > cap) {
+            while (b->n + (uint32_t)nd->count > cap) cap *= 2;
+            Node **nn = (Node **)realloc(b->nodes, cap * sizeof(Node *));
+            uint32_t *nd2 = (uint32_t *)realloc(b->depth, cap * sizeof(uint32_t));
+            if (!nn || !nd2) return -1;
+            b->nodes = nn;
+            b->depth = nd2;
+        }
+        for (int c = 0; c < nd->count; c++) {
+            b->nodes[b->n] = nd->children[c];
+            b->depth[b->n] = b->depth[i] + 1;
+            if (b->depth[b->n] + 1 > b->height) b->height = b->depth[b->n] + 1;
+            b->n++;
+        }
+    }
+
+    b->first = (uint32_t *)malloc((size_t)b->n * sizeof(uint32_t));
+    if (!b->first) return -1;
+    uint32_t next = 1;
+    for (uint32_t i = 0; i < b->n; i++) {
+        b->first[i] = next;
+        if (!b->nodes[i]->isLeaf) next += (uint32_t)b->nodes[i]->count;
+    }
+    return 0;
+}
+
+// vEB layout over sibling groups. A group is identified by the BFS id of its
+// first member and its size; `h` is the number of group levels to emit.
+static void vebEmit(const BfsIndex *b, uint32_t gFirst, uint32_t gCount, uint32_t h,
+                    uint32_t *newPos, uint32_t *next)
+{
+    if (h == 0) return;
+    if (h == 1) {
+        for (uint32_t k = 0; k < gCount; k++) newPos[gFirst + k] = (*next)++;
+        return;
+    }
+
+    uint32_t hTop = h / 2;
+    uint32_t hBot = h - hTop;
+    vebEmit(b, gFirst, gCount, hTop, newPos, next);
+
+    // Bottom subtrees hang off the groups hTop levels below this one. Walk
+    // down level by level to find them in left-to-right order.
+    uint32_t *cur = (uint32_t *)malloc(2 * sizeof(uint32_t));
+    if (!cur) {
+        perror("Unable to allocate vEB groups");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t curN = 1;
+    cur[0] = gFirst;
+    cur[1] = gCount;
+    for (uint32_t lvl = 0; lvl < hTop; lvl++) {
+        uint32_t nextN = 0;
+        for (uint32_t g = 0; g < curN; g++)
+            for (uint32_t k = 0; k < cur[2 * g + 1]; k++)
+                if (!b->nodes[cur[2 * g] + k]->isLeaf) nextN++;
+        uint32_t *nxt = (uint32_t *)malloc((2 * (size_t)nextN + 2) * sizeof(uint32_t));
+        if (!nxt) {
+            perror("Unable to allocate vEB groups");
+            exit(EXIT_FAILURE);
+        }
+        uint32_t j = 0;
+        for (uint32_t g = 0; g < curN; g++) {
+            for (uint32_t k = 0; k < cur[2 * g + 1]; k++) {
+                uint32_t id = cur[2 * g] + k;
+                if (b->nodes[id]->isLeaf) continue;
+                nxt[2 * j] = b->first[id];
+                nxt[2 * j + 1] = (uint32_t)b->nodes[id]->count;
+                j++;
+            }
+        }
+        free(cur);
+        cur = nxt;
+        curN = nextN;
+    }
+    for (uint32_t g = 0; g < curN; g++)
+        vebEmit(b, cur[2 * g], cur[2 * g + 1], hBot, newPos, next);
+    free(cur);
+}
+
+FlatTree *createFlatTree(Node *root, int order)
+{
+    if (!root) return NULL;
+
+    BfsIndex b = {0};
+    if (bfsEnumerate(root, &b) != 0) {
+        perror("Unable to enumerate tree for linearization");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t *newPos = (uint32_t *)malloc((size_t)b.n * sizeof(uint32_t));
+    if (!newPos) {
+        perror("Unable to allocate layout permutation");
+        exit(EXIT_FAILURE);
+    }
+    if (order == FLAT_VEB) {
+        uint32_t next = 0;
+        vebEmit(&b, 0, 1, b.height, newPos, &next);
+    } else {
+        for (uint32_t i = 0; i < b.n; i++) newPos[i] = i;
+    }
+
+    FlatTree *t = (FlatTree *)calloc(1, sizeof(FlatTree));
+    if (!t) {
+        perror("Unable to allocate flat tree");
+        exit(EXIT_FAILURE);
+    }
+    t->numNodes = b.n;
+    t->order = order;
+    t->height = b.height;
+    t->nodes = (FlatNode *)malloc((size_t)b.n * sizeof(FlatNode));
+
+    size_t numRects = 0;
+    for (uint32_t i = 0; i < b.n; i++)
+        if (b.nodes[i]->isLeaf) numRects += (size_t)b.nodes[i]->count;
+    if (numRects > UINT32_MAX) {
+        fprintf(stderr, "Tree too large for 32-bit rect offsets\n");
+        exit(EXIT_FAILURE);
+    }
+    t->numRects = (uint32_t)numRects;
+    t->rects = (Rect *)malloc(numRects * sizeof(Rect) + 1);
+    if (!t->nodes || !t->rects) {
+        perror("Unable to allocate flat tree");
+        exit(EXIT_FAILURE);
+    }
+
+    // Place nodes at their final positions; leaf rects are packed in final
+    // node order so leaves that sit next to each other also scan contiguously.
+    uint32_t *inv = (uint32_t *)malloc((size_t)b.n * sizeof(uint32_t));
+    if (!inv) {
+        perror("Unable to allocate layout permutation");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < b.n; i++) inv[newPos[i]] = i;
+
+    uint32_t rectOff = 0;
+    for (uint32_t p = 0; p < b.n; p++) {
+        uint32_t id = inv[p];
+        Node *nd = b.nodes[id];
+        FlatNode *f = &t->nodes[p];
+        f->mbr = nd->mbr;
+        f->count = (uint16_t)nd->count;
+        f->isLeaf = (uint16_t)(nd->isLeaf ? 1 : 0);
+        if (nd->isLeaf) {
+            f->first = rectOff;
+            memcpy(&t->rects[rectOff], nd->rects, (size_t)nd->count * sizeof(Rect));
+            rectOff += (uint32_t)nd->count;
+        } else {
+            f->first = newPos[b.first[id]];
+        }
+    }
+
+    free(inv);
+    free(newPos);
+    free(b.nodes);
+    free(b.first);
+    free(b.depth);
+    return t;
+}
+
+// Count hits below node `idx` without testing idx's own MBR (the caller did).
+int searchFlatTree_from(const FlatTree *t, uint32_t idx, Rect q)
+{
+    const FlatNode *n = &t->nodes[idx];
+    int count = 0;
+    if (n->isLeaf) {
+        const Rect *r = &t->rects[n->first];
+        for (uint32_t i = 0; i < n->count; i++)
+            if (isOverlap_inline((const MBR *)&r[i], q)) count++;
+        return count;
+    }
+    for (uint32_t c = n->first; c < n->first + n->count; c++)
+        if (isOverlap_inline(&t->nodes[c].mbr, q))
+            count += searchFlatTree_from(t, c, q);
+    return count;
+}
+
+// searchRTree on the linearized layout. Child MBRs are tested from the
+// contiguous sibling run of the parent, and leaf children are scanned on the
+// spot instead of being pushed.
+int searchFlatTree(const FlatTree *t, Rect queryRect)
+{
+    if (!t || t->numNodes == 0) return 0;
+    if (!isOverlap_inline(&t->nodes[0].mbr, queryRect)) return 0;
+
+    uint32_t stack[FLAT_STACK];
+    int top = 0;
+    int count = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const FlatNode *n = &t->nodes[stack[--top]];
+        if (n->isLeaf) {
+            const Rect *r = &t->rects[n->first];
+            for (uint32_t i = 0; i < n->count; i++)
+                if (isOverlap_inline((const MBR *)&r[i], queryRect)) count++;
+            continue;
+        }
+        uint32_t end = n->first + n->count;
+        for (uint32_t c = n->first; c < end; c++) {
+            const FlatNode *ch = &t->nodes[c];
+            if (!isOverlap_inline(&ch->mbr, queryRect)) continue;
+            if (ch->isLeaf) {
+                const Rect *r = &t->rects[ch->first];
+                for (uint32_t i = 0; i < ch->count; i++)
+                    if (isOverlap_inline((const MBR *)&r[i], queryRect)) count++;
+            } else if (top < FLAT_STACK) {
+                stack[top++] = c;
+            } else {
+                count += searchFlatTree_from(t, c, queryRect);
+            }
+        }
+    }
+    return count;
+}
+
+static void collectFrom(const FlatTree *t, uint32_t idx, Rect q, uint32_t *out, int maxOut, int *count)
+{
+    const FlatNode *n = &t->nodes[idx];
+    if (n->isLeaf) {
+        const Rect *r = &t->rects[n->first];
+        for (uint32_t i = 0; i < n->count; i++) {
+            if (!isOverlap_inline((const MBR *)&r[i], q)) continue;
+            if (*count < maxOut) out[*count] = n->first + i;
+            (*count)++;
+        }
+        return;
+    }
+    for (uint32_t c = n->first; c < n->first + n->count; c++)
+        if (isOverlap_inline(&t->nodes[c].mbr, q))
+            collectFrom(t, c, q, out, maxOut, count);
+}
+
+// Positions in t->rects of the rects overlapping q. At most maxOut are
+// stored; the return value is the full number of hits.
+int searchFlatTree_collect(const FlatTree *t, Rect q, uint32_t *out, int maxOut)
+{
+    int count = 0;
+    if (t && t->numNodes > 0 && isOverlap_inline(&t->nodes[0].mbr, q))
+        collectFrom(t, 0, q, out, maxOut, &count);
+    return count;
+}
+
+typedef struct {
+    Rect r;
+    uint32_t id;
+} RectId;
+
+static int cmpRectId(const void *a, const void *b)
+{
+    int c = compareRectLex(&((const RectId *)a)->r, &((const RectId *)b)->r);
+    if (c) return c;
+    uint32_t x = ((const RectId *)a)->id, y = ((const RectId *)b)->id;
+    return (x > y) - (x < y);
+}
+
+// ids[i] = position in orig[0..n) of t->rects[i]. Equal rects get distinct
+// positions in increasing order.
+uint32_t *flatTreeRectIds(const FlatTree *t, const Rect *orig, int n)
+{
+    RectId *byValue = (RectId *)malloc((size_t)n * sizeof(RectId));
+    uint32_t *ids = (uint32_t *)malloc((size_t)(t->numRects > 0 ? t->numRects : 1) * sizeof(uint32_t));
+    if (!byValue || !ids) {
+        perror("Unable to allocate rect ids");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) byValue[i] = (RectId){orig[i], (uint32_t)i};
+    qsort(byValue, (size_t)n, sizeof(RectId), cmpRectId);
+    // used[k] marks entries of byValue already handed out
+    unsigned char *used = (unsigned char *)calloc((size_t)(n > 0 ? n : 1), 1);
+    if (!used) {
+        perror("Unable to allocate rect ids");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < t->numRects; i++) {
+        int lo = 0, hi = n;                 // first entry >= rects[i]
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (compareRectLex(&byValue[mid].r, &t->rects[i]) < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        while (lo < n && used[lo] && compareRectLex(&byValue[lo].r, &t->rects[i]) == 0) lo++;
+        if (lo < n && compareRectLex(&byValue[lo].r, &t->rects[i]) == 0) {
+            used[lo] = 1;
+            ids[i] = byValue[lo].id;
+        } else {
+            ids[i] = UINT32_MAX;            // not in orig
+        }
+    }
+    free(used);
+    free(byValue);
+    return ids;
+}
+
+size_t flatTreeBytes(const FlatTree *t)
+{
+    if (!t) return 0;
+    return sizeof(FlatTree) + (size_t)t->numNodes * sizeof(FlatNode) +
+           (size_t)t->numRects * sizeof(Rect);
+}
+
+// Payload bytes of the pointer tree: Node structs, children arrays and leaf
+// rect arrays (allocator headers not included).
+size_t rtreeBytes(const Node *node)
+{
+    if (!node) return 0;
+    size_t bytes = sizeof(Node);
+    if (node->isLeaf)
+        return bytes + leafBytes(node);
+    bytes += (size_t)node->count * sizeof(Node *);
+    for (int i = 0; i < node->count; i++)
+        bytes += rtreeBytes(node->children[i]);
+    return bytes;
+}
+
+int saveFlatTree(const FlatTree *t, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("Unable to open flat tree file for writing");
+        return -1;
+    }
+    FlatHeader h;
+    memcpy(h.magic, FLAT_MAGIC, sizeof(h.magic));
+    h.numNodes = t->numNodes;
+    h.numRects = t->numRects;
+    h.order = (uint32_t)t->order;
+    h.height = t->height;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(t->nodes, sizeof(FlatNode), t->numNodes, f) == t->numNodes &&
+             fwrite(t->rects, sizeof(Rect), t->numRects, f) == t->numRects;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) {
+        perror("Unable to write flat tree file");
+        return -1;
+    }
+    return 0;
+}
+
+// Map a file written by saveFlatTree read-only. The arrays point straight into
+// the mapping, so several processes loading the same file share its pages.
+FlatTree *loadFlatTree(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Unable to open flat tree file");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FlatHeader)) {
+        fprintf(stderr, "Flat tree file %s is truncated\n", path);
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Unable to map flat tree file");
+        return NULL;
+    }
+
+    const FlatHeader *h = (const FlatHeader *)map;
+    size_t need = sizeof(FlatHeader) + (size_t)h->numNodes * sizeof(FlatNode) +
+                  (size_t)h->numRects * sizeof(Rect);
+    if (memcmp(h->magic, FLAT_MAGIC, sizeof(h->magic)) != 0 || need > (size_t)st.st_size) {
+        fprintf(stderr, "%s is not a valid flat tree file\n", path);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    FlatTree *t = (FlatTree *)calloc(1, sizeof(FlatTree));
+    if (!t) {
+        perror("Unable to allocate flat tree");
+        exit(EXIT_FAILURE);
+    }
+    t->numNodes = h->numNodes;
+    t->numRects = h->numRects;
+    t->order = (int)h->order;
+    t->height = h->height;
+    t->nodes = (FlatNode *)((char *)map + sizeof(FlatHeader));
+    t->rects = (Rect *)((char *)t->nodes + (size_t)h->numNodes * sizeof(FlatNode));
+    t->mapping = map;
+    t->mappingSize = (size_t)st.st_size;
+    return t;
+}
+
+void freeFlatTree(FlatTree *t)
+{
+    if (!t) return;
+    if (t->mapping) {
+        munmap(t->mapping, t->mappingSize);
+    } else {
+        free(t->nodes);
+        free(t->rects);
+    }
+    free(t);
+}
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "rtree.h"
+
+// ---------------- Uniform grid engine ----------------
+//
+// The data MBR is cut into G x G cells with G chosen for about
+// GRID_PER_CELL rects per cell. A rect is stored in every cell it overlaps,
+// in one CSR array (cellStart, then rects and ids per cell). A query visits
+// the cells under its window and counts a rect in a cell only if the
+// reference point (max(r.xmin, q.xmin), max(r.ymin, q.ymin)) of the pair
+// lies in that cell. That point is inside both the rect and the window, so
+// every hit is counted in exactly one cell without a duplicate filter.
+//
+// Cell i spans [bx[i], bx[i + 1]) with bx[i] = xmin + ceil(i * span / G),
+// which is exactly the set of x with floor((x - xmin) * G / span) = i.
+
+#define GRID_PER_CELL 8
+#define GRID_MAX_SIDE 4096
+
+typedef struct {
+    MBR bounds;
+    int side;                     // G
+    long long spanX, spanY;
+    int *bx, *by;                 // side + 1 cell boundaries
+    uint32_t *cellStart;          // side * side + 1 offsets
+    Rect *rects;
+    uint32_t *ids;
+    size_t numRefs;
+    int numRects;
+} Grid;
+
+static inline int cellOf(int v, int lo, long long span, int side)
+{
+    long long c = ((long long)v - lo) * side / span;
+    return c < 0 ? 0 : c >= side ? side - 1 : (int)c;
+}
+
+static void *gridBuild(const Rect *rects, int n)
+{
+    Grid *g = (Grid *)calloc(1, sizeof(Grid));
+    if (!g) {
+        perror("Unable to allocate grid");
+        exit(EXIT_FAILURE);
+    }
+    g->numRects = n;
+    MBR b = {0, 0, 0, 0};
+    for (int i = 0; i < n; i++) {
+        if (i == 0) {
+            b = rects[0];
+            continue;
+        }
+        if (rects[i].xmin < b.xmin) b.xmin = rects[i].xmin;
+        if (rects[i].ymin < b.ymin) b.ymin = rects[i].ymin;
+        if (rects[i].xmax > b.xmax) b.xmax = rects[i].xmax;
+        if (rects[i].ymax > b.ymax) b.ymax = rects[i].ymax;
+    }
+    g->bounds = b;
+    g->spanX = (long long)b.xmax - b.xmin + 1;
+    g->spanY = (long long)b.ymax - b.ymin + 1;
+    int side = 1;
+    while (side < GRID_MAX_SIDE && (long long)side * side * GRID_PER_CELL < n) side++;
+    g->side = side;
+
+    g->bx = (int *)malloc((size_t)(side + 1) * sizeof(int));
+    g->by = (int *)malloc((size_t)(side + 1) * sizeof(int));
+    g->cellStart = (uint32_t *)calloc((size_t)side * side + 1, sizeof(uint32_t));
+    if (!g->bx || !g->by || !g->cellStart) {
+        perror("Unable to allocate grid cells");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i <= side; i++) {
+        g->bx[i] = (int)(b.xmin + (g->spanX * i + side - 1) / side);
+        g->by[i] = (int)(b.ymin + (g->spanY * i + side - 1) / side);
+    }
+
+    // Count references per cell, prefix-sum, then fill
+    for (int i = 0; i < n; i++) {
+        int x0 = cellOf(rects[i].xmin, b.xmin, g->spanX, side), x1 = cellOf(rects[i].xmax, b.xmin, g->spanX, side);
+        int y0 = cellOf(rects[i].ymin, b.ymin, g->spanY, side), y1 = cellOf(rects[i].ymax, b.ymin, g->spanY, side);
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++) g->cellStart[(size_t)y * side + x + 1]++;
+    }
+    for (size_t c = 0; c < (size_t)side * side; c++) g->cellStart[c + 1] += g->cellStart[c];
+    g->numRefs = g->cellStart[(size_t)side * side];
+    g->rects = (Rect *)malloc((g->numRefs ? g->numRefs : 1) * sizeof(Rect));
+    g->ids = (uint32_t *)malloc((g->numRefs ? g->numRefs : 1) * sizeof(uint32_t));
+    uint32_t *fill = (uint32_t *)malloc((size_t)side * side * sizeof(uint32_t));
+    if (!g->rects || !g->ids || !fill) {
+        perror("Unable to allocate grid entries");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(fill, g->cellStart, (size_t)side * side * sizeof(uint32_t));
+    for (int i = 0; i < n; i++) {
+        int x0 = cellOf(rects[i].xmin, b.xmin, g->spanX, side), x1 = cellOf(rects[i].xmax, b.xmin, g->spanX, side);
+        int y0 = cellOf(rects[i].ymin, b.ymin, g->spanY, side), y1 = cellOf(rects[i].ymax, b.ymin, g->spanY, side);
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++) {
+                uint32_t slot = fill[(size_t)y * side + x]++;
+                g->rects[slot] = rects[i];
+                g->ids[slot] = (uint32_t)i;
+            }
+    }
+    free(fill);
+    return g;
+}
+
+// Visit the cells under q; out is NULL when only counting
+static int gridVisit(const Grid *g, Rect q, uint32_t *out, int maxOut)
+{
+    if (g->numRects == 0 || !isOverlap_inline(&g->bounds, q)) return 0;
+    int side = g->side;
+    int x0 = cellOf(q.xmin, g->bounds.xmin, g->spanX, side), x1 = cellOf(q.xmax, g->bounds.xmin, g->spanX, side);
+    int y0 = cellOf(q.ymin, g->bounds.ymin, g->spanY, side), y1 = cellOf(q.ymax, g->bounds.ymin, g->spanY, side);
+    int count = 0;
+    for (int y = y0; y <= y1; y++) {
+        int yLo = g->by[y];
+        for (int x = x0; x <= x1; x++) {
+            int xLo = g->bx[x];
+            size_t c = (size_t)y * side + x;
+            for (uint32_t k = g->cellStart[c]; k < g->cellStart[c + 1]; k++) {
+                Rect r = g->rects[k];
+                if (!isOverlap_inline(&r, q)) continue;
+                int rx = r.xmin > q.xmin ? r.xmin : q.xmin;
+                int ry = r.ymin > q.ymin ? r.ymin : q.ymin;
+                // Count the pair only in the cell holding its reference point
+                if (rx < xLo || ry < yLo) continue;
+                if (out && count < maxOut) out[count] = g->ids[k];
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+static int gridCount(const void *index, Rect q)
+{
+    return gridVisit((const Grid *)index, q, NULL, 0);
+}
+
+static int gridReport(const void *index, Rect q, uint32_t *ids, int maxOut)
+{
+    return gridVisit((const Grid *)index, q, ids, maxOut);
+}
+
+static size_t gridBytes(const void *index)
+{
+    const Grid *g = (const Grid *)index;
+    return sizeof(Grid) + 2 * (size_t)(g->side + 1) * sizeof(int) +
+           ((size_t)g->side * g->side + 1) * sizeof(uint32_t) + g->numRefs * (sizeof(Rect) + sizeof(uint32_t));
+}
+
+static void gridDescribe(const void *index, char *buf, size_t len)
+{
+    const Grid *g = (const Grid *)index;
+    snprintf(buf, len, "%dx%d cells, %.2f refs per rect", g->side, g->side,
+             g->numRects ? (double)g->numRefs / g->numRects : 0.0);
+}
+
+static void gridDestroy(void *index)
+{
+    Grid *g = (Grid *)index;
+    free(g->bx);
+    free(g->by);
+    free(g->cellStart);
+    free(g->rects);
+    free(g->ids);
+    free(g);
+}
+
+const SpatialIndexOps gridIndexOps = {
+    "grid", gridBuild, gridCount, gridReport, gridBytes, gridDescribe, gridDestroy};
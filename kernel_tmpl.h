@@ -0,0 +1,271 @@
+// ---------------- Specialized kernel template ----------------
+//
+// Included by kernels.c once per instance, with:
+//
+//   KT_SUFFIX     name suffix of the generated types and functions
+//   KT_NAME       coordinate type name, for the ops name
+//   KT_COORD      coordinate type
+//   KT_INTEGRAL   1 for integer coordinates, 0 for floating point
+//   KT_LO, KT_HI  integer types: range of mapped real coordinates
+//   KT_PAD_LO/HI  values no mapped coordinate reaches (empty slots)
+//   KT_EXACT_SPAN floating point types: largest span stored exactly
+//   KT_LEAF       rects per leaf
+//   KT_FANOUT     children per internal node
+//
+// Leaves and internal nodes hold their boxes as four coordinate arrays of
+// exactly KT_LEAF / KT_FANOUT entries, padded with boxes that never
+// overlap, so every loop below has a compile-time trip count and the leaf
+// count is branch free. Coordinates are stored relative to the data
+// minimum; integer types shift them right until the span fits. The mapping
+// is monotone and queries go through the same one, so the counts are never
+// short, and they are exact when the tree reports `exact`.
+//
+// Internal node j of a level covers nodes j * KT_FANOUT .. + KT_FANOUT - 1
+// of the next level (the leaves below the last one); nothing else links
+// the levels.
+
+#ifndef KT_JOIN
+#define KT_JOIN2(a, b) a##_##b
+#define KT_JOIN(a, b) KT_JOIN2(a, b)
+#define KT(name) KT_JOIN(name, KT_SUFFIX)
+#define KT_STR2(x) #x
+#define KT_STR(x) KT_STR2(x)
+#endif
+
+typedef struct {
+    KT_COORD xmin[KT_FANOUT], ymin[KT_FANOUT], xmax[KT_FANOUT], ymax[KT_FANOUT];
+} KT(Inner);
+
+typedef struct {
+    KT_COORD xmin[KT_LEAF], ymin[KT_LEAF], xmax[KT_LEAF], ymax[KT_LEAF];
+} KT(Leaf);
+
+typedef struct {
+    KT_COORD xmin, ymin, xmax, ymax;
+} KT(Box);
+
+typedef struct {
+    KT(Inner) *inner;             // all internal levels, root level first
+    int levelStart[33];           // first internal node of each level
+    int height;                   // internal levels
+    KT(Leaf) *leaves;
+    uint32_t *ids;                // KT_LEAF per leaf, UINT32_MAX on padding
+    int numLeaves, numInner, numRects;
+    long long ox, oy;             // data minimum
+    int shift;
+    int exact;
+} KT(Tree);
+
+static inline KT_COORD KT(conv)(const KT(Tree) *t, long long v, long long o)
+{
+#if KT_INTEGRAL
+    long long m = ((v - o) >> t->shift) + (KT_LO + 1);
+    return (KT_COORD)(m < KT_LO ? KT_LO : m > KT_HI ? KT_HI : m);
+#else
+    (void)t;
+    return (KT_COORD)(v - o);
+#endif
+}
+
+static inline KT(Box) KT(mapRect)(const KT(Tree) *t, Rect r)
+{
+    KT(Box) b = {KT(conv)(t, r.xmin, t->ox), KT(conv)(t, r.ymin, t->oy), KT(conv)(t, r.xmax, t->ox),
+                 KT(conv)(t, r.ymax, t->oy)};
+    return b;
+}
+
+static void *KT(build)(const Rect *rects, int n)
+{
+    KT(Tree) *t = (KT(Tree) *)calloc(1, sizeof(KT(Tree)));
+    if (!t) {
+        perror("Unable to allocate kernel tree");
+        exit(EXIT_FAILURE);
+    }
+    t->numRects = n;
+    MBR b = kernelBounds(rects, n);
+    t->ox = b.xmin;
+    t->oy = b.ymin;
+    long long span = (long long)b.xmax - b.xmin > (long long)b.ymax - b.ymin ? (long long)b.xmax - b.xmin
+                                                                             : (long long)b.ymax - b.ymin;
+#if KT_INTEGRAL
+    while ((span >> t->shift) > (long long)KT_HI - 1 - (KT_LO + 1)) t->shift++;
+    t->exact = t->shift == 0;
+#else
+    t->exact = span <= (long long)KT_EXACT_SPAN;
+#endif
+
+    // Leaves from the STR order
+    int *leafStart;
+    KernelItem *items = kernelStrOrder(rects, n, KT_LEAF, &t->numLeaves, &leafStart);
+    t->leaves = (KT(Leaf) *)malloc((size_t)(t->numLeaves ? t->numLeaves : 1) * sizeof(KT(Leaf)));
+    t->ids = (uint32_t *)malloc((size_t)(t->numLeaves ? t->numLeaves : 1) * KT_LEAF * sizeof(uint32_t));
+    if (!t->leaves || !t->ids) {
+        perror("Unable to allocate kernel leaves");
+        exit(EXIT_FAILURE);
+    }
+    for (int l = 0; l < t->numLeaves; l++) {
+        KT(Leaf) *leaf = &t->leaves[l];
+        for (int i = 0; i < KT_LEAF; i++) {
+            int k = leafStart[l] + i;
+            uint32_t *id = &t->ids[(size_t)l * KT_LEAF + i];
+            if (k < leafStart[l + 1]) {
+                KT(Box) m = KT(mapRect)(t, items[k].r);
+                leaf->xmin[i] = m.xmin;
+                leaf->ymin[i] = m.ymin;
+                leaf->xmax[i] = m.xmax;
+                leaf->ymax[i] = m.ymax;
+                *id = items[k].id;
+            } else {
+                leaf->xmin[i] = leaf->ymin[i] = KT_PAD_HI;
+                leaf->xmax[i] = leaf->ymax[i] = KT_PAD_LO;
+                *id = UINT32_MAX;
+            }
+        }
+    }
+    free(items);
+    free(leafStart);
+
+    // Boxes of the level below (leaves first), grouped KT_FANOUT at a time
+    int below = t->numLeaves, height = 0, total = 0;
+    int sizes[33];
+    while (below > 1 && height < 32) {
+        below = (below + KT_FANOUT - 1) / KT_FANOUT;
+        sizes[height++] = below;
+        total += below;
+    }
+    t->height = height;
+    t->numInner = total;
+    t->inner = (KT(Inner) *)malloc((size_t)(total ? total : 1) * sizeof(KT(Inner)));
+    KT(Box) *boxes = (KT(Box) *)malloc((size_t)(t->numLeaves ? t->numLeaves : 1) * sizeof(KT(Box)));
+    if (!t->inner || !boxes) {
+        perror("Unable to allocate kernel nodes");
+        exit(EXIT_FAILURE);
+    }
+    for (int l = 0; l < t->numLeaves; l++) {
+        KT(Box) m = {KT_PAD_HI, KT_PAD_HI, KT_PAD_LO, KT_PAD_LO};
+        for (int i = 0; i < KT_LEAF; i++) {
+            if (t->ids[(size_t)l * KT_LEAF + i] == UINT32_MAX) continue;
+            if (t->leaves[l].xmin[i] < m.xmin) m.xmin = t->leaves[l].xmin[i];
+            if (t->leaves[l].ymin[i] < m.ymin) m.ymin = t->leaves[l].ymin[i];
+            if (t->leaves[l].xmax[i] > m.xmax) m.xmax = t->leaves[l].xmax[i];
+            if (t->leaves[l].ymax[i] > m.ymax) m.ymax = t->leaves[l].ymax[i];
+        }
+        boxes[l] = m;
+    }
+    // Levels are built bottom up but stored root first
+    int start = total;
+    below = t->numLeaves;
+    for (int h = 0; h < height; h++) {
+        int count = sizes[h];
+        start -= count;
+        t->levelStart[height - 1 - h] = start;
+        for (int j = 0; j < count; j++) {
+            KT(Inner) *node = &t->inner[start + j];
+            KT(Box) m = {KT_PAD_HI, KT_PAD_HI, KT_PAD_LO, KT_PAD_LO};
+            for (int i = 0; i < KT_FANOUT; i++) {
+                int c = j * KT_FANOUT + i;
+                KT(Box) cb = c < below ? boxes[c] : (KT(Box)){KT_PAD_HI, KT_PAD_HI, KT_PAD_LO, KT_PAD_LO};
+                node->xmin[i] = cb.xmin;
+                node->ymin[i] = cb.ymin;
+                node->xmax[i] = cb.xmax;
+                node->ymax[i] = cb.ymax;
+                if (c >= below) continue;
+                if (cb.xmin < m.xmin) m.xmin = cb.xmin;
+                if (cb.ymin < m.ymin) m.ymin = cb.ymin;
+                if (cb.xmax > m.xmax) m.xmax = cb.xmax;
+                if (cb.ymax > m.ymax) m.ymax = cb.ymax;
+            }
+            boxes[j] = m;               // j <= c for every child read above
+        }
+        below = count;
+    }
+    t->levelStart[height] = total;
+    free(boxes);
+    return t;
+}
+
+static inline int KT(leafCount)(const KT(Leaf) *l, KT(Box) q)
+{
+    int c = 0;
+    for (int i = 0; i < KT_LEAF; i++)
+        c += (l->xmin[i] <= q.xmax) & (l->xmax[i] >= q.xmin) & (l->ymin[i] <= q.ymax) & (l->ymax[i] >= q.ymin);
+    return c;
+}
+
+// Visit node j of internal level `level`; out is NULL when only counting
+static int KT(visit)(const KT(Tree) *t, int level, int j, KT(Box) q, uint32_t *out, int maxOut, int count)
+{
+    if (level == t->height) {
+        const KT(Leaf) *l = &t->leaves[j];
+        if (!out) return count + KT(leafCount)(l, q);
+        for (int i = 0; i < KT_LEAF; i++) {
+            if (!((l->xmin[i] <= q.xmax) & (l->xmax[i] >= q.xmin) & (l->ymin[i] <= q.ymax) &
+                  (l->ymax[i] >= q.ymin)))
+                continue;
+            if (count < maxOut) out[count] = t->ids[(size_t)j * KT_LEAF + i];
+            count++;
+        }
+        return count;
+    }
+    const KT(Inner) *node = &t->inner[t->levelStart[level] + j];
+    for (int i = 0; i < KT_FANOUT; i++)
+        if ((node->xmin[i] <= q.xmax) & (node->xmax[i] >= q.xmin) & (node->ymin[i] <= q.ymax) &
+            (node->ymax[i] >= q.ymin))
+            count = KT(visit)(t, level + 1, j * KT_FANOUT + i, q, out, maxOut, count);
+    return count;
+}
+
+static int KT(count)(const void *index, Rect q)
+{
+    const KT(Tree) *t = (const KT(Tree) *)index;
+    return t->numLeaves ? KT(visit)(t, 0, 0, KT(mapRect)(t, q), NULL, 0, 0) : 0;
+}
+
+static int KT(report)(const void *index, Rect q, uint32_t *ids, int maxOut)
+{
+    const KT(Tree) *t = (const KT(Tree) *)index;
+    return t->numLeaves ? KT(visit)(t, 0, 0, KT(mapRect)(t, q), ids, maxOut, 0) : 0;
+}
+
+static size_t KT(bytes)(const void *index)
+{
+    const KT(Tree) *t = (const KT(Tree) *)index;
+    return sizeof(KT(Tree)) + (size_t)t->numInner * sizeof(KT(Inner)) +
+           (size_t)t->numLeaves * (sizeof(KT(Leaf)) + KT_LEAF * sizeof(uint32_t));
+}
+
+static void KT(describe)(const void *index, char *buf, size_t len)
+{
+    const KT(Tree) *t = (const KT(Tree) *)index;
+    snprintf(buf, len, "%d leaves, height %d, %s", t->numLeaves, t->height + 1,
+             t->exact ? "exact" : "superset (coordinates shifted)");
+}
+
+static int KT(exact)(const void *index)
+{
+    return ((const KT(Tree) *)index)->exact;
+}
+
+static void KT(destroy)(void *index)
+{
+    KT(Tree) *t = (KT(Tree) *)index;
+    free(t->inner);
+    free(t->leaves);
+    free(t->ids);
+    free(t);
+}
+
+const SpatialIndexOps KT(kernelOps) = {KT_NAME " " KT_STR(KT_LEAF) "x" KT_STR(KT_FANOUT),
+                                       KT(build), KT(count), KT(report), KT(bytes), KT(describe), KT(destroy)};
+
+#undef KT_SUFFIX
+#undef KT_NAME
+#undef KT_COORD
+#undef KT_INTEGRAL
+#undef KT_LO
+#undef KT_HI
+#undef KT_PAD_LO
+#undef KT_PAD_HI
+#undef KT_EXACT_SPAN
+#undef KT_LEAF
+#undef KT_FANOUT
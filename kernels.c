@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Specialized search kernels ----------------
+//
+// kernel_tmpl.h generates a packed, STR-loaded tree for one coordinate type
+// and one leaf / fanout capacity, exposed as a SpatialIndexOps table. This
+// file instantiates it for int16, int32, float and double at the build-time
+// capacities KERNEL_LEAF x KERNEL_FANOUT, plus int32 at a few other
+// capacities for comparison. selectKernelOps picks an instance when an
+// index is opened: int16 if the data span fits it exactly, int32 otherwise.
+// The pointer tree and the rest of the program keep their int Rect.
+
+typedef struct {
+    Rect r;
+    uint32_t id;
+} KernelItem;
+
+static MBR kernelBounds(const Rect *rects, int n)
+{
+    MBR b = {0, 0, 0, 0};
+    if (n > 0) b = rects[0];
+    for (int i = 1; i < n; i++) b = unionJoin(&b, (MBR *)&rects[i]);
+    return b;
+}
+
+static int compareItemX(const void *A, const void *B)
+{
+    const Rect *a = &((const KernelItem *)A)->r, *b = &((const KernelItem *)B)->r;
+    long long ca = (long long)a->xmin + a->xmax, cb = (long long)b->xmin + b->xmax;
+    return (ca > cb) - (ca < cb);
+}
+
+static int compareItemY(const void *A, const void *B)
+{
+    const Rect *a = &((const KernelItem *)A)->r, *b = &((const KernelItem *)B)->r;
+    long long ca = (long long)a->ymin + a->ymax, cb = (long long)b->ymin + b->ymax;
+    return (ca > cb) - (ca < cb);
+}
+
+// STR tiling into leaves of `cap`: items in leaf order, leaf l holding
+// items (*leafStart)[l] .. (*leafStart)[l + 1] - 1.
+static KernelItem *kernelStrOrder(const Rect *rects, int n, int cap, int *numLeaves, int **leafStart)
+{
+    KernelItem *items = (KernelItem *)malloc((size_t)(n > 0 ? n : 1) * sizeof(KernelItem));
+    int leaves = (n + cap - 1) / cap;
+    int slices = (int)ceil(sqrt((double)leaves));
+    int *start = (int *)malloc((size_t)(leaves + slices + 1) * sizeof(int));
+    if (!items || !start) {
+        perror("Unable to allocate kernel STR order");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) items[i] = (KernelItem){rects[i], (uint32_t)i};
+    qsort(items, (size_t)n, sizeof(KernelItem), compareItemX);
+    long long perSlice = (long long)slices * cap;
+    int l = 0;
+    for (long long s = 0; s < n; s += perSlice) {
+        int len = (int)(s + perSlice < n ? perSlice : n - s);
+        qsort(items + s, (size_t)len, sizeof(KernelItem), compareItemY);
+        for (int k = 0; k < len; k += cap) start[l++] = (int)s + k;
+    }
+    start[l] = n;
+    *numLeaves = l;
+    *leafStart = start;
+    return items;
+}
+
+#define KT_SUFFIX i16
+#define KT_NAME "int16"
+#define KT_COORD int16_t
+#define KT_INTEGRAL 1
+#define KT_LO (-32767LL)
+#define KT_HI 32766LL
+#define KT_PAD_LO INT16_MIN
+#define KT_PAD_HI INT16_MAX
+#define KT_LEAF KERNEL_LEAF
+#define KT_FANOUT KERNEL_FANOUT
+#include "kernel_tmpl.h"
+
+#define KT_SUFFIX i32
+#define KT_NAME "int32"
+#define KT_COORD int32_t
+#define KT_INTEGRAL 1
+#define KT_LO ((long long)INT32_MIN + 1)
+#define KT_HI ((long long)INT32_MAX - 1)
+#define KT_PAD_LO INT32_MIN
+#define KT_PAD_HI INT32_MAX
+#define KT_LEAF KERNEL_LEAF
+#define KT_FANOUT KERNEL_FANOUT
+#include "kernel_tmpl.h"
+
+#define KT_SUFFIX f32
+#define KT_NAME "float"
+#define KT_COORD float
+#define KT_INTEGRAL 0
+#define KT_PAD_LO (-FLT_MAX)
+#define KT_PAD_HI FLT_MAX
+#define KT_EXACT_SPAN (1LL << 24)
+#define KT_LEAF KERNEL_LEAF
+#define KT_FANOUT KERNEL_FANOUT
+#include "kernel_tmpl.h"
+
+#define KT_SUFFIX f64
+#define KT_NAME "double"
+#define KT_COORD double
+#define KT_INTEGRAL 0
+#define KT_PAD_LO (-DBL_MAX)
+#define KT_PAD_HI DBL_MAX
+#define KT_EXACT_SPAN (1LL << 53)
+#define KT_LEAF KERNEL_LEAF
+#define KT_FANOUT KERNEL_FANOUT
+#include "kernel_tmpl.h"
+
+#define KT_SUFFIX i32_16x16
+#define KT_NAME "int32"
+#define KT_COORD int32_t
+#define KT_INTEGRAL 1
+#define KT_LO ((long long)INT32_MIN + 1)
+#define KT_HI ((long long)INT32_MAX - 1)
+#define KT_PAD_LO INT32_MIN
+#define KT_PAD_HI INT32_MAX
+#define KT_LEAF 16
+#define KT_FANOUT 16
+#include "kernel_tmpl.h"
+
+#define KT_SUFFIX i32_256x32
+#define KT_NAME "int32"
+#define KT_COORD int32_t
+#define KT_INTEGRAL 1
+#define KT_LO ((long long)INT32_MIN + 1)
+#define KT_HI ((long long)INT32_MAX - 1)
+#define KT_PAD_LO INT32_MIN
+#define KT_PAD_HI INT32_MAX
+#define KT_LEAF 256
+#define KT_FANOUT 32
+#include "kernel_tmpl.h"
+
+#define KT_SUFFIX i32_1024x128
+#define KT_NAME "int32"
+#define KT_COORD int32_t
+#define KT_INTEGRAL 1
+#define KT_LO ((long long)INT32_MIN + 1)
+#define KT_HI ((long long)INT32_MAX - 1)
+#define KT_PAD_LO INT32_MIN
+#define KT_PAD_HI INT32_MAX
+#define KT_LEAF 1024
+#define KT_FANOUT 128
+#include "kernel_tmpl.h"
+
+const SpatialIndexOps *const kernelInstances[] = {
+    &kernelOps_i16, &kernelOps_i32, &kernelOps_f32, &kernelOps_f64,
+    &kernelOps_i32_16x16, &kernelOps_i32_256x32, &kernelOps_i32_1024x128};
+const int numKernelInstances = (int)(sizeof(kernelInstances) / sizeof(kernelInstances[0]));
+static int (*const kernelExact[])(const void *) = {exact_i16, exact_i32, exact_f32, exact_f64,
+                                                   exact_i32_16x16, exact_i32_256x32, exact_i32_1024x128};
+
+// Narrowest instance at the build-time capacities that stores the data
+// exactly.
+const SpatialIndexOps *selectKernelOps(const Rect *rects, int n)
+{
+    MBR b = kernelBounds(rects, n);
+    long long span = (long long)b.xmax - b.xmin > (long long)b.ymax - b.ymin ? (long long)b.xmax - b.xmin
+                                                                             : (long long)b.ymax - b.ymin;
+    return span <= 32766LL - 1 - (-32767LL + 1) ? &kernelOps_i16 : &kernelOps_i32;
+}
+
+// ---- benchmark ----
+
+// Build every instance on the same rects and run the queries single
+// threaded. Exact instances must give the sequential total; the others
+// (coordinates shifted to fit) at least that many.
+void kernelBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, long long expected,
+                     double seqTime)
+{
+    int ok = 1;
+    const SpatialIndexOps *chosen = selectKernelOps(rects, numRects);
+    printf("\n[Kernels] build-time capacity %dx%d, opened as %s, single thread\n", KERNEL_LEAF, KERNEL_FANOUT,
+           chosen->name);
+    printf("%-14s %9s %9s %10s %9s %14s  %s\n", "instance", "build (s)", "MB", "query (s)", "vs seq", "overlaps",
+           "structure");
+    for (int k = 0; k < numKernelInstances; k++) {
+        const SpatialIndexOps *ops = kernelInstances[k];
+        double t0 = nowSeconds();
+        SpatialIndex *idx = buildSpatialIndex(ops, rects, numRects);
+        double buildTime = nowSeconds() - t0;
+
+        t0 = nowSeconds();
+        long long hits = 0;
+        for (int i = 0; i < numQuery; i++) hits += spatialIndexSearch(idx, queries[i]);
+        double queryTime = nowSeconds() - t0;
+
+        char desc[96];
+        ops->describe(idx->impl, desc, sizeof(desc));
+        int exact = kernelExact[k](idx->impl);
+        int good = exact ? hits == expected : hits >= expected;
+        ok &= good;
+        printf("%-14s %9.3f %9.2f %10.4f %8.2fx %14lld  %s", ops->name, buildTime,
+               spatialIndexBytes(idx) / (1024.0 * 1024.0), queryTime, queryTime > 0 ? seqTime / queryTime : 0.0,
+               hits, desc);
+        if (!exact) printf(", +%.2f%%", expected ? 100.0 * (hits - expected) / expected : 0.0);
+        printf("%s\n", good ? "" : "  MISMATCH");
+        freeSpatialIndex(idx);
+    }
+    printf("%s Kernel results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+}
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Sorted leaves with mini-pages ----------------
+//
+// The bulk loaders hand every leaf to sortLeaf, which orders its rects by
+// ymin and appends one MBR per LEAF_PAGE consecutive rects (a mini-page)
+// to the same allocation, after the `count` rects. Such a leaf is marked
+// with isLeaf == LEAF_SORTED; code that only tests isLeaf for truth keeps
+// seeing an ordinary leaf array.
+//
+// searchLeaf skips mini-pages whose MBR misses the window and stops at the
+// first page, or rect, whose ymin lies above the window: everything after
+// it starts higher still. Leaves built elsewhere (COW copies, LSM runs)
+// keep isLeaf == 1 and are scanned in full as before.
+
+static int compareByYmin(const void *a, const void *b)
+{
+    const Rect *r1 = (const Rect *)a;
+    const Rect *r2 = (const Rect *)b;
+    return (r1->ymin > r2->ymin) - (r1->ymin < r2->ymin);
+}
+
+static inline int leafPageCount(int count)
+{
+    return (count + LEAF_PAGE - 1) / LEAF_PAGE;
+}
+
+// Bytes to allocate for the rects of a leaf of `count` rects that will be
+// passed to sortLeaf.
+size_t leafAllocBytes(int count)
+{
+    return (size_t)count * sizeof(Rect) + (size_t)leafPageCount(count) * sizeof(MBR);
+}
+
+// Bytes of a leaf's rect array, including the mini-pages of a sorted leaf.
+size_t leafBytes(const Node *leaf)
+{
+    if (leaf->isLeaf == LEAF_SORTED) return leafAllocBytes(leaf->count);
+    return (size_t)leaf->count * sizeof(Rect);
+}
+
+// Sort the rects of a leaf allocated with leafAllocBytes and build its
+// mini-pages.
+void sortLeaf(Node *leaf)
+{
+    qsort(leaf->rects, (size_t)leaf->count, sizeof(Rect), compareByYmin);
+    MBR *pages = (MBR *)(leaf->rects + leaf->count);
+    for (int p = 0; p < leafPageCount(leaf->count); p++) {
+        int end = (p + 1) * LEAF_PAGE < leaf->count ? (p + 1) * LEAF_PAGE : leaf->count;
+        initMBR(&pages[p]);
+        for (int i = p * LEAF_PAGE; i < end; i++) updateMBRWithRect(&pages[p], leaf->rects[i]);
+    }
+    leaf->isLeaf = LEAF_SORTED;
+}
+
+// Count the rects of one leaf that overlap q.
+int searchLeaf(const Node *leaf, Rect q)
+{
+    int count = 0;
+    if (leaf->isLeaf != LEAF_SORTED) {
+        for (int i = 0; i < leaf->count; i++)
+            if (isOverlap_inline((const MBR *)&leaf->rects[i], q)) count++;
+        return count;
+    }
+    const MBR *pages = (const MBR *)(leaf->rects + leaf->count);
+    for (int p = 0; p < leafPageCount(leaf->count); p++) {
+        if (pages[p].ymin > q.ymax) break;
+        if (!isOverlap_inline(&pages[p], q)) continue;
+        int end = (p + 1) * LEAF_PAGE < leaf->count ? (p + 1) * LEAF_PAGE : leaf->count;
+        for (int i = p * LEAF_PAGE; i < end; i++) {
+            const Rect *r = &leaf->rects[i];
+            if (r->ymin > q.ymax) return count;
+            if (isOverlap_inline((const MBR *)r, q)) count++;
+        }
+    }
+    return count;
+}
+
+// ---- benchmark ----
+
+typedef struct {
+    long long leaves;     // leaves reached
+    long long stored;     // rects stored in them
+    long long tested;     // rects compared against the window
+} LeafScanStats;
+
+// Same walk as searchLeaf, counting the rects it compares
+static void countLeafWork(const Node *n, Rect q, LeafScanStats *st)
+{
+    if (!isOverlap_inline(&n->mbr, q)) return;
+    if (!n->isLeaf) {
+        for (int i = 0; i < n->count; i++) countLeafWork(n->children[i], q, st);
+        return;
+    }
+    st->leaves++;
+    st->stored += n->count;
+    if (n->isLeaf != LEAF_SORTED) {
+        st->tested += n->count;
+        return;
+    }
+    const MBR *pages = (const MBR *)(n->rects + n->count);
+    for (int p = 0; p < leafPageCount(n->count); p++) {
+        if (pages[p].ymin > q.ymax) break;
+        if (!isOverlap_inline(&pages[p], q)) continue;
+        int end = (p + 1) * LEAF_PAGE < n->count ? (p + 1) * LEAF_PAGE : n->count;
+        for (int i = p * LEAF_PAGE; i < end; i++) {
+            st->tested++;
+            if (n->rects[i].ymin > q.ymax) return;
+        }
+    }
+}
+
+// Drop the sorted flag so every leaf is scanned in full
+static void unsortLeaves(Node *n)
+{
+    if (n->isLeaf) {
+        n->isLeaf = 1;
+        return;
+    }
+    for (int i = 0; i < n->count; i++) unsortLeaves(n->children[i]);
+}
+
+// Run the queries single threaded on `root` and on a copy whose leaves are
+// scanned in full, and report the share of leaf rects each one compares.
+void leafScanBenchmark(Node *root, const Rect *queries, int numQuery, long long expected)
+{
+    Node *plain = cloneRTree(root);
+    unsortLeaves(plain);
+    Node *trees[2] = {plain, root};
+    const char *names[2] = {"full scan", "sorted + pages"};
+    double times[2] = {0, 0};
+    int ok = 1;
+
+    printf("\n[Leaf scan] %d rects per mini-page, single thread\n", LEAF_PAGE);
+    printf("%-15s %10s %14s %13s %12s\n", "leaves", "time (s)", "overlaps", "rects/query", "of reached");
+    for (int k = 0; k < 2; k++) {
+        LeafScanStats st = {0, 0, 0};
+        for (int i = 0; i < numQuery; i++) countLeafWork(trees[k], queries[i], &st);
+        double t0 = nowSeconds();
+        long long hits = 0;
+        for (int i = 0; i < numQuery; i++) hits += searchRTree(trees[k], queries[i], i);
+        times[k] = nowSeconds() - t0;
+        ok &= hits == expected;
+        printf("%-15s %10.3f %14lld %13.1f %11.1f%%\n", names[k], times[k], hits,
+               numQuery ? (double)st.tested / numQuery : 0.0, st.stored ? 100.0 * st.tested / st.stored : 0.0);
+    }
+    printf("Sorted leaves: %.2fx vs full leaf scan\n", times[1] > 0 ? times[0] / times[1] : 0.0);
+    printf("%s Leaf scan results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+    freeRTree(plain);
+}
@@ -0,0 +1,505 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Buffered ingestion with background STR merge ----------------
+//
+// An LsmTree is a packed STR tree plus small write buffers, in the spirit of
+// an LSM tree with two levels:
+//
+//   main     STR tree published through an RTreeHandle (lock-free readers)
+//   frozen   buffer being merged by the background thread (read-only)
+//   active   buffer receiving new inserts
+//
+// Inserts append to the active run. Deletes of a rect still in the active run
+// remove it there; otherwise they add a tombstone that cancels one equal rect
+// of main or frozen. A query counts the tree and both runs with the SIMD scan
+// and subtracts the overlapping tombstones.
+//
+// The merge thread wakes when the active run reaches LSM_BUFFER_RECTS or every
+// LSM_MERGE_INTERVAL_MS. It freezes the active run, rebuilds the whole tree
+// from the old tree's rects plus the frozen run minus the frozen tombstones
+// with createRTree_STR_2, and swaps the new tree in together with dropping the
+// frozen run. Queries keep running on the old tree during the rebuild.
+//
+// The buffers sit behind a rwlock; readers only hold it while scanning them,
+// never during the tree search.
+
+#define LSM_BUFFER_RECTS 16384
+#define LSM_MERGE_INTERVAL_MS 250
+
+typedef struct {
+    Rect *rects;
+    int count, cap;
+} RectRun;
+
+struct LsmTree {
+    RTreeHandle *main;
+    pthread_rwlock_t lock;         // guards the runs below
+    RectRun active, activeTombs;
+    RectRun frozen, frozenTombs;
+
+    pthread_t merger;
+    pthread_mutex_t mergeLock;
+    pthread_cond_t mergeCond;
+    int stop;
+    long long flushSeq;            // last flush request handed out
+    long long flushDone;           // highest request merged into main
+    _Atomic int merging;           // a rebuild is in progress
+
+    int merges;
+    double mergeSeconds, maxMergeSeconds;
+};
+
+static void runPush(RectRun *run, Rect r)
+{
+    if (run->count == run->cap) {
+        run->cap = run->cap ? run->cap * 2 : 1024;
+        run->rects = (Rect *)realloc(run->rects, (size_t)run->cap * sizeof(Rect));
+        if (!run->rects) {
+            perror("Unable to grow write buffer");
+            exit(EXIT_FAILURE);
+        }
+    }
+    run->rects[run->count++] = r;
+}
+
+static inline int sameRect(Rect a, Rect b)
+{
+    return a.xmin == b.xmin && a.ymin == b.ymin && a.xmax == b.xmax && a.ymax == b.ymax;
+}
+
+static int runCountEqual(const RectRun *run, Rect r)
+{
+    int n = 0;
+    for (int i = 0; i < run->count; i++) n += sameRect(run->rects[i], r);
+    return n;
+}
+
+static int countEqualInTree(const Node *n, Rect r)
+{
+    if (!n || n->mbr.xmin > r.xmin || n->mbr.ymin > r.ymin ||
+        n->mbr.xmax < r.xmax || n->mbr.ymax < r.ymax)
+        return 0;
+    int c = 0;
+    if (n->isLeaf) {
+        for (int i = 0; i < n->count; i++) c += sameRect(n->rects[i], r);
+    } else {
+        for (int i = 0; i < n->count; i++) c += countEqualInTree(n->children[i], r);
+    }
+    return c;
+}
+
+static long long treeRectCount(const Node *n)
+{
+    if (!n) return 0;
+    if (n->isLeaf) return n->count;
+    long long c = 0;
+    for (int i = 0; i < n->count; i++) c += treeRectCount(n->children[i]);
+    return c;
+}
+
+static void collectTreeRects(const Node *n, Rect *out, long long *k)
+{
+    if (!n) return;
+    if (n->isLeaf) {
+        memcpy(out + *k, n->rects, (size_t)n->count * sizeof(Rect));
+        *k += n->count;
+        return;
+    }
+    for (int i = 0; i < n->count; i++) collectTreeRects(n->children[i], out, k);
+}
+
+// Rebuild main from its rects + frozen - frozenTombs. Only the merge thread
+// replaces the main tree, so its root is stable here.
+static void lsmMerge(LsmTree *t)
+{
+    pthread_rwlock_wrlock(&t->lock);
+    if (t->active.count == 0 && t->activeTombs.count == 0) {
+        pthread_rwlock_unlock(&t->lock);
+        return;
+    }
+    t->frozen = t->active;
+    t->frozenTombs = t->activeTombs;
+    memset(&t->active, 0, sizeof(RectRun));
+    memset(&t->activeTombs, 0, sizeof(RectRun));
+    atomic_store(&t->merging, 1);
+    pthread_rwlock_unlock(&t->lock);
+
+    double t0 = nowSeconds();
+    Node *old = snapshotRoot(t->main);
+    long long n = treeRectCount(old) + t->frozen.count, k = 0;
+    Rect *all = (Rect *)malloc((size_t)(n > 0 ? n : 1) * sizeof(Rect));
+    if (!all) {
+        perror("Unable to allocate merge buffer");
+        exit(EXIT_FAILURE);
+    }
+    collectTreeRects(old, all, &k);
+    memcpy(all + k, t->frozen.rects, (size_t)t->frozen.count * sizeof(Rect));
+
+    if (t->frozenTombs.count > 0) {
+        // Cancel one equal rect per tombstone. Readers still scan the frozen
+        // run, so the tombstones are sorted in a copy.
+        int nt = t->frozenTombs.count;
+        Rect *tombs = (Rect *)malloc((size_t)nt * sizeof(Rect));
+        if (!tombs) {
+            perror("Unable to allocate tombstone copy");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(tombs, t->frozenTombs.rects, (size_t)nt * sizeof(Rect));
+        n = subtractRects(all, (int)n, tombs, nt, NULL);
+        free(tombs);
+    }
+    Node *fresh = n > 0 ? createRTree_STR_2(all, 0, (int)n - 1) : NULL;
+    free(all);
+
+    // Swap the tree and drop the frozen runs in one step for readers
+    pthread_rwlock_wrlock(&t->lock);
+    snapshotReplaceRoot(t->main, fresh);
+    free(t->frozen.rects);
+    free(t->frozenTombs.rects);
+    memset(&t->frozen, 0, sizeof(RectRun));
+    memset(&t->frozenTombs, 0, sizeof(RectRun));
+    atomic_store(&t->merging, 0);
+    pthread_rwlock_unlock(&t->lock);
+
+    double dt = nowSeconds() - t0;
+    t->merges++;
+    t->mergeSeconds += dt;
+    if (dt > t->maxMergeSeconds) t->maxMergeSeconds = dt;
+}
+
+static void *lsm_merge_thread(void *arg)
+{
+    LsmTree *t = (LsmTree *)arg;
+    pthread_mutex_lock(&t->mergeLock);
+    while (!t->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)LSM_MERGE_INTERVAL_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        if (t->flushDone == t->flushSeq)
+            pthread_cond_timedwait(&t->mergeCond, &t->mergeLock, &deadline);
+        if (t->stop) break;
+        // Requests up to `picked` were made before this merge froze the
+        // buffers, so it covers them; later ones wait for the next round.
+        long long picked = t->flushSeq;
+        pthread_mutex_unlock(&t->mergeLock);
+
+        lsmMerge(t);
+
+        pthread_mutex_lock(&t->mergeLock);
+        if (picked > t->flushDone) {
+            t->flushDone = picked;
+            pthread_cond_broadcast(&t->mergeCond);
+        }
+    }
+    pthread_mutex_unlock(&t->mergeLock);
+    return NULL;
+}
+
+// Takes ownership of `root` (may be NULL) and starts the merge thread.
+LsmTree *createLsmTree(Node *root)
+{
+    LsmTree *t = (LsmTree *)calloc(1, sizeof(LsmTree));
+    if (!t) {
+        perror("Unable to allocate LSM tree");
+        exit(EXIT_FAILURE);
+    }
+    t->main = createRTreeHandle(root);
+    pthread_rwlock_init(&t->lock, NULL);
+    pthread_mutex_init(&t->mergeLock, NULL);
+    pthread_cond_init(&t->mergeCond, NULL);
+    atomic_init(&t->merging, 0);
+    pthread_create(&t->merger, NULL, lsm_merge_thread, t);
+    return t;
+}
+
+static void wakeMerger(LsmTree *t)
+{
+    pthread_mutex_lock(&t->mergeLock);
+    pthread_cond_broadcast(&t->mergeCond);
+    pthread_mutex_unlock(&t->mergeLock);
+}
+
+void lsmInsertBatch(LsmTree *t, const Rect *rects, int n)
+{
+    pthread_rwlock_wrlock(&t->lock);
+    for (int i = 0; i < n; i++) runPush(&t->active, rects[i]);
+    int full = t->active.count >= LSM_BUFFER_RECTS;
+    pthread_rwlock_unlock(&t->lock);
+    if (full) wakeMerger(t);
+}
+
+// Delete one rect equal to `r`. Returns 1 if such a rect was present.
+int lsmDelete(LsmTree *t, Rect r)
+{
+    int found = 0;
+    pthread_rwlock_wrlock(&t->lock);
+    for (int i = 0; i < t->active.count; i++) {
+        if (sameRect(t->active.rects[i], r)) {
+            t->active.rects[i] = t->active.rects[--t->active.count];
+            found = 1;
+            break;
+        }
+    }
+    if (!found) {
+        // Main and frozen hold it more often than it is already tombstoned
+        int live = countEqualInTree(snapshotRoot(t->main), r) + runCountEqual(&t->frozen, r) -
+                   runCountEqual(&t->frozenTombs, r) - runCountEqual(&t->activeTombs, r);
+        if (live > 0) {
+            runPush(&t->activeTombs, r);
+            found = 1;
+        }
+    }
+    int full = t->activeTombs.count >= LSM_BUFFER_RECTS;
+    pthread_rwlock_unlock(&t->lock);
+    if (full) wakeMerger(t);
+    return found;
+}
+
+int lsmRegisterReader(LsmTree *t)
+{
+    return snapshotRegisterReader(t->main);
+}
+
+void lsmUnregisterReader(LsmTree *t, int slot)
+{
+    snapshotUnregisterReader(t->main, slot);
+}
+
+int lsmQuery(LsmTree *t, int slot, Rect q)
+{
+    pthread_rwlock_rdlock(&t->lock);
+    Node *root = snapshotAcquire(t->main, slot);
+    int count = scanCount(t->active.rects, t->active.count, q) +
+                scanCount(t->frozen.rects, t->frozen.count, q) -
+                scanCount(t->activeTombs.rects, t->activeTombs.count, q) -
+                scanCount(t->frozenTombs.rects, t->frozenTombs.count, q);
+    pthread_rwlock_unlock(&t->lock);
+    count += searchRTree(root, q, 0);
+    snapshotRelease(t->main, slot);
+    return count;
+}
+
+// Merge everything buffered so far and wait until it is in the main tree.
+void lsmFlush(LsmTree *t)
+{
+    pthread_mutex_lock(&t->mergeLock);
+    long long target = ++t->flushSeq;
+    pthread_cond_broadcast(&t->mergeCond);
+    while (t->flushDone < target)
+        pthread_cond_wait(&t->mergeCond, &t->mergeLock);
+    pthread_mutex_unlock(&t->mergeLock);
+}
+
+// Stop the merge thread and free everything. No readers may be active.
+void destroyLsmTree(LsmTree *t)
+{
+    if (!t) return;
+    pthread_mutex_lock(&t->mergeLock);
+    t->stop = 1;
+    pthread_cond_broadcast(&t->mergeCond);
+    pthread_mutex_unlock(&t->mergeLock);
+    pthread_join(t->merger, NULL);
+
+    destroyRTreeHandle(t->main);
+    free(t->active.rects);
+    free(t->activeTombs.rects);
+    free(t->frozen.rects);
+    free(t->frozenTombs.rects);
+    pthread_rwlock_destroy(&t->lock);
+    pthread_mutex_destroy(&t->mergeLock);
+    pthread_cond_destroy(&t->mergeCond);
+    free(t);
+}
+
+// ---- benchmark: ingest a feed while queries run ----
+
+#define LSM_FEED_BATCH 1000
+#define LSM_MAX_SAMPLES (1 << 20)
+#define LSM_SLOT_CHECK_READERS 1024   // short-lived readers, 4 at a time
+
+typedef struct {
+    LsmTree *t;
+    const Rect *queries;
+    int numQuery;
+    int start;
+    _Atomic int *stop;
+    float *lat[2];          // microseconds, [0] outside merges, [1] during
+    int numLat[2];
+} LsmReader;
+
+typedef struct {
+    LsmTree *t;
+    const Rect *feed;       // rects to ingest
+    int numFeed;
+    const Rect *victims;    // rects of the initial tree, deleted and re-inserted
+    int numVictims;
+    double seconds;
+} LsmWriter;
+
+static void *lsm_reader(void *arg)
+{
+    LsmReader *r = (LsmReader *)arg;
+    int slot = lsmRegisterReader(r->t);
+    int i = r->start;
+    volatile long long sink = 0;
+    while (!atomic_load(r->stop)) {
+        int during = atomic_load(&r->t->merging);
+        double t0 = nowSeconds();
+        sink += lsmQuery(r->t, slot, r->queries[i]);
+        float us = (float)((nowSeconds() - t0) * 1e6);
+        during |= atomic_load(&r->t->merging);
+        if (r->numLat[during] < LSM_MAX_SAMPLES) r->lat[during][r->numLat[during]++] = us;
+        if (++i == r->numQuery) i = 0;
+    }
+    lsmUnregisterReader(r->t, slot);
+    (void)sink;
+    return NULL;
+}
+
+static void *lsm_writer(void *arg)
+{
+    LsmWriter *w = (LsmWriter *)arg;
+    double t0 = nowSeconds();
+    int v = 0;
+    for (int b = 0; b < w->numFeed; b += LSM_FEED_BATCH) {
+        int len = w->numFeed - b < LSM_FEED_BATCH ? w->numFeed - b : LSM_FEED_BATCH;
+        lsmInsertBatch(w->t, w->feed + b, len);
+        // Churn: delete a few old rects (tombstones) and insert them back
+        if (w->numVictims > 0) {
+            Rect back[8];
+            for (int k = 0; k < 8; k++, v++) {
+                back[k] = w->victims[v % w->numVictims];
+                lsmDelete(w->t, back[k]);
+            }
+            lsmInsertBatch(w->t, back, 8);
+        }
+    }
+    w->seconds = nowSeconds() - t0;
+    return NULL;
+}
+
+static int cmpFloat(const void *A, const void *B)
+{
+    float a = *(const float *)A, b = *(const float *)B;
+    return (a > b) - (a < b);
+}
+
+static void printLatency(const char *label, float *lat, int n)
+{
+    if (n == 0) {
+        printf("%-22s: no queries\n", label);
+        return;
+    }
+    qsort(lat, (size_t)n, sizeof(float), cmpFloat);
+    printf("%-22s: %8d queries, p50 %8.1f us, p99 %8.1f us, max %8.1f us\n", label, n,
+           lat[n / 2], lat[(long long)n * 99 / 100], lat[n - 1]);
+}
+
+// Start from a tree over 90% of the rects, ingest the rest in batches with
+// delete/re-insert churn while readers query, then flush and check the
+// totals match the sequential run.
+void lsmBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                  int numThreads, long long expected)
+{
+    if (numRects < 10 || numQuery <= 0) return;
+    int initial = numRects - numRects / 10;
+    Rect *copy = (Rect *)malloc((size_t)numRects * sizeof(Rect));
+    if (!copy) {
+        perror("Unable to allocate LSM input");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, rects, (size_t)numRects * sizeof(Rect));
+    Rect *base = (Rect *)malloc((size_t)initial * sizeof(Rect));
+    memcpy(base, copy, (size_t)initial * sizeof(Rect));
+    LsmTree *t = createLsmTree(createRTree_STR_2(base, 0, initial - 1));
+    free(base);
+
+    pthread_t threads[numThreads + 1];
+    LsmReader *readers = (LsmReader *)calloc((size_t)numThreads, sizeof(LsmReader));
+    _Atomic int stop;
+    atomic_init(&stop, 0);
+    for (int i = 0; i < numThreads; i++) {
+        readers[i] = (LsmReader){
+            .t = t, .queries = queries, .numQuery = numQuery,
+            .start = (int)((long long)i * numQuery / numThreads), .stop = &stop};
+        readers[i].lat[0] = (float *)malloc(LSM_MAX_SAMPLES * sizeof(float));
+        readers[i].lat[1] = (float *)malloc(LSM_MAX_SAMPLES * sizeof(float));
+        if (!readers[i].lat[0] || !readers[i].lat[1]) {
+            perror("Unable to allocate latency samples");
+            exit(EXIT_FAILURE);
+        }
+        pthread_create(&threads[i], NULL, lsm_reader, &readers[i]);
+    }
+
+    LsmWriter w = {.t = t, .feed = copy + initial, .numFeed = numRects - initial,
+                   .victims = copy, .numVictims = initial < 4096 ? initial : 4096};
+    pthread_create(&threads[numThreads], NULL, lsm_writer, &w);
+    pthread_join(threads[numThreads], NULL);
+    lsmFlush(t);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < numThreads; i++) pthread_join(threads[i], NULL);
+
+    printf("\n=== Buffered ingestion (LSM write buffer + background STR merge) ===\n");
+    printf("Initial tree          : %d rects, ingested %d in batches of %d (+ churn)\n",
+           initial, numRects - initial, LSM_FEED_BATCH);
+    printf("Ingest throughput     : %.0f rects/s\n", (numRects - initial) / w.seconds);
+    printf("Merges                : %d, mean %.1f ms, max %.1f ms\n", t->merges,
+           t->merges ? 1e3 * t->mergeSeconds / t->merges : 0.0, 1e3 * t->maxMergeSeconds);
+
+    float *all[2];
+    int total[2] = {0, 0};
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < numThreads; i++) total[s] += readers[i].numLat[s];
+        all[s] = (float *)malloc((size_t)(total[s] > 0 ? total[s] : 1) * sizeof(float));
+        int k = 0;
+        for (int i = 0; i < numThreads; i++) {
+            memcpy(all[s] + k, readers[i].lat[s], (size_t)readers[i].numLat[s] * sizeof(float));
+            k += readers[i].numLat[s];
+        }
+    }
+    printLatency("Query latency idle", all[0], total[0]);
+    printLatency("Query latency merging", all[1], total[1]);
+
+    int slot = lsmRegisterReader(t);
+    long long found = 0;
+    for (int i = 0; i < numQuery; i++) found += lsmQuery(t, slot, queries[i]);
+    lsmUnregisterReader(t, slot);
+    if (found == expected)
+        printf("✅ LSM tree after ingestion matches the sequential results.\n");
+    else
+        printf("❌ LSM tree after ingestion: %lld overlaps, expected %lld\n", found, expected);
+
+    // Far more readers over time than there are slots; with every earlier
+    // reader gone, the lowest slots must be reused
+    int maxSlot = -1;
+    for (int r = 0; r < LSM_SLOT_CHECK_READERS; r += 4) {
+        int held[4];
+        for (int k = 0; k < 4; k++) {
+            held[k] = lsmRegisterReader(t);
+            if (held[k] > maxSlot) maxSlot = held[k];
+        }
+        for (int k = 0; k < 4; k++) lsmUnregisterReader(t, held[k]);
+    }
+    if (maxSlot == 3)
+        printf("✅ %d short-lived readers reused reader slots 0-3.\n", LSM_SLOT_CHECK_READERS);
+    else
+        printf("❌ %d short-lived readers used slots up to %d, expected 3\n", LSM_SLOT_CHECK_READERS, maxSlot);
+
+    for (int s = 0; s < 2; s++) free(all[s]);
+    for (int i = 0; i < numThreads; i++) {
+        free(readers[i].lat[0]);
+        free(readers[i].lat[1]);
+    }
+    free(readers);
+    destroyLsmTree(t);
+    free(copy);
+}
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "rtree.h"
+
+// ---------------- Memory footprint accounting ----------------
+//
+// measureTreeFootprint walks a pointer tree and charges every allocation
+// to its level and component. The components are node headers, children
+// arrays, leaf rects and the mini-page MBRs of sorted leaves. For each one
+// it records the requested bytes and what malloc_usable_size reports, so
+// the allocator overhead is the rounding slack plus one size_t chunk
+// header per allocation (glibc). The tree copies every rect, so the
+// dataset array is counted again next to it.
+//
+// memoryPhase samples VmRSS and VmHWM from /proc/self/status at the end
+// of a phase of main. It then writes 5 to /proc/self/clear_refs so the next
+// VmHWM is the peak of the next phase. Where that is refused, VmHWM stays
+// cumulative and the table says so.
+
+#define MEM_MAX_PHASES 32
+
+static size_t usableBytes(const void *p, size_t requested)
+{
+    return p ? malloc_usable_size((void *)p) : requested;
+}
+
+static void chargeLevel(const Node *n, int level, TreeFootprint *f)
+{
+    if (!n) return;
+    if (level >= MEM_MAX_LEVELS) level = MEM_MAX_LEVELS - 1;
+    if (level + 1 > f->levels) f->levels = level + 1;
+    LevelFootprint *l = &f->level[level];
+    l->nodes++;
+    l->entries += n->count;
+    l->headerBytes += sizeof(Node);
+    l->usableBytes += usableBytes(n, sizeof(Node));
+    l->allocs++;
+    if (n->isLeaf) {
+        size_t rects = (size_t)n->count * sizeof(Rect);
+        l->rectBytes += rects;
+        l->pageBytes += leafBytes(n) - rects;
+        l->usableBytes += usableBytes(n->rects, leafBytes(n));
+        l->allocs++;
+        return;
+    }
+    l->childBytes += (size_t)n->count * sizeof(Node *);
+    l->usableBytes += usableBytes(n->children, (size_t)n->count * sizeof(Node *));
+    l->allocs++;
+    for (int i = 0; i < n->count; i++) chargeLevel(n->children[i], level + 1, f);
+}
+
+void measureTreeFootprint(const Node *root, TreeFootprint *f)
+{
+    memset(f, 0, sizeof(*f));
+    chargeLevel(root, 0, f);
+    for (int i = 0; i < f->levels; i++) {
+        const LevelFootprint *l = &f->level[i];
+        f->total.nodes += l->nodes;
+        f->total.entries += l->entries;
+        f->total.headerBytes += l->headerBytes;
+        f->total.childBytes += l->childBytes;
+        f->total.rectBytes += l->rectBytes;
+        f->total.pageBytes += l->pageBytes;
+        f->total.usableBytes += l->usableBytes;
+        f->total.allocs += l->allocs;
+    }
+}
+
+static size_t requestedBytes(const LevelFootprint *l)
+{
+    return l->headerBytes + l->childBytes + l->rectBytes + l->pageBytes;
+}
+
+// Heap bytes including allocator overhead
+size_t footprintHeapBytes(const LevelFootprint *l)
+{
+    return l->usableBytes + (size_t)l->allocs * sizeof(size_t);
+}
+
+static double mib(size_t b)
+{
+    return b / (1024.0 * 1024.0);
+}
+
+static double kib(size_t b)
+{
+    return b / 1024.0;
+}
+
+// Per level table, then the tree next to the other arrays main keeps
+// (the dataset it was built from, the queries and the Z-sort scratch).
+void printTreeFootprint(const TreeFootprint *f, int numRects, int numQuery)
+{
+    printf("\n[Memory] Pointer tree by level (KB)\n");
+    printf("%5s %8s %10s %9s %9s %9s %9s %10s %10s\n", "level", "nodes", "entries", "headers", "children", "rects",
+           "pages", "requested", "allocator");
+    for (int i = 0; i <= f->levels; i++) {
+        const LevelFootprint *l = i < f->levels ? &f->level[i] : &f->total;
+        char name[16] = "all";
+        if (i < f->levels) snprintf(name, sizeof(name), "%d", i);
+        printf("%5s %8lld %10lld %9.1f %9.1f %9.1f %9.1f %10.1f %10.1f\n", name, l->nodes, l->entries,
+               kib(l->headerBytes), kib(l->childBytes), kib(l->rectBytes), kib(l->pageBytes),
+               kib(requestedBytes(l)), kib(footprintHeapBytes(l)));
+    }
+    const LevelFootprint *t = &f->total;
+    size_t requested = requestedBytes(t), heap = footprintHeapBytes(t);
+    size_t data = (size_t)numRects * sizeof(Rect), queries = (size_t)numQuery * sizeof(Rect);
+    size_t zsort = (size_t)numQuery * (sizeof(ZRect) + sizeof(Rect));
+    printf("Allocator overhead: %.1f KB over %lld allocations (%.1f KB rounding, %.1f KB chunk headers), "
+           "%.1f%% of requested\n", kib(heap - requested), t->allocs, kib(t->usableBytes - requested),
+           kib((size_t)t->allocs * sizeof(size_t)), requested ? 100.0 * (heap - requested) / requested : 0.0);
+    printf("%-28s %10s\n", "component", "MB");
+    printf("%-28s %10.2f\n", "dataset array", mib(data));
+    printf("%-28s %10.2f\n", "tree: leaf rect copies", mib(t->rectBytes));
+    printf("%-28s %10.2f\n", "tree: mini-page MBRs", mib(t->pageBytes));
+    printf("%-28s %10.3f\n", "tree: node headers", mib(t->headerBytes));
+    printf("%-28s %10.3f\n", "tree: children arrays", mib(t->childBytes));
+    printf("%-28s %10.3f\n", "tree: allocator overhead", mib(heap - requested));
+    printf("%-28s %10.2f\n", "query array", mib(queries));
+    printf("%-28s %10.2f\n", "Z-sort scratch (transient)", mib(zsort));
+    printf("%-28s %10.2f  (%.2fx the dataset array)\n", "resident total", mib(data + heap + queries),
+           data ? (double)(data + heap + queries) / data : 0.0);
+}
+
+// VmRSS and VmHWM in kB; 0 when unavailable
+int readProcMemory(long *rssKb, long *hwmKb)
+{
+    *rssKb = *hwmKb = 0;
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) *rssKb = atol(line + 6);
+        if (strncmp(line, "VmHWM:", 6) == 0) *hwmKb = atol(line + 6);
+    }
+    fclose(f);
+    return 0;
+}
+
+static struct {
+    char name[32];
+    long rssKb, peakKb;
+} phases[MEM_MAX_PHASES];
+static int numPhases;
+static int peakResets = 1;
+
+// End a phase of main: record the resident set now and its peak since the
+// previous call, then reset the peak.
+void memoryPhase(const char *name)
+{
+    if (numPhases == MEM_MAX_PHASES) return;
+    long rss, hwm;
+    readProcMemory(&rss, &hwm);
+    snprintf(phases[numPhases].name, sizeof(phases[numPhases].name), "%s", name);
+    phases[numPhases].rssKb = rss;
+    phases[numPhases].peakKb = hwm;
+    numPhases++;
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (!f || fputs("5", f) < 0) peakResets = 0;
+    if (f && fclose(f) != 0) peakResets = 0;
+}
+
+void printMemoryPhases(void)
+{
+    printf("\n[Memory] Resident set per phase (MB)%s\n", peakResets ? "" : ", peak is cumulative (clear_refs refused)");
+    printf("%-24s %10s %10s\n", "phase", "end RSS", "peak RSS");
+    for (int i = 0; i < numPhases; i++)
+        printf("%-24s %10.1f %10.1f\n", phases[i].name, phases[i].rssKb / 1024.0, phases[i].peakKb / 1024.0);
+}
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "rtree.h"
+
+// ---------------- NUMA-aware replicas and thread placement ----------------
+//
+// The topology comes from /sys/devices/system/node (one node with every
+// online CPU when that is missing). Three placements of the tree are offered:
+//
+//   NUMA_SHARED      the tree as built, wherever its pages landed
+//   NUMA_REPLICATE   one cloneRTree copy per node, made by a thread pinned to
+//                    that node so first-touch puts every page on it
+//   NUMA_INTERLEAVE  one copy made under an interleave memory policy, pages
+//                    spread round-robin over all nodes
+//
+// Query workers are pinned round-robin to the nodes and, with replicas, read
+// the copy of their own node. Memory policy and page-node lookups use the raw
+// set_mempolicy / move_pages system calls, so there is no libnuma dependency;
+// where they are missing the placement degrades to plain first-touch.
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+#define NUMA_MAX_NODES 64
+#define NUMA_MAX_NODE_ID 1024     // sysfs node numbers scanned
+#define NUMA_MASK_BITS (8 * sizeof(unsigned long))
+#define NUMA_SAMPLE_PAGES 4096
+#define NUMA_MPOL_DEFAULT 0
+#define NUMA_MPOL_INTERLEAVE 3
+
+static int parseCpuList(const char *s, int *out, int max)
+{
+    int n = 0;
+    while (*s && *s != '\n') {
+        char *e;
+        long a = strtol(s, &e, 10), b = a;
+        if (e == s) break;
+        if (*e == '-') b = strtol(e + 1, &e, 10);
+        for (long c = a; c <= b && n < max; c++) out[n++] = (int)c;
+        s = *e == ',' ? e + 1 : e;
+    }
+    return n;
+}
+
+NumaTopology *readNumaTopology(void)
+{
+    NumaTopology *t = (NumaTopology *)calloc(1, sizeof(NumaTopology));
+    if (!t) {
+        perror("Unable to allocate NUMA topology");
+        exit(EXIT_FAILURE);
+    }
+    int maxCpus = (int)sysconf(_SC_NPROCESSORS_CONF);
+    if (maxCpus < 1) maxCpus = 1;
+    t->cpus = (int *)malloc((size_t)maxCpus * sizeof(int));
+    t->cpuStart = (int *)malloc((NUMA_MAX_NODES + 1) * sizeof(int));
+    t->nodeId = (int *)malloc(NUMA_MAX_NODES * sizeof(int));
+    if (!t->cpus || !t->cpuStart || !t->nodeId) {
+        perror("Unable to allocate NUMA topology");
+        exit(EXIT_FAILURE);
+    }
+
+    int total = 0;
+    for (int id = 0; id < NUMA_MAX_NODE_ID && t->numNodes < NUMA_MAX_NODES; id++) {
+        char path[128], buf[4096];
+        snprintf(path, sizeof(path), NUMA_SYSFS "/node%d/cpulist", id);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        int got = fgets(buf, sizeof(buf), f) != NULL;
+        fclose(f);
+        int n = got ? parseCpuList(buf, t->cpus + total, maxCpus - total) : 0;
+        if (n == 0) continue;                 // memory-only node
+        t->nodeId[t->numNodes] = id;
+        t->cpuStart[t->numNodes] = total;
+        t->numNodes++;
+        total += n;
+    }
+    if (t->numNodes == 0) {
+        int online = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < online && c < maxCpus; c++) t->cpus[total++] = c;
+        t->nodeId[0] = 0;
+        t->cpuStart[0] = 0;
+        t->numNodes = 1;
+    }
+    t->cpuStart[t->numNodes] = total;
+    return t;
+}
+
+void freeNumaTopology(NumaTopology *t)
+{
+    if (!t) return;
+    free(t->cpus);
+    free(t->cpuStart);
+    free(t->nodeId);
+    free(t);
+}
+
+// Restrict the calling thread to the CPUs of topology node `node`.
+int pinThreadToNode(const NumaTopology *t, int node)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = t->cpuStart[node]; i < t->cpuStart[node + 1]; i++) CPU_SET(t->cpus[i], &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void setInterleave(const NumaTopology *t, int on)
+{
+#ifdef SYS_set_mempolicy
+    // Node ids are sysfs numbers and can be sparse, so the mask spans them all
+    unsigned long mask[NUMA_MAX_NODE_ID / NUMA_MASK_BITS + 1] = {0};
+    for (int n = 0; n < t->numNodes; n++)
+        mask[t->nodeId[n] / NUMA_MASK_BITS] |= 1UL << (t->nodeId[n] % NUMA_MASK_BITS);
+    if (on) syscall(SYS_set_mempolicy, NUMA_MPOL_INTERLEAVE, mask, (unsigned long)NUMA_MAX_NODE_ID + 1);
+    else syscall(SYS_set_mempolicy, NUMA_MPOL_DEFAULT, NULL, 0UL);
+#else
+    (void)t;
+    (void)on;
+#endif
+}
+
+// ---- replicas ----
+
+typedef struct {
+    const NumaTopology *topo;
+    int node;                // -1: interleave over all nodes
+    Node *src;
+    Node *copy;
+} CloneArgs;
+
+static void *clone_worker(void *arg)
+{
+    CloneArgs *a = (CloneArgs *)arg;
+    if (a->node >= 0) pinThreadToNode(a->topo, a->node);
+    else setInterleave(a->topo, 1);
+    a->copy = cloneRTree(a->src);
+    if (a->node < 0) setInterleave(a->topo, 0);
+    return NULL;
+}
+
+// Tree per topology node for `mode`; entries may alias `root` (NUMA_SHARED)
+// or one interleaved copy. Free with freeNumaTrees.
+Node **createNumaTrees(const NumaTopology *t, Node *root, int mode)
+{
+    Node **trees = (Node **)malloc((size_t)t->numNodes * sizeof(Node *));
+    if (!trees) {
+        perror("Unable to allocate replica table");
+        exit(EXIT_FAILURE);
+    }
+    if (mode == NUMA_SHARED) {
+        for (int n = 0; n < t->numNodes; n++) trees[n] = root;
+        return trees;
+    }
+    int copies = mode == NUMA_REPLICATE ? t->numNodes : 1;
+    pthread_t threads[copies];
+    CloneArgs args[copies];
+    for (int c = 0; c < copies; c++) {
+        args[c] = (CloneArgs){.topo = t, .node = mode == NUMA_REPLICATE ? c : -1, .src = root};
+        pthread_create(&threads[c], NULL, clone_worker, &args[c]);
+    }
+    for (int c = 0; c < copies; c++) pthread_join(threads[c], NULL);
+    for (int n = 0; n < t->numNodes; n++) trees[n] = args[mode == NUMA_REPLICATE ? n : 0].copy;
+    return trees;
+}
+
+void freeNumaTrees(const NumaTopology *t, Node **trees, int mode)
+{
+    if (!trees) return;
+    if (mode == NUMA_REPLICATE)
+        for (int n = 0; n < t->numNodes; n++) freeRTree(trees[n]);
+    else if (mode == NUMA_INTERLEAVE)
+        freeRTree(trees[0]);
+    free(trees);
+}
+
+// Fraction of sampled tree pages (node structs and leaf arrays) that sit on
+// sysfs node `nodeId`; -1 if the kernel cannot tell.
+static double pagesOnNode(Node *root, int nodeId)
+{
+#ifdef SYS_move_pages
+    void **pages = (void **)malloc(NUMA_SAMPLE_PAGES * sizeof(void *));
+    int *status = (int *)malloc(NUMA_SAMPLE_PAGES * sizeof(int));
+    Node **queue = (Node **)malloc(NUMA_SAMPLE_PAGES * sizeof(Node *));
+    long pageSize = sysconf(_SC_PAGESIZE);
+    int np = 0, head = 0, tail = 0;
+    queue[tail++] = root;
+    while (head < tail && np + 2 <= NUMA_SAMPLE_PAGES) {
+        Node *n = queue[head++];
+        pages[np++] = (void *)((uintptr_t)n & ~(uintptr_t)(pageSize - 1));
+        void *arr = n->isLeaf ? (void *)n->rects : (void *)n->children;
+        pages[np++] = (void *)((uintptr_t)arr & ~(uintptr_t)(pageSize - 1));
+        if (!n->isLeaf)
+            for (int i = 0; i < n->count && tail < NUMA_SAMPLE_PAGES; i++) queue[tail++] = n->children[i];
+    }
+    long rc = syscall(SYS_move_pages, 0, (unsigned long)np, pages, NULL, status, 0);
+    int on = 0, known = 0;
+    for (int i = 0; rc == 0 && i < np; i++) {
+        if (status[i] < 0) continue;
+        known++;
+        on += status[i] == nodeId;
+    }
+    free(pages);
+    free(status);
+    free(queue);
+    return known ? (double)on / known : -1;
+#else
+    (void)root;
+    (void)nodeId;
+    return -1;
+#endif
+}
+
+// ---- pinned query workers ----
+
+typedef struct {
+    const NumaTopology *topo;
+    int node;
+    Node *root;
+    const Rect *queries;
+    int *results;
+    int numQuery;
+    int chunk;
+    _Atomic int *next;
+    long long done;
+    char pad[64];
+} NumaWorker;
+
+static void *numa_worker(void *arg)
+{
+    NumaWorker *w = (NumaWorker *)arg;
+    pinThreadToNode(w->topo, w->node);
+    for (;;) {
+        int start = atomic_fetch_add(w->next, w->chunk);
+        if (start >= w->numQuery) break;
+        int end = start + w->chunk < w->numQuery ? start + w->chunk : w->numQuery;
+        for (int i = start; i < end; i++)
+            w->results[i] = searchRTree(w->root, w->queries[i], i);
+        w->done += end - start;
+    }
+    return NULL;
+}
+
+// Dynamic chunked queries like run_thread_pool_query_dynamic, with thread t
+// pinned to node t % numNodes and reading trees[node]. perNode[n] receives
+// the number of queries answered by node n's threads.
+void run_numa_queries(const NumaTopology *t, Node **trees, const Rect *queries, int *results,
+                      int numQuery, int numThreads, int chunk, long long *perNode)
+{
+    pthread_t threads[numThreads];
+    NumaWorker *w = (NumaWorker *)aligned_alloc(64, (sizeof(NumaWorker) * numThreads + 63) / 64 * 64);
+    if (!w) {
+        perror("Unable to allocate NUMA workers");
+        exit(EXIT_FAILURE);
+    }
+    _Atomic int next;
+    atomic_init(&next, 0);
+    for (int i = 0; i < numThreads; i++) {
+        int node = i % t->numNodes;
+        w[i] = (NumaWorker){.topo = t, .node = node, .root = trees[node], .queries = queries,
+                            .results = results, .numQuery = numQuery, .chunk = chunk, .next = &next};
+        pthread_create(&threads[i], NULL, numa_worker, &w[i]);
+    }
+    for (int n = 0; n < t->numNodes; n++) perNode[n] = 0;
+    for (int i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+        perNode[w[i].node] += w[i].done;
+    }
+    free(w);
+}
+
+// Run the query set with each placement and report per-node throughput and
+// how many of the pages each node reads are local to it.
+void numaBenchmark(Node *root, const Rect *queries, int numQuery, int numThreads, long long expected)
+{
+    static const char *names[] = {"shared", "replicate", "interleave"};
+    if (!root || numQuery <= 0) return;
+    NumaTopology *t = readNumaTopology();
+    int *results = (int *)malloc((size_t)numQuery * sizeof(int));
+    long long *perNode = (long long *)malloc((size_t)t->numNodes * sizeof(long long));
+    int chunk = numQuery / (numThreads * 16) > 16 ? numQuery / (numThreads * 16) : 16;
+
+    printf("\n=== NUMA placement (%d node%s, %d threads pinned round-robin) ===\n",
+           t->numNodes, t->numNodes > 1 ? "s" : "", numThreads);
+    printf("%-11s %6s %8s %12s %12s %8s %6s\n", "placement", "node", "cpus", "queries/s",
+           "queries", "local", "match");
+    for (int mode = NUMA_SHARED; mode <= NUMA_INTERLEAVE; mode++) {
+        double t0 = nowSeconds();
+        Node **trees = createNumaTrees(t, root, mode);
+        double setup = nowSeconds() - t0;
+
+        t0 = nowSeconds();
+        run_numa_queries(t, trees, queries, results, numQuery, numThreads, chunk, perNode);
+        double dt = nowSeconds() - t0;
+        long long total = 0;
+        for (int i = 0; i < numQuery; i++) total += results[i];
+
+        for (int n = 0; n < t->numNodes; n++) {
+            double local = pagesOnNode(trees[n], t->nodeId[n]);
+            char localStr[16];
+            if (local < 0) snprintf(localStr, sizeof(localStr), "n/a");
+            else snprintf(localStr, sizeof(localStr), "%.0f%%", 100 * local);
+            printf("%-11s %6d %8d %12.0f %12lld %8s %6s\n", n == 0 ? names[mode] : "", t->nodeId[n],
+                   t->cpuStart[n + 1] - t->cpuStart[n], perNode[n] / dt, perNode[n], localStr,
+                   n == 0 ? (total == expected ? "✅" : "❌") : "");
+        }
+        printf("%-11s total %.0f queries/s, copy setup %.3f s\n", "", numQuery / dt, setup);
+        freeNumaTrees(t, trees, mode);
+    }
+    free(results);
+    free(perNode);
+    freeNumaTopology(t);
+}
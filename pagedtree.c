@@ -0,0 +1,450 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "rtree.h"
+
+// ---------------- Out-of-core paged tree with a buffer pool ----------------
+//
+// writePagedTree packs the rects with STR straight into fixed-size pages:
+//
+//   page 0        header (magic, page size, page count, root, height)
+//   leaf page     PageHeader + up to PAGED_LEAF_CAP Rects
+//   inner page    PageHeader + up to PAGED_NODE_CAP (MBR, child page) entries
+//
+// Leaves are written first in STR order, then every upper level, so siblings
+// sit in consecutive pages. A PagedTree reads pages only through a buffer pool
+// of a fixed number of frames with CLOCK eviction; nothing else of the tree
+// is kept in memory.
+//
+// Queries run a whole batch level by level. Every (page, query) pair of the
+// current level is sorted by page id, the distinct pages are fetched once for
+// the whole batch (a run of consecutive missing pages is one preadv call) and
+// pinned while the pairs that need them are processed. A pool smaller than a
+// level is handled by going through the sorted pairs in chunks of at most
+// poolPages distinct pages.
+
+#define PAGED_PAGE_SIZE 4096
+#define PAGED_MAGIC "STRPAGE1"
+#define PAGED_NONE UINT32_MAX
+
+typedef struct {
+    char magic[8];
+    uint32_t pageSize;
+    uint32_t numPages;
+    uint32_t rootPage;
+    uint32_t height;
+    uint32_t numRects;
+} PagedFileHeader;
+
+typedef struct {
+    uint32_t isLeaf;
+    uint32_t count;
+    uint32_t pad[2];
+} PageHeader;
+
+typedef struct {
+    MBR mbr;
+    uint32_t child;
+} PageEntry;
+
+#define PAGED_LEAF_CAP ((int)((PAGED_PAGE_SIZE - sizeof(PageHeader)) / sizeof(Rect)))
+#define PAGED_NODE_CAP ((int)((PAGED_PAGE_SIZE - sizeof(PageHeader)) / sizeof(PageEntry)))
+
+struct PagedTree {
+    int fd;
+    PagedFileHeader hdr;
+
+    // buffer pool
+    int numFrames;
+    unsigned char *frames;       // numFrames * PAGED_PAGE_SIZE, page aligned
+    uint32_t *framePage;         // page held by each frame, PAGED_NONE if free
+    int *pageFrame;              // frame holding each page, -1 if not resident
+    unsigned char *refBit;
+    unsigned char *pinned;
+    int hand;
+
+    long long pagesRead, readCalls, hits, requests;
+};
+
+// ---- writing ----
+
+// Order base[0..n) in STR tiles of `cap` (sort by X, slice, sort each slice
+// by Y) and store the group boundaries in starts[0..ng]. Returns ng.
+static int strGroups(void *base, int n, size_t size, int cap, int *starts)
+{
+    // Rect and the leading MBR of PageEntry share the layout compareBy*Center reads
+    char *b = (char *)base;
+    qsort(b, (size_t)n, size, compareByXCenter);
+    int S = (int)ceil(sqrt((double)n / cap));
+    if (S < 1) S = 1;
+    int sliceSize = (n + S - 1) / S;
+    int ng = 0;
+    for (int lo = 0; lo < n; lo += sliceSize) {
+        int hi = lo + sliceSize < n ? lo + sliceSize : n;
+        qsort(b + (size_t)lo * size, (size_t)(hi - lo), size, compareByYCenter);
+        for (int i = lo; i < hi; i += cap) starts[ng++] = i;
+    }
+    starts[ng] = n;
+    return ng;
+}
+
+static int writePage(int fd, uint32_t page, const void *buf)
+{
+    return pwrite(fd, buf, PAGED_PAGE_SIZE, (off_t)page * PAGED_PAGE_SIZE) == PAGED_PAGE_SIZE ? 0 : -1;
+}
+
+// Bulk load rects[0..n) into a page file at `path`. The rects are reordered.
+int writePagedTree(const char *path, Rect *rects, int n)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Unable to open page file for writing");
+        return -1;
+    }
+    unsigned char *page = (unsigned char *)aligned_alloc(PAGED_PAGE_SIZE, PAGED_PAGE_SIZE);
+    int maxGroups = n / PAGED_LEAF_CAP + (int)sqrt((double)n) + 2;
+    int *starts = (int *)malloc((size_t)(maxGroups + 1) * sizeof(int));
+    PageEntry *entries = (PageEntry *)malloc((size_t)maxGroups * sizeof(PageEntry));
+    if (!page || !starts || !entries) {
+        perror("Unable to allocate page writer");
+        exit(EXIT_FAILURE);
+    }
+    PageHeader *ph = (PageHeader *)page;
+    uint32_t next = 1;
+    int ok = 1, height = 1;
+
+    // Leaf level
+    int ng = n > 0 ? strGroups(rects, n, sizeof(Rect), PAGED_LEAF_CAP, starts) : 0;
+    for (int g = 0; g < ng && ok; g++) {
+        memset(page, 0, PAGED_PAGE_SIZE);
+        ph->isLeaf = 1;
+        ph->count = (uint32_t)(starts[g + 1] - starts[g]);
+        memcpy(page + sizeof(PageHeader), rects + starts[g], ph->count * sizeof(Rect));
+        initMBR(&entries[g].mbr);
+        for (int i = starts[g]; i < starts[g + 1]; i++) updateMBRWithRect(&entries[g].mbr, rects[i]);
+        entries[g].child = next;
+        ok = writePage(fd, next++, page) == 0;
+    }
+
+    // Upper levels until a single root page remains
+    int count = ng;
+    while (count > 1 && ok) {
+        int np = strGroups(entries, count, sizeof(PageEntry), PAGED_NODE_CAP, starts);
+        for (int g = 0; g < np && ok; g++) {
+            memset(page, 0, PAGED_PAGE_SIZE);
+            ph->isLeaf = 0;
+            ph->count = (uint32_t)(starts[g + 1] - starts[g]);
+            memcpy(page + sizeof(PageHeader), entries + starts[g], ph->count * sizeof(PageEntry));
+            MBR m;
+            initMBR(&m);
+            for (int i = starts[g]; i < starts[g + 1]; i++) m = unionJoin(&m, &entries[i].mbr);
+            // The parent entries overwrite the front of `entries`, behind the reads
+            entries[g].mbr = m;
+            entries[g].child = next;
+            ok = writePage(fd, next++, page) == 0;
+        }
+        count = np;
+        height++;
+    }
+
+    PagedFileHeader h;
+    memset(page, 0, PAGED_PAGE_SIZE);
+    memcpy(h.magic, PAGED_MAGIC, sizeof(h.magic));
+    h.pageSize = PAGED_PAGE_SIZE;
+    h.numPages = next;
+    h.rootPage = count > 0 ? next - 1 : PAGED_NONE;
+    h.height = (uint32_t)(count > 0 ? height : 0);
+    h.numRects = (uint32_t)n;
+    memcpy(page, &h, sizeof(h));
+    if (ok) ok = writePage(fd, 0, page) == 0;
+    if (close(fd) != 0) ok = 0;
+    if (!ok) perror("Unable to write page file");
+
+    free(page);
+    free(starts);
+    free(entries);
+    return ok ? 0 : -1;
+}
+
+// ---- buffer pool ----
+
+PagedTree *openPagedTree(const char *path, int poolPages)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Unable to open page file");
+        return NULL;
+    }
+    PagedFileHeader h;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, PAGED_MAGIC, 8) != 0 ||
+        h.pageSize != PAGED_PAGE_SIZE) {
+        fprintf(stderr, "%s is not a page file of this build\n", path);
+        close(fd);
+        return NULL;
+    }
+    PagedTree *t = (PagedTree *)calloc(1, sizeof(PagedTree));
+    if (!t) {
+        perror("Unable to allocate paged tree");
+        exit(EXIT_FAILURE);
+    }
+    if (poolPages < 1) poolPages = 1;
+    t->fd = fd;
+    t->hdr = h;
+    t->numFrames = poolPages;
+    t->frames = (unsigned char *)aligned_alloc(PAGED_PAGE_SIZE, (size_t)poolPages * PAGED_PAGE_SIZE);
+    t->framePage = (uint32_t *)malloc((size_t)poolPages * sizeof(uint32_t));
+    t->pageFrame = (int *)malloc((size_t)h.numPages * sizeof(int));
+    t->refBit = (unsigned char *)calloc((size_t)poolPages, 1);
+    t->pinned = (unsigned char *)calloc((size_t)poolPages, 1);
+    if (!t->frames || !t->framePage || !t->pageFrame || !t->refBit || !t->pinned) {
+        perror("Unable to allocate buffer pool");
+        exit(EXIT_FAILURE);
+    }
+    for (int f = 0; f < poolPages; f++) t->framePage[f] = PAGED_NONE;
+    for (uint32_t p = 0; p < h.numPages; p++) t->pageFrame[p] = -1;
+    return t;
+}
+
+void closePagedTree(PagedTree *t)
+{
+    if (!t) return;
+    close(t->fd);
+    free(t->frames);
+    free(t->framePage);
+    free(t->pageFrame);
+    free(t->refBit);
+    free(t->pinned);
+    free(t);
+}
+
+// CLOCK: skip pinned frames, give referenced frames a second chance.
+static int clockVictim(PagedTree *t)
+{
+    for (;;) {
+        int f = t->hand;
+        t->hand = t->hand + 1 == t->numFrames ? 0 : t->hand + 1;
+        if (t->pinned[f]) continue;
+        if (t->refBit[f]) {
+            t->refBit[f] = 0;
+            continue;
+        }
+        if (t->framePage[f] != PAGED_NONE) t->pageFrame[t->framePage[f]] = -1;
+        t->framePage[f] = PAGED_NONE;
+        return f;
+    }
+}
+
+// Make the sorted, distinct pages[0..n) resident and pin them; n <= numFrames.
+static void fetchPages(PagedTree *t, const uint32_t *pages, int n)
+{
+    struct iovec iov[64];
+    int run = 0;
+    uint32_t runStart = 0;
+    for (int i = 0; i <= n; i++) {
+        int f = -1;
+        if (i < n) {
+            t->requests++;
+            f = t->pageFrame[pages[i]];
+            if (f >= 0) {
+                t->hits++;
+                t->pinned[f] = 1;
+                t->refBit[f] = 1;
+            }
+        }
+        // Flush the pending run when it cannot be extended by pages[i]
+        if (run > 0 && (i == n || f >= 0 || pages[i] != runStart + run || run == 64)) {
+            ssize_t want = (ssize_t)run * PAGED_PAGE_SIZE;
+            if (preadv(t->fd, iov, run, (off_t)runStart * PAGED_PAGE_SIZE) != want) {
+                perror("Unable to read pages");
+                exit(EXIT_FAILURE);
+            }
+            t->readCalls++;
+            t->pagesRead += run;
+            run = 0;
+        }
+        if (i == n || f >= 0) continue;
+
+        f = clockVictim(t);
+        t->framePage[f] = pages[i];
+        t->pageFrame[pages[i]] = f;
+        t->pinned[f] = 1;
+        t->refBit[f] = 1;
+        if (run == 0) runStart = pages[i];
+        iov[run].iov_base = t->frames + (size_t)f * PAGED_PAGE_SIZE;
+        iov[run].iov_len = PAGED_PAGE_SIZE;
+        run++;
+    }
+}
+
+// ---- batched search ----
+
+typedef struct {
+    uint32_t page;
+    int q;
+} PageVisit;
+
+static int cmpVisit(const void *A, const void *B)
+{
+    const PageVisit *a = (const PageVisit *)A, *b = (const PageVisit *)B;
+    if (a->page != b->page) return (a->page > b->page) - (a->page < b->page);
+    return (a->q > b->q) - (a->q < b->q);
+}
+
+typedef struct {
+    PageVisit *v;
+    int count, cap;
+} VisitList;
+
+static void pushVisit(VisitList *l, uint32_t page, int q)
+{
+    if (l->count == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 1024;
+        l->v = (PageVisit *)realloc(l->v, (size_t)l->cap * sizeof(PageVisit));
+        if (!l->v) {
+            perror("Unable to grow page visit list");
+            exit(EXIT_FAILURE);
+        }
+    }
+    l->v[l->count].page = page;
+    l->v[l->count].q = q;
+    l->count++;
+}
+
+// results[i] = number of rects overlapping queries[i], for the whole batch.
+void searchPagedTreeBatch(PagedTree *t, const Rect *queries, int *results, int numQuery)
+{
+    VisitList cur = {0}, next = {0};
+    uint32_t *pages = (uint32_t *)malloc((size_t)t->numFrames * sizeof(uint32_t));
+    if (!pages) {
+        perror("Unable to allocate page list");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < numQuery; i++) {
+        results[i] = 0;
+        if (t->hdr.rootPage != PAGED_NONE) pushVisit(&cur, t->hdr.rootPage, i);
+    }
+
+    while (cur.count > 0) {
+        qsort(cur.v, (size_t)cur.count, sizeof(PageVisit), cmpVisit);
+        next.count = 0;
+        int i = 0;
+        while (i < cur.count) {
+            // Chunk: as many visits as cover at most numFrames distinct pages
+            int np = 0, j = i;
+            while (j < cur.count) {
+                if (j == i || cur.v[j].page != cur.v[j - 1].page) {
+                    if (np == t->numFrames) break;
+                    pages[np++] = cur.v[j].page;
+                }
+                j++;
+            }
+            fetchPages(t, pages, np);
+
+            for (int k = i; k < j; k++) {
+                const unsigned char *pg = t->frames + (size_t)t->pageFrame[cur.v[k].page] * PAGED_PAGE_SIZE;
+                const PageHeader *ph = (const PageHeader *)pg;
+                Rect q = queries[cur.v[k].q];
+                if (ph->isLeaf) {
+                    const Rect *r = (const Rect *)(pg + sizeof(PageHeader));
+                    int c = 0;
+                    for (uint32_t e = 0; e < ph->count; e++)
+                        if (isOverlap_inline((const MBR *)&r[e], q)) c++;
+                    results[cur.v[k].q] += c;
+                } else {
+                    const PageEntry *en = (const PageEntry *)(pg + sizeof(PageHeader));
+                    for (uint32_t e = 0; e < ph->count; e++)
+                        if (isOverlap_inline(&en[e].mbr, q)) pushVisit(&next, en[e].child, cur.v[k].q);
+                }
+            }
+            for (int p = 0; p < np; p++) t->pinned[t->pageFrame[pages[p]]] = 0;
+            i = j;
+        }
+        VisitList tmp = cur;
+        cur = next;
+        next = tmp;
+    }
+    free(cur.v);
+    free(next.v);
+    free(pages);
+}
+
+uint32_t pagedTreePages(const PagedTree *t)
+{
+    return t->hdr.numPages;
+}
+
+// ---- benchmark: page reads and throughput as the pool shrinks ----
+
+void pagedTreeBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                        long long expected)
+{
+    static const double poolFractions[] = {1.0, 0.25, 0.10, 0.05, 0.01};
+    static const int batches[] = {1, 256};
+    const char *path = "Log/rtree.pages";
+    if (numRects <= 0 || numQuery <= 0) return;
+
+    mkdir("Log", 0777);
+    Rect *copy = (Rect *)malloc((size_t)numRects * sizeof(Rect));
+    int *results = (int *)malloc((size_t)numQuery * sizeof(int));
+    if (!copy || !results) {
+        perror("Unable to allocate paged benchmark");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, rects, (size_t)numRects * sizeof(Rect));
+    double t0 = nowSeconds();
+    int rc = writePagedTree(path, copy, numRects);
+    double buildTime = nowSeconds() - t0;
+    free(copy);
+    if (rc != 0) {
+        free(results);
+        return;
+    }
+
+    PagedTree *probe = openPagedTree(path, 1);
+    if (!probe) {
+        free(results);
+        return;
+    }
+    uint32_t numPages = pagedTreePages(probe);
+    printf("\n=== Paged tree through a buffer pool (%d B pages, %u pages = %.2f MB, height %u, written in %.2f s) ===\n",
+           PAGED_PAGE_SIZE, numPages, (double)numPages * PAGED_PAGE_SIZE / (1024.0 * 1024.0), probe->hdr.height, buildTime);
+    closePagedTree(probe);
+
+    printf("%8s %8s %6s %10s %10s %8s %12s %6s\n", "pool", "frames", "batch", "reads/q",
+           "calls/q", "hit", "queries/s", "match");
+    for (size_t f = 0; f < sizeof(poolFractions) / sizeof(poolFractions[0]); f++) {
+        int frames = (int)(poolFractions[f] * numPages);
+        if (frames < 8) frames = 8;
+        for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+            PagedTree *t = openPagedTree(path, frames);
+            if (!t) break;
+            // Start cold: ask the kernel to drop its cached copy of the file
+            posix_fadvise(t->fd, 0, 0, POSIX_FADV_DONTNEED);
+            long long total = 0;
+            t0 = nowSeconds();
+            for (int q = 0; q < numQuery; q += batches[b]) {
+                int len = numQuery - q < batches[b] ? numQuery - q : batches[b];
+                searchPagedTreeBatch(t, queries + q, results + q, len);
+            }
+            double dt = nowSeconds() - t0;
+            for (int q = 0; q < numQuery; q++) total += results[q];
+            char label[16];
+            snprintf(label, sizeof(label), "%.0f%%", poolFractions[f] * 100);
+            printf("%8s %8d %6d %10.2f %10.2f %7.1f%% %12.0f %6s\n", label, frames, batches[b],
+                   (double)t->pagesRead / numQuery, (double)t->readCalls / numQuery,
+                   t->requests ? 100.0 * t->hits / t->requests : 0.0, numQuery / dt,
+                   total == expected ? "✅" : "❌");
+            closePagedTree(t);
+        }
+    }
+    unlink(path);
+    free(results);
+}
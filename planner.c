@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include "rtree.h"
+
+// ---------------- Scan-vs-index query planner ----------------
+//
+// The planner keeps a small summary of the tree: the nodes of the highest
+// level that still has at most PLAN_MAX_ENTRIES nodes, each with its MBR, the
+// number of rects and leaves below it and the average leaf MBR extent. For a
+// query it estimates how many rects the index would scan in leaves, assuming
+// leaves are spread uniformly inside each summary node:
+//
+//     P(leaf hits q) = |[q.min - leafW, q.max] ∩ [node.min, node.max - leafW]|
+//                      / (node.max - leafW - node.min)             (per axis)
+//
+// Costs per rect for the leaf loop and for the SIMD scan are measured once on
+// this machine, and a query goes to the scan when the estimated index work
+// exceeds a full scan.
+
+#define PLAN_MAX_ENTRIES 256
+#define PLAN_CALIBRATE_RECTS (1 << 16)
+
+// Rect and leaf totals plus summed leaf extents below `node`.
+static void summarizeSubtree(const Node *node, PlanEntry *e, double *sumW, double *sumH)
+{
+    if (node->isLeaf) {
+        e->rects += node->count;
+        e->leaves++;
+        *sumW += (double)node->mbr.xmax - node->mbr.xmin;
+        *sumH += (double)node->mbr.ymax - node->mbr.ymin;
+        return;
+    }
+    for (int i = 0; i < node->count; i++)
+        summarizeSubtree(node->children[i], e, sumW, sumH);
+}
+
+// Leaf-loop cost (what searchRTree does inside a leaf) and SIMD scan cost,
+// in seconds per rect.
+static void calibrate(QueryPlanner *p, const Rect *rects, int numRects)
+{
+    int n = numRects < PLAN_CALIBRATE_RECTS ? numRects : PLAN_CALIBRATE_RECTS;
+    if (n <= 0) {
+        p->leafCost = p->scanCost = 1e-9;
+        return;
+    }
+    Rect q = rects[n / 2];
+    volatile int sink = 0;
+    double best_leaf = 1e30, best_scan = 1e30;
+
+    for (int rep = 0; rep < 5; rep++) {
+        double t0 = nowSeconds();
+        int c = 0;
+        for (int i = 0; i < n; i++)
+            if (isOverlap_inline(&rects[i], q)) c++;
+        double t1 = nowSeconds();
+        sink += c;
+        sink += scanCount(rects, n, q);
+        double t2 = nowSeconds();
+        if (t1 - t0 < best_leaf) best_leaf = t1 - t0;
+        if (t2 - t1 < best_scan) best_scan = t2 - t1;
+    }
+    (void)sink;
+    p->leafCost = best_leaf / n;
+    p->scanCost = best_scan / n;
+}
+
+QueryPlanner *createQueryPlanner(Node *root, const Rect *rects, int numRects)
+{
+    QueryPlanner *p = (QueryPlanner *)calloc(1, sizeof(QueryPlanner));
+    if (!p) {
+        perror("Unable to allocate query planner");
+        exit(EXIT_FAILURE);
+    }
+    p->numRects = numRects;
+    if (!root) return p;
+
+    // Walk down while the next level still fits the summary budget
+    Node **level = (Node **)malloc(sizeof(Node *));
+    int n = 1;
+    level[0] = root;
+    for (;;) {
+        int next = 0, anyLeaf = 0;
+        for (int i = 0; i < n; i++) {
+            if (level[i]->isLeaf) anyLeaf = 1;
+            else next += level[i]->count;
+        }
+        if (anyLeaf || next > PLAN_MAX_ENTRIES) break;
+        Node **nl = (Node **)malloc((size_t)next * sizeof(Node *));
+        int k = 0;
+        for (int i = 0; i < n; i++)
+            for (int c = 0; c < level[i]->count; c++)
+                nl[k++] = level[i]->children[c];
+        free(level);
+        level = nl;
+        n = next;
+    }
+
+    p->entries = (PlanEntry *)calloc((size_t)n, sizeof(PlanEntry));
+    p->numEntries = n;
+    for (int i = 0; i < n; i++) {
+        PlanEntry *e = &p->entries[i];
+        double sumW = 0, sumH = 0;
+        e->mbr = level[i]->mbr;
+        summarizeSubtree(level[i], e, &sumW, &sumH);
+        e->leafW = e->leaves ? sumW / e->leaves : 0;
+        e->leafH = e->leaves ? sumH / e->leaves : 0;
+    }
+    free(level);
+
+    calibrate(p, rects, numRects);
+    return p;
+}
+
+// Probability that an interval of length `len`, placed uniformly so that it
+// stays inside [lo, hi], intersects [qlo, qhi].
+static double hitProbability(double lo, double hi, double len, double qlo, double qhi)
+{
+    double span = hi - len - lo;           // range of the interval's start
+    double a = qlo - len, b = qhi;         // starts that intersect the query
+    if (span <= 0)
+        return (b >= lo && a <= lo) ? 1.0 : 0.0;
+    if (a < lo) a = lo;
+    if (b > hi - len) b = hi - len;
+    if (b < a) return 0.0;
+    double p = (b - a) / span;
+    return p > 1.0 ? 1.0 : p;
+}
+
+// Estimated number of rects the index path scans in leaves for `q`.
+double plannerEstimateCandidates(const QueryPlanner *p, Rect q)
+{
+    double est = 0;
+    for (int i = 0; i < p->numEntries; i++) {
+        const PlanEntry *e = &p->entries[i];
+        if (!isOverlap_inline(&e->mbr, q)) continue;
+        double px = hitProbability(e->mbr.xmin, e->mbr.xmax, e->leafW, q.xmin, q.xmax);
+        double py = hitProbability(e->mbr.ymin, e->mbr.ymax, e->leafH, q.ymin, q.ymax);
+        est += e->rects * px * py;
+    }
+    return est;
+}
+
+int plannerChooseScan(const QueryPlanner *p, Rect q)
+{
+    if (p->numEntries == 0) return 0;
+    double indexCost = plannerEstimateCandidates(p, q) * p->leafCost;
+    double scanCost = (double)p->numRects * p->scanCost;
+    return indexCost > scanCost;
+}
+
+// Decide scan (1) or index (0) for every query; returns how many go to scan.
+int planQueries(const QueryPlanner *p, const Rect *queries, int numQuery, unsigned char *useScan)
+{
+    int scans = 0;
+    for (int i = 0; i < numQuery; i++) {
+        useScan[i] = (unsigned char)plannerChooseScan(p, queries[i]);
+        scans += useScan[i];
+    }
+    return scans;
+}
+
+void freeQueryPlanner(QueryPlanner *p)
+{
+    if (!p) return;
+    free(p->entries);
+    free(p);
+}
+
+// Time searchRTree against scanCount on windows of growing size around data
+// rects, print one row per size and the first size at which the scan wins.
+void plannerCrossover(Node *root, const Rect *rects, int numRects)
+{
+    static const double fractions[] = {0.001, 0.01, 0.05, 0.10, 0.25, 0.50, 0.75, 1.0};
+    const int nf = (int)(sizeof(fractions) / sizeof(fractions[0]));
+    const int perSize = 16;
+    if (!root || numRects <= 0) return;
+
+    double W = (double)root->mbr.xmax - root->mbr.xmin;
+    double H = (double)root->mbr.ymax - root->mbr.ymin;
+    double crossover = -1;
+    srand(42);
+
+    printf("\n=== Scan vs index crossover (single thread) ===\n");
+    printf("%10s %12s %12s %12s\n", "window", "index ms/q", "scan ms/q", "hits/q");
+    for (int f = 0; f < nf; f++) {
+        double side = fractions[f] < 1.0 ? sqrt(fractions[f]) : 1.0;
+        double ti = 0, ts = 0;
+        long long hits = 0;
+        for (int k = 0; k < perSize; k++) {
+            const Rect *c = &rects[rand() % numRects];
+            int cx = c->xmin / 2 + c->xmax / 2, cy = c->ymin / 2 + c->ymax / 2;
+            Rect q;
+            if (fractions[f] >= 1.0) {
+                q = root->mbr;
+            } else {
+                int hw = (int)(side * W / 2), hh = (int)(side * H / 2);
+                q = (Rect){cx - hw, cy - hh, cx + hw, cy + hh};
+            }
+            double t0 = nowSeconds();
+            int a = searchRTree(root, q, k);
+            double t1 = nowSeconds();
+            int b = scanCount(rects, numRects, q);
+            double t2 = nowSeconds();
+            if (a != b)
+                printf("❌ Scan/index mismatch on window %.1f%%\n", fractions[f] * 100);
+            hits += a;
+            ti += t1 - t0;
+            ts += t2 - t1;
+        }
+        printf("%9.1f%% %12.3f %12.3f %12lld\n", fractions[f] * 100,
+               ti * 1e3 / perSize, ts * 1e3 / perSize, hits / perSize);
+        if (crossover < 0 && ts < ti) crossover = fractions[f];
+    }
+    if (crossover < 0)
+        printf("Crossover: index wins at every window size\n");
+    else
+        printf("Crossover: scan wins from windows of %.1f%% of the data space\n", crossover * 100);
+}
@@ -0,0 +1,362 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Polygon filter and refine ----------------
+//
+// A PolygonIndex is a FlatTree over the MBRs plus a columnar vertex store
+// in the same order. A leaf's `first` indexes flat->rects, and it indexes
+// the polygon starts too, so a leaf's geometry is one contiguous run of
+// the xs / ys columns. Rings are stored closed (first vertex repeated), so
+// edge i always runs from vertex i to vertex i + 1.
+//
+// The datasets only have MBRs, so each polygon is synthesized. It is a
+// star-shaped ring of 6 to 16 vertices seeded by the rect's input
+// position, scaled so that its bounding box is exactly the MBR. Boxes
+// under POLY_MIN_SPAN get a diamond instead.
+//
+// The MBR filter yields candidates. A candidate whose MBR lies inside the
+// window is accepted as is. The others go to polygonMeetsWindow, which
+// clamps the window to the MBR and makes one branch-free pass over the
+// edges. An edge meets the window unless an axis or the edge normal
+// separates them. Parity of ray crossings from a window corner detects a
+// window that lies inside the ring. polygonQuery runs both stages per
+// leaf, refining each leaf's batch as soon as it is filtered.
+
+#define POLY_MIN_VERTS 6
+#define POLY_MAX_VERTS 16
+#define POLY_MIN_SPAN 8
+#define POLY_CHUNK 256      // queries per filter / refine round of the staged run
+#define POLY_PI 3.14159265358979323846
+
+static uint32_t polyRand(uint32_t *s)
+{
+    *s = *s * 1103515245u + 12345u;
+    return *s >> 8;
+}
+
+// Ring for rect r into xs / ys (closed); returns the stored vertex count
+static int synthesizeRing(Rect r, uint32_t id, int32_t *xs, int32_t *ys)
+{
+    long long w = (long long)r.xmax - r.xmin, h = (long long)r.ymax - r.ymin;
+    if (w < POLY_MIN_SPAN || h < POLY_MIN_SPAN) {
+        int cx = (int)(r.xmin + w / 2), cy = (int)(r.ymin + h / 2);
+        int32_t dx[5] = {r.xmin, cx, r.xmax, cx, r.xmin}, dy[5] = {cy, r.ymin, cy, r.ymax, cy};
+        memcpy(xs, dx, sizeof(dx));
+        memcpy(ys, dy, sizeof(dy));
+        return 5;
+    }
+    uint32_t seed = id * 2654435761u ^ 0x5bd1e995u;
+    int k = POLY_MIN_VERTS + (int)(polyRand(&seed) % (POLY_MAX_VERTS - POLY_MIN_VERTS + 1));
+    double u[POLY_MAX_VERTS], v[POLY_MAX_VERTS];
+    double umin = INFINITY, umax = -INFINITY, vmin = INFINITY, vmax = -INFINITY;
+    for (int j = 0; j < k; j++) {
+        double a = 2 * POLY_PI * (j + 0.8 * (polyRand(&seed) % 1000) / 1000.0) / k;
+        double rho = 0.45 + 0.55 * (polyRand(&seed) % 1000) / 1000.0;
+        u[j] = rho * cos(a);
+        v[j] = rho * sin(a);
+        umin = fmin(umin, u[j]);
+        umax = fmax(umax, u[j]);
+        vmin = fmin(vmin, v[j]);
+        vmax = fmax(vmax, v[j]);
+    }
+    for (int j = 0; j < k; j++) {
+        xs[j] = r.xmin + (int32_t)llround((u[j] - umin) / (umax - umin) * w);
+        ys[j] = r.ymin + (int32_t)llround((v[j] - vmin) / (vmax - vmin) * h);
+    }
+    xs[k] = xs[0];
+    ys[k] = ys[0];
+    return k + 1;
+}
+
+PolygonIndex *createPolygonIndex(Node *root, const Rect *rects, int n)
+{
+    PolygonIndex *p = (PolygonIndex *)calloc(1, sizeof(PolygonIndex));
+    if (!p) {
+        perror("Unable to allocate polygon index");
+        exit(EXIT_FAILURE);
+    }
+    p->flat = createFlatTree(root, FLAT_BFS);
+    uint32_t m = p->flat ? p->flat->numRects : 0;
+    uint32_t *ids = p->flat ? flatTreeRectIds(p->flat, rects, n) : NULL;
+    p->start = (uint32_t *)malloc(((size_t)m + 1) * sizeof(uint32_t));
+    size_t cap = (size_t)m * 8 + 1;
+    p->xs = (int32_t *)malloc(cap * sizeof(int32_t));
+    p->ys = (int32_t *)malloc(cap * sizeof(int32_t));
+    if (!p->start || !p->xs || !p->ys) {
+        perror("Unable to allocate polygon store");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    for (uint32_t i = 0; i < m; i++) {
+        if (used + POLY_MAX_VERTS + 1 > cap) {
+            cap *= 2;
+            p->xs = (int32_t *)realloc(p->xs, cap * sizeof(int32_t));
+            p->ys = (int32_t *)realloc(p->ys, cap * sizeof(int32_t));
+            if (!p->xs || !p->ys) {
+                perror("Unable to grow polygon store");
+                exit(EXIT_FAILURE);
+            }
+        }
+        p->start[i] = (uint32_t)used;
+        used += (size_t)synthesizeRing(p->flat->rects[i], ids[i], p->xs + used, p->ys + used);
+    }
+    p->start[m] = (uint32_t)used;
+    p->numPolygons = m;
+    p->numVertices = (uint32_t)used;
+    free(ids);
+    return p;
+}
+
+void freePolygonIndex(PolygonIndex *p)
+{
+    if (!p) return;
+    freeFlatTree(p->flat);
+    free(p->start);
+    free(p->xs);
+    free(p->ys);
+    free(p);
+}
+
+// Vertex columns and ring starts (the flat tree is counted separately)
+size_t polygonStoreBytes(const PolygonIndex *p)
+{
+    return (size_t)p->numVertices * 2 * sizeof(int32_t) + ((size_t)p->numPolygons + 1) * sizeof(uint32_t);
+}
+
+static inline int insideRect(const Rect *r, Rect w)
+{
+    return r->xmin >= w.xmin && r->xmax <= w.xmax && r->ymin >= w.ymin && r->ymax <= w.ymax;
+}
+
+// Exact test of polygon i against q, whose MBR overlaps q. Every edge lies
+// in the MBR, so clamping q to it changes nothing and keeps the products
+// within the MBR span.
+int polygonMeetsWindow(const PolygonIndex *p, uint32_t i, Rect q)
+{
+    const Rect *m = &p->flat->rects[i];
+    const int64_t wx0 = q.xmin > m->xmin ? q.xmin : m->xmin, wy0 = q.ymin > m->ymin ? q.ymin : m->ymin;
+    const int64_t wx1 = q.xmax < m->xmax ? q.xmax : m->xmax, wy1 = q.ymax < m->ymax ? q.ymax : m->ymax;
+    const int32_t *xs = p->xs, *ys = p->ys;
+    int hit = 0, inside = 0;
+    for (uint32_t v = p->start[i], end = p->start[i + 1] - 1; v < end; v++) {
+        const int64_t x0 = xs[v], y0 = ys[v], x1 = xs[v + 1], y1 = ys[v + 1];
+        const int64_t dx = x1 - x0, dy = y1 - y0;
+        const int box = ((x0 < x1 ? x0 : x1) <= wx1) & ((x0 > x1 ? x0 : x1) >= wx0) &
+                        ((y0 < y1 ? y0 : y1) <= wy1) & ((y0 > y1 ? y0 : y1) >= wy0);
+        // Side of each window corner relative to the edge line
+        const int64_t c0 = dx * (wy0 - y0) - dy * (wx0 - x0), c1 = dx * (wy0 - y0) - dy * (wx1 - x0);
+        const int64_t c2 = dx * (wy1 - y0) - dy * (wx0 - x0), c3 = dx * (wy1 - y0) - dy * (wx1 - x0);
+        const int pos = (c0 > 0) & (c1 > 0) & (c2 > 0) & (c3 > 0);
+        const int neg = (c0 < 0) & (c1 < 0) & (c2 < 0) & (c3 < 0);
+        hit |= box & !(pos | neg);
+        // Ray from corner (wx0, wy0) towards +x; c0 > 0 puts the corner
+        // left of an upward edge. Ties mean the corner is on the edge,
+        // which `hit` already reports.
+        inside ^= ((y0 > wy0) != (y1 > wy0)) & ((c0 > 0) ^ (dy < 0));
+    }
+    return hit | inside;
+}
+
+// Refine stage: exact hits among candidates (positions in flat->rects)
+int polygonRefine(const PolygonIndex *p, Rect q, const uint32_t *cand, int n, RefineStats *s)
+{
+    int hits = 0, contained = 0, refined = 0;
+    long long vertices = 0;
+    for (int k = 0; k < n; k++) {
+        uint32_t i = cand[k];
+        if (insideRect(&p->flat->rects[i], q)) {
+            contained++;
+            hits++;
+            continue;
+        }
+        refined++;
+        vertices += p->start[i + 1] - p->start[i];
+        hits += polygonMeetsWindow(p, i, q);
+    }
+    if (s) {
+        s->candidates += n;
+        s->contained += contained;
+        s->refined += refined;
+        s->vertices += vertices;
+        s->hits += hits;
+    }
+    return hits;
+}
+
+static int fusedFrom(const PolygonIndex *p, uint32_t idx, Rect q, RefineStats *s)
+{
+    const FlatNode *n = &p->flat->nodes[idx];
+    if (!n->isLeaf) {
+        int hits = 0;
+        for (uint32_t c = n->first; c < n->first + n->count; c++)
+            if (isOverlap_inline(&p->flat->nodes[c].mbr, q)) hits += fusedFrom(p, c, q, s);
+        return hits;
+    }
+    // Filter the leaf into a batch, then refine the batch while its
+    // rects and rings are still in cache
+    uint32_t batch[BUNDLEFACTOR];
+    int hits = 0, nb = 0;
+    const Rect *r = &p->flat->rects[n->first];
+    for (uint32_t i = 0; i < n->count; i++) {
+        if (!isOverlap_inline((const MBR *)&r[i], q)) continue;
+        batch[nb++] = n->first + i;
+        if (nb == BUNDLEFACTOR) {
+            hits += polygonRefine(p, q, batch, nb, s);
+            nb = 0;
+        }
+    }
+    return hits + polygonRefine(p, q, batch, nb, s);
+}
+
+// Both stages, pipelined per leaf
+int polygonQuery(const PolygonIndex *p, Rect q, RefineStats *s)
+{
+    if (!p->flat || p->flat->numNodes == 0 || !isOverlap_inline(&p->flat->nodes[0].mbr, q)) return 0;
+    return fusedFrom(p, 0, q, s);
+}
+
+// ---- benchmark ----
+
+static int64_t orient(int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t cx, int64_t cy)
+{
+    int64_t d = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    return (d > 0) - (d < 0);
+}
+
+static int onSegment(int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t cx, int64_t cy)
+{
+    return cx >= (ax < bx ? ax : bx) && cx <= (ax > bx ? ax : bx) && cy >= (ay < by ? ay : by) &&
+           cy <= (ay > by ? ay : by);
+}
+
+static int segmentsMeet(const int64_t *a, const int64_t *b)
+{
+    int64_t o1 = orient(a[0], a[1], a[2], a[3], b[0], b[1]), o2 = orient(a[0], a[1], a[2], a[3], b[2], b[3]);
+    int64_t o3 = orient(b[0], b[1], b[2], b[3], a[0], a[1]), o4 = orient(b[0], b[1], b[2], b[3], a[2], a[3]);
+    if (o1 != o2 && o3 != o4) return 1;
+    return (o1 == 0 && onSegment(a[0], a[1], a[2], a[3], b[0], b[1])) ||
+           (o2 == 0 && onSegment(a[0], a[1], a[2], a[3], b[2], b[3])) ||
+           (o3 == 0 && onSegment(b[0], b[1], b[2], b[3], a[0], a[1])) ||
+           (o4 == 0 && onSegment(b[0], b[1], b[2], b[3], a[2], a[3]));
+}
+
+// Textbook reference: a vertex in the window, an edge crossing a window
+// side, or a window corner inside the ring (ray casting in doubles).
+static int referenceMeets(const PolygonIndex *p, uint32_t i, Rect q)
+{
+    const Rect *m = &p->flat->rects[i];
+    if (!isOverlap_inline((const MBR *)m, q)) return 0;
+    Rect w = {q.xmin > m->xmin ? q.xmin : m->xmin, q.ymin > m->ymin ? q.ymin : m->ymin,
+              q.xmax < m->xmax ? q.xmax : m->xmax, q.ymax < m->ymax ? q.ymax : m->ymax};
+    int64_t sides[4][4] = {{w.xmin, w.ymin, w.xmax, w.ymin}, {w.xmax, w.ymin, w.xmax, w.ymax},
+                           {w.xmax, w.ymax, w.xmin, w.ymax}, {w.xmin, w.ymax, w.xmin, w.ymin}};
+    uint32_t s = p->start[i], e = p->start[i + 1] - 1;
+    for (uint32_t v = s; v < e; v++) {
+        if (p->xs[v] >= w.xmin && p->xs[v] <= w.xmax && p->ys[v] >= w.ymin && p->ys[v] <= w.ymax) return 1;
+        int64_t edge[4] = {p->xs[v], p->ys[v], p->xs[v + 1], p->ys[v + 1]};
+        for (int k = 0; k < 4; k++)
+            if (segmentsMeet(edge, sides[k])) return 1;
+    }
+    int in = 0;
+    for (uint32_t v = s; v < e; v++) {
+        double x0 = p->xs[v], y0 = p->ys[v], x1 = p->xs[v + 1], y1 = p->ys[v + 1];
+        if ((y0 > w.ymin) != (y1 > w.ymin) && w.xmin < x0 + (w.ymin - y0) * (x1 - x0) / (y1 - y0)) in ^= 1;
+    }
+    return in;
+}
+
+// MBR filter alone, then filter and refine as two separately timed
+// stages, then the per-leaf pipeline.
+void polygonBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                      long long expected)
+{
+    double t0 = nowSeconds();
+    PolygonIndex *p = createPolygonIndex(root, rects, numRects);
+    double buildTime = nowSeconds() - t0;
+    int ok = 1;
+    printf("\n[Filter and refine] %u synthetic polygons, %.1f vertices each (closed rings), single thread\n",
+           p->numPolygons, p->numPolygons ? (double)p->numVertices / p->numPolygons : 0.0);
+    printf("Vertex store %.2f MB + flat tree %.2f MB, built in %.2f s\n", polygonStoreBytes(p) / (1024.0 * 1024.0),
+           flatTreeBytes(p->flat) / (1024.0 * 1024.0), buildTime);
+
+    // Filter only
+    long long filtered = 0;
+    t0 = nowSeconds();
+    for (int i = 0; i < numQuery; i++) filtered += searchFlatTree(p->flat, queries[i]);
+    double filterOnly = nowSeconds() - t0;
+    ok &= filtered == expected;
+
+    // Two stages per chunk of queries: all candidates first, then all
+    // refinement; every 10th query is checked against the reference test
+    int offset[POLY_CHUNK + 1];
+    size_t cap = 1 << 16;
+    uint32_t *cand = (uint32_t *)malloc(cap * sizeof(uint32_t));
+    if (!cand) {
+        perror("Unable to allocate refine candidates");
+        exit(EXIT_FAILURE);
+    }
+    RefineStats staged = {0};
+    double filterTime = 0, refineTime = 0;
+    long long used = 0, checked = 0;
+    for (int base = 0; base < numQuery; base += POLY_CHUNK) {
+        int nq = numQuery - base < POLY_CHUNK ? numQuery - base : POLY_CHUNK;
+        t0 = nowSeconds();
+        size_t n = 0;
+        for (int i = 0; i < nq; i++) {
+            offset[i] = (int)n;
+            int c = searchFlatTree_collect(p->flat, queries[base + i], cand + n, (int)(cap - n));
+            if (n + (size_t)c > cap) {
+                while (n + (size_t)c > cap) cap *= 2;
+                cand = (uint32_t *)realloc(cand, cap * sizeof(uint32_t));
+                if (!cand) {
+                    perror("Unable to grow refine candidates");
+                    exit(EXIT_FAILURE);
+                }
+                searchFlatTree_collect(p->flat, queries[base + i], cand + n, c);
+            }
+            n += (size_t)c;
+        }
+        offset[nq] = (int)n;
+        filterTime += nowSeconds() - t0;
+        used += (long long)n;
+
+        t0 = nowSeconds();
+        for (int i = 0; i < nq; i++)
+            polygonRefine(p, queries[base + i], cand + offset[i], offset[i + 1] - offset[i], &staged);
+        refineTime += nowSeconds() - t0;
+
+        for (int i = 0; i < nq && ok; i += 10)
+            for (int k = offset[i]; k < offset[i + 1]; k++, checked++) {
+                uint32_t c = cand[k];
+                Rect q = queries[base + i];
+                int fast = insideRect(&p->flat->rects[c], q) || polygonMeetsWindow(p, c, q);
+                ok &= fast == referenceMeets(p, c, q);
+            }
+    }
+
+    // Pipelined per leaf
+    RefineStats fused = {0};
+    t0 = nowSeconds();
+    for (int i = 0; i < numQuery; i++) polygonQuery(p, queries[i], &fused);
+    double fusedTime = nowSeconds() - t0;
+    ok &= fused.hits == staged.hits && fused.candidates == filtered && used == filtered;
+
+    printf("%-22s %10s %14s\n", "stage", "time (s)", "results");
+    printf("%-22s %10.4f %14lld\n", "MBR filter", filterOnly, filtered);
+    printf("%-22s %10.4f %14lld\n", "filter (collect)", filterTime, used);
+    printf("%-22s %10.4f %14lld\n", "refine", refineTime, staged.hits);
+    printf("%-22s %10.4f %14lld\n", "pipelined per leaf", fusedTime, fused.hits);
+    printf("Refine: %lld accepted by MBR containment, %lld tested exactly (%lld vertices), %.1f ns per candidate; "
+           "%lld false positives (%.2f%% of MBR hits)\n",
+           staged.contained, staged.refined, staged.vertices,
+           staged.candidates ? 1e9 * refineTime / staged.candidates : 0.0, filtered - staged.hits,
+           filtered ? 100.0 * (filtered - staged.hits) / filtered : 0.0);
+    printf("%s Refined results %s (MBR candidates vs sequential, pipelined vs staged, %lld checked against the "
+           "reference test)\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match", checked);
+    free(cand);
+    freePolygonIndex(p);
+}
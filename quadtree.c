@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "rtree.h"
+
+// ---------------- PR quadtree engine ----------------
+//
+// Rects are placed by their center: a region splits into four equal
+// quadrants once it holds more than QT_LEAF centers, down to QT_MAX_DEPTH.
+// The build partitions one item array in place, so every node's items are
+// the contiguous range [first, first + count). Each node also keeps the MBR
+// of its items, which may reach past its region; queries test that box,
+// and a node whose box lies inside the window adds `count` without
+// visiting its subtree.
+
+#define QT_LEAF 32
+#define QT_MAX_DEPTH 24
+
+typedef struct {
+    Rect r;
+    uint32_t id;
+} QtItem;
+
+typedef struct {
+    MBR box;                      // MBR of the items below
+    uint32_t first, count;
+    int child[4];                 // -1 for an empty quadrant or a leaf
+    int isLeaf;
+} QtNode;
+
+typedef struct {
+    QtItem *items;
+    QtNode *nodes;
+    int numNodes, capNodes;
+    int numLeaves, depth;
+    int numRects;
+} QuadTree;
+
+static inline long long centerX2(Rect r)
+{
+    return (long long)r.xmin + r.xmax;
+}
+
+static inline long long centerY2(Rect r)
+{
+    return (long long)r.ymin + r.ymax;
+}
+
+// Move items with pred true to the front; returns how many
+static uint32_t partitionItems(QtItem *a, uint32_t n, int byY, long long mid2)
+{
+    uint32_t i = 0, j = n;
+    while (i < j) {
+        long long c = byY ? centerY2(a[i].r) : centerX2(a[i].r);
+        if (c < mid2) {
+            i++;
+        } else {
+            QtItem t = a[i];
+            a[i] = a[--j];
+            a[j] = t;
+        }
+    }
+    return i;
+}
+
+// Build the node for items[first .. first + count) in region [x0, x1) x
+// [y0, y1) (doubled coordinates, to compare against doubled centers).
+static int qtBuild(QuadTree *t, uint32_t first, uint32_t count, long long x0, long long x1, long long y0,
+                   long long y1, int depth)
+{
+    if (t->numNodes == t->capNodes) {
+        t->capNodes = t->capNodes ? t->capNodes * 2 : 1024;
+        t->nodes = (QtNode *)realloc(t->nodes, (size_t)t->capNodes * sizeof(QtNode));
+        if (!t->nodes) {
+            perror("Unable to grow quadtree");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int id = t->numNodes++;
+    QtNode node = {.first = first, .count = count, .child = {-1, -1, -1, -1}, .isLeaf = 1};
+    node.box = t->items[first].r;
+    for (uint32_t i = first + 1; i < first + count; i++) {
+        Rect r = t->items[i].r;
+        if (r.xmin < node.box.xmin) node.box.xmin = r.xmin;
+        if (r.ymin < node.box.ymin) node.box.ymin = r.ymin;
+        if (r.xmax > node.box.xmax) node.box.xmax = r.xmax;
+        if (r.ymax > node.box.ymax) node.box.ymax = r.ymax;
+    }
+    if (depth > t->depth) t->depth = depth;
+    if (count > QT_LEAF && depth < QT_MAX_DEPTH && x1 - x0 > 2 && y1 - y0 > 2) {
+        long long mx = x0 + (x1 - x0) / 2, my = y0 + (y1 - y0) / 2;
+        QtItem *a = t->items + first;
+        uint32_t south = partitionItems(a, count, 1, my);
+        uint32_t sw = partitionItems(a, south, 0, mx);
+        uint32_t nw = partitionItems(a + south, count - south, 0, mx);
+        uint32_t start[5] = {0, sw, south, south + nw, count};
+        long long qx0[4] = {x0, mx, x0, mx}, qx1[4] = {mx, x1, mx, x1};
+        long long qy0[4] = {y0, y0, my, my}, qy1[4] = {my, my, y1, y1};
+        node.isLeaf = 0;
+        for (int q = 0; q < 4; q++)
+            if (start[q + 1] > start[q])
+                node.child[q] = qtBuild(t, first + start[q], start[q + 1] - start[q], qx0[q], qx1[q], qy0[q],
+                                        qy1[q], depth + 1);
+    }
+    if (node.isLeaf) t->numLeaves++;
+    t->nodes[id] = node;                  // after the recursion, which may move t->nodes
+    return id;
+}
+
+static void *quadtreeBuild(const Rect *rects, int n)
+{
+    QuadTree *t = (QuadTree *)calloc(1, sizeof(QuadTree));
+    if (!t) {
+        perror("Unable to allocate quadtree");
+        exit(EXIT_FAILURE);
+    }
+    t->numRects = n;
+    if (n == 0) return t;
+    t->items = (QtItem *)malloc((size_t)n * sizeof(QtItem));
+    if (!t->items) {
+        perror("Unable to allocate quadtree items");
+        exit(EXIT_FAILURE);
+    }
+    long long x0 = centerX2(rects[0]), x1 = x0, y0 = centerY2(rects[0]), y1 = y0;
+    for (int i = 0; i < n; i++) {
+        t->items[i] = (QtItem){rects[i], (uint32_t)i};
+        long long cx = centerX2(rects[i]), cy = centerY2(rects[i]);
+        if (cx < x0) x0 = cx;
+        if (cx > x1) x1 = cx;
+        if (cy < y0) y0 = cy;
+        if (cy > y1) y1 = cy;
+    }
+    qtBuild(t, 0, (uint32_t)n, x0, x1 + 1, y0, y1 + 1, 0);
+    return t;
+}
+
+static int qtContains(Rect q, MBR b)
+{
+    return b.xmin >= q.xmin && b.xmax <= q.xmax && b.ymin >= q.ymin && b.ymax <= q.ymax;
+}
+
+static int qtVisit(const QuadTree *t, int id, Rect q, uint32_t *out, int maxOut, int count)
+{
+    const QtNode *n = &t->nodes[id];
+    if (!isOverlap_inline(&n->box, q)) return count;
+    if (qtContains(q, n->box)) {
+        if (out)
+            for (uint32_t i = 0; i < n->count && count + (int)i < maxOut; i++)
+                out[count + i] = t->items[n->first + i].id;
+        return count + (int)n->count;
+    }
+    if (n->isLeaf) {
+        for (uint32_t i = n->first; i < n->first + n->count; i++) {
+            if (!isOverlap_inline(&t->items[i].r, q)) continue;
+            if (out && count < maxOut) out[count] = t->items[i].id;
+            count++;
+        }
+        return count;
+    }
+    for (int c = 0; c < 4; c++)
+        if (n->child[c] >= 0) count = qtVisit(t, n->child[c], q, out, maxOut, count);
+    return count;
+}
+
+static int quadtreeCount(const void *index, Rect q)
+{
+    const QuadTree *t = (const QuadTree *)index;
+    return t->numNodes ? qtVisit(t, 0, q, NULL, 0, 0) : 0;
+}
+
+static int quadtreeReport(const void *index, Rect q, uint32_t *ids, int maxOut)
+{
+    const QuadTree *t = (const QuadTree *)index;
+    return t->numNodes ? qtVisit(t, 0, q, ids, maxOut, 0) : 0;
+}
+
+static size_t quadtreeBytes(const void *index)
+{
+    const QuadTree *t = (const QuadTree *)index;
+    return sizeof(QuadTree) + (size_t)t->numNodes * sizeof(QtNode) + (size_t)t->numRects * sizeof(QtItem);
+}
+
+static void quadtreeDescribe(const void *index, char *buf, size_t len)
+{
+    const QuadTree *t = (const QuadTree *)index;
+    snprintf(buf, len, "%d nodes, %d leaves, depth %d", t->numNodes, t->numLeaves, t->depth);
+}
+
+static void quadtreeDestroy(void *index)
+{
+    QuadTree *t = (QuadTree *)index;
+    free(t->items);
+    free(t->nodes);
+    free(t);
+}
+
+const SpatialIndexOps quadtreeIndexOps = {
+    "quadtree", quadtreeBuild, quadtreeCount, quadtreeReport, quadtreeBytes, quadtreeDescribe, quadtreeDestroy};
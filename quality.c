@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "rtree.h"
+
+// ---------------- Tree quality analyzer ----------------
+//
+// analyzeRTree walks a tree level by level (level 0 is the root) and, with
+// the nodes of each level split over threads, records per level:
+//
+//   area        sum of node MBR areas
+//   overlap     sum of pairwise intersection areas of nodes with the same
+//               parent
+//   dead space  share of the node areas not covered by any entry of the
+//               node, estimated from QUALITY_SAMPLES points per node
+//   fill        entries / capacity (BUNDLEFACTOR for leaves, FANOUT above)
+//   margin      sum of node perimeters
+//
+// Given queries it also predicts node accesses per level with the usual
+// model for windows of size (qx, qy) placed uniformly in the root MBR:
+// a node of size (w, h) is visited with probability (w + qx)(h + qy) / A.
+// Summed over a level that is (area + E[qy] W + E[qx] H + N E[qx qy]) / A
+// with W, H the sums of node widths and heights, so only four sums per level
+// are needed. The measured count of nodes whose MBR meets the query is
+// reported next to it for the same queries.
+
+#define QUALITY_SAMPLES 64
+#define QUALITY_MAX_QUERIES 4096
+
+typedef struct {
+    Node ***levels;
+    int *levelSize;
+    int height;
+    const Rect *queries;
+    int numQuery;
+    int numThreads;
+    int thread;
+    LevelQuality *acc;          // per thread, height entries
+} QualityArgs;
+
+static double rectArea(MBR m)
+{
+    return ((double)m.xmax - m.xmin) * ((double)m.ymax - m.ymin);
+}
+
+static double interArea(MBR a, MBR b)
+{
+    int x0 = a.xmin > b.xmin ? a.xmin : b.xmin, x1 = a.xmax < b.xmax ? a.xmax : b.xmax;
+    int y0 = a.ymin > b.ymin ? a.ymin : b.ymin, y1 = a.ymax < b.ymax ? a.ymax : b.ymax;
+    if (x1 <= x0 || y1 <= y0) return 0.0;
+    return ((double)x1 - x0) * ((double)y1 - y0);
+}
+
+static MBR entryMbr(const Node *n, int i)
+{
+    return n->isLeaf ? n->rects[i] : n->children[i]->mbr;
+}
+
+// Share of the node's MBR outside all of its entries, from a fixed
+// pseudo-random point set so results repeat run to run
+static double uncoveredShare(const Node *n, unsigned seed)
+{
+    MBR m = n->mbr;
+    if (m.xmax <= m.xmin || m.ymax <= m.ymin) return 0.0;
+    unsigned s = seed * 2654435761u + 1;
+    int uncovered = 0;
+    for (int k = 0; k < QUALITY_SAMPLES; k++) {
+        s = s * 1664525u + 1013904223u;
+        double fx = (s >> 8) / 16777216.0;
+        s = s * 1664525u + 1013904223u;
+        double fy = (s >> 8) / 16777216.0;
+        int x = (int)(m.xmin + fx * ((double)m.xmax - m.xmin));
+        int y = (int)(m.ymin + fy * ((double)m.ymax - m.ymin));
+        int covered = 0;
+        for (int i = 0; i < n->count && !covered; i++) {
+            MBR e = entryMbr(n, i);
+            covered = x >= e.xmin && x <= e.xmax && y >= e.ymin && y <= e.ymax;
+        }
+        uncovered += !covered;
+    }
+    return (double)uncovered / QUALITY_SAMPLES;
+}
+
+static void countVisits(const Node *n, Rect q, int depth, double *visits)
+{
+    if (!isOverlap_inline(&n->mbr, q)) return;
+    visits[depth] += 1;
+    if (n->isLeaf) return;
+    for (int i = 0; i < n->count; i++) countVisits(n->children[i], q, depth + 1, visits);
+}
+
+static void *quality_worker(void *arg)
+{
+    QualityArgs *a = (QualityArgs *)arg;
+    LevelQuality *acc = a->acc;
+    for (int l = 0; l < a->height; l++) {
+        int n = a->levelSize[l];
+        int lo = (int)((long long)n * a->thread / a->numThreads);
+        int hi = (int)((long long)n * (a->thread + 1) / a->numThreads);
+        for (int i = lo; i < hi; i++) {
+            const Node *node = a->levels[l][i];
+            MBR m = node->mbr;
+            double w = (double)m.xmax - m.xmin, h = (double)m.ymax - m.ymin;
+            acc[l].area += w * h;
+            acc[l].sumWidth += w;
+            acc[l].sumHeight += h;
+            acc[l].margin += 2.0 * (w + h);
+            acc[l].entries += node->count;
+            acc[l].capacity += node->isLeaf ? BUNDLEFACTOR : FANOUT;
+            acc[l].deadSpace += uncoveredShare(node, (unsigned)(l * 7919 + i)) * w * h;
+            if (!node->isLeaf) {
+                for (int c = 0; c < node->count; c++)
+                    for (int d = c + 1; d < node->count; d++)
+                        acc[l + 1].overlap += interArea(node->children[c]->mbr, node->children[d]->mbr);
+            }
+        }
+    }
+    double *visits = (double *)calloc((size_t)a->height, sizeof(double));
+    if (!visits) {
+        perror("Unable to allocate visit counters");
+        exit(EXIT_FAILURE);
+    }
+    for (int q = a->thread; q < a->numQuery; q += a->numThreads)
+        countVisits(a->levels[0][0], a->queries[q], 0, visits);
+    for (int l = 0; l < a->height; l++) acc[l].measured = visits[l];
+    free(visits);
+    return NULL;
+}
+
+// Statistics per level of `root`. queries (may be NULL) supply the window
+// size distribution for the predicted and measured node accesses; at most
+// QUALITY_MAX_QUERIES of them, evenly spaced, are used.
+TreeQuality *analyzeRTree(Node *root, const Rect *queries, int numQuery, int numThreads)
+{
+    TreeQuality *tq = (TreeQuality *)calloc(1, sizeof(TreeQuality));
+    if (!tq) {
+        perror("Unable to allocate tree quality");
+        exit(EXIT_FAILURE);
+    }
+    if (!root) return tq;
+    if (numThreads < 1) numThreads = 1;
+
+    // Nodes of each level in BFS order; leaves end their branch
+    int height = 1, capLevels = 8;
+    Node ***levels = (Node ***)malloc((size_t)capLevels * sizeof(Node **));
+    int *levelSize = (int *)malloc((size_t)capLevels * sizeof(int));
+    if (!levels || !levelSize) {
+        perror("Unable to allocate tree levels");
+        exit(EXIT_FAILURE);
+    }
+    levels[0] = (Node **)malloc(sizeof(Node *));
+    levels[0][0] = root;
+    levelSize[0] = 1;
+    for (;;) {
+        int n = 0;
+        for (int i = 0; i < levelSize[height - 1]; i++)
+            if (!levels[height - 1][i]->isLeaf) n += levels[height - 1][i]->count;
+        if (n == 0) break;
+        if (height == capLevels) {
+            capLevels *= 2;
+            levels = (Node ***)realloc(levels, (size_t)capLevels * sizeof(Node **));
+            levelSize = (int *)realloc(levelSize, (size_t)capLevels * sizeof(int));
+            if (!levels || !levelSize) {
+                perror("Unable to grow tree levels");
+                exit(EXIT_FAILURE);
+            }
+        }
+        levels[height] = (Node **)malloc((size_t)n * sizeof(Node *));
+        int k = 0;
+        for (int i = 0; i < levelSize[height - 1]; i++) {
+            const Node *p = levels[height - 1][i];
+            if (p->isLeaf) continue;
+            for (int c = 0; c < p->count; c++) levels[height][k++] = p->children[c];
+        }
+        levelSize[height++] = n;
+    }
+
+    // Spread the sample queries evenly over the input
+    int sample = queries && numQuery > 0 ? (numQuery < QUALITY_MAX_QUERIES ? numQuery : QUALITY_MAX_QUERIES) : 0;
+    Rect *picked = (Rect *)malloc((size_t)(sample > 0 ? sample : 1) * sizeof(Rect));
+    for (int i = 0; i < sample; i++) picked[i] = queries[(long long)i * numQuery / sample];
+
+    pthread_t threads[numThreads];
+    QualityArgs *args = (QualityArgs *)malloc((size_t)numThreads * sizeof(QualityArgs));
+    for (int t = 0; t < numThreads; t++) {
+        args[t] = (QualityArgs){levels, levelSize, height, picked, sample, numThreads, t,
+                                (LevelQuality *)calloc((size_t)height, sizeof(LevelQuality))};
+        pthread_create(&threads[t], NULL, quality_worker, &args[t]);
+    }
+    tq->height = height;
+    tq->levels = (LevelQuality *)calloc((size_t)height, sizeof(LevelQuality));
+    for (int t = 0; t < numThreads; t++) {
+        pthread_join(threads[t], NULL);
+        for (int l = 0; l < height; l++) {
+            LevelQuality *d = &tq->levels[l], *s = &args[t].acc[l];
+            d->area += s->area;
+            d->overlap += s->overlap;
+            d->deadSpace += s->deadSpace;
+            d->margin += s->margin;
+            d->sumWidth += s->sumWidth;
+            d->sumHeight += s->sumHeight;
+            d->entries += s->entries;
+            d->capacity += s->capacity;
+            d->measured += s->measured;
+        }
+        free(args[t].acc);
+    }
+    free(args);
+
+    // Query size moments and the model
+    double ex = 0, ey = 0, exy = 0;
+    for (int i = 0; i < sample; i++) {
+        double qx = (double)picked[i].xmax - picked[i].xmin, qy = (double)picked[i].ymax - picked[i].ymin;
+        ex += qx;
+        ey += qy;
+        exy += qx * qy;
+    }
+    if (sample > 0) {
+        ex /= sample;
+        ey /= sample;
+        exy /= sample;
+    }
+    tq->space = root->mbr;
+    tq->numQuery = sample;
+    double A = rectArea(root->mbr);
+    for (int l = 0; l < height; l++) {
+        LevelQuality *lq = &tq->levels[l];
+        lq->level = l;
+        lq->nodes = levelSize[l];
+        lq->fill = lq->capacity > 0 ? (double)lq->entries / (double)lq->capacity : 0.0;
+        lq->deadSpace = lq->area > 0 ? lq->deadSpace / lq->area : 0.0;
+        if (sample > 0) {
+            lq->measured /= sample;
+            lq->predicted = A > 0 ? (lq->area + ey * lq->sumWidth + ex * lq->sumHeight + levelSize[l] * exy) / A : 0.0;
+            tq->predictedTotal += lq->predicted;
+            tq->measuredTotal += lq->measured;
+        }
+    }
+    for (int l = 0; l < height; l++) free(levels[l]);
+    free(levels);
+    free(levelSize);
+    free(picked);
+    return tq;
+}
+
+void freeTreeQuality(TreeQuality *tq)
+{
+    if (!tq) return;
+    free(tq->levels);
+    free(tq);
+}
+
+// One JSON object for the tree; `label` names the loader or configuration.
+void writeTreeQualityJson(FILE *f, const char *label, const TreeQuality *tq)
+{
+    fprintf(f, "{\"label\": \"%s\", \"height\": %d, \"leaf_capacity\": %d, \"fanout\": %d, "
+               "\"space\": [%d, %d, %d, %d], \"queries\": %d, "
+               "\"predicted_accesses\": %.4f, \"measured_accesses\": %.4f, \"levels\": [",
+            label, tq->height, BUNDLEFACTOR, FANOUT, tq->space.xmin, tq->space.ymin, tq->space.xmax,
+            tq->space.ymax, tq->numQuery, tq->predictedTotal, tq->measuredTotal);
+    for (int l = 0; l < tq->height; l++) {
+        const LevelQuality *lq = &tq->levels[l];
+        fprintf(f, "%s\n  {\"level\": %d, \"nodes\": %d, \"entries\": %lld, \"fill\": %.4f, "
+                   "\"area\": %.6g, \"overlap\": %.6g, \"dead_space\": %.4f, \"margin\": %.6g, "
+                   "\"predicted_accesses\": %.4f, \"measured_accesses\": %.4f}",
+                l ? "," : "", lq->level, lq->nodes, lq->entries, lq->fill, lq->area, lq->overlap,
+                lq->deadSpace, lq->margin, lq->predicted, lq->measured);
+    }
+    fprintf(f, "]}");
+}
+
+void printTreeQuality(const char *label, const TreeQuality *tq)
+{
+    printf("%s: height %d, predicted %.2f / measured %.2f node accesses per query\n", label, tq->height,
+           tq->predictedTotal, tq->measuredTotal);
+    printf("  %5s %8s %6s %12s %12s %6s %12s %10s %10s\n", "level", "nodes", "fill", "area", "overlap", "dead",
+           "margin", "predicted", "measured");
+    for (int l = 0; l < tq->height; l++) {
+        const LevelQuality *lq = &tq->levels[l];
+        printf("  %5d %8d %6.3f %12.4g %12.4g %6.3f %12.4g %10.2f %10.2f\n", lq->level, lq->nodes, lq->fill,
+               lq->area, lq->overlap, lq->deadSpace, lq->margin, lq->predicted, lq->measured);
+    }
+}
+
+// Two leaves spanning the whole int range under one root: their overlap is
+// wider than INT_MAX on both axes, so it must be computed in double.
+// Returns 1 if the leaf level reports the exact area.
+int qualityExtentCheck(void)
+{
+    Rect r[2] = {{-INT_MAX, -INT_MAX, INT_MAX, INT_MAX}, {-INT_MAX, -INT_MAX, INT_MAX, 0}};
+    Node *leaves[2] = {createLeaf_STR(r, 0, 0), createLeaf_STR(r, 1, 1)};
+    Node *root = group_nodes_STR(leaves, 2, FANOUT);
+    TreeQuality *tq = analyzeRTree(root, NULL, 0, 1);
+    double want = 2.0 * INT_MAX * INT_MAX;
+    int ok = tq->height == 2 && tq->levels[0].area == 4.0 * INT_MAX * INT_MAX && tq->levels[1].overlap == want;
+    freeTreeQuality(tq);
+    freeRTree(root);
+    return ok;
+}
+
+// Analyze the three bulk loaders on the same data and write all of them to
+// Log/tree_quality.json as one array.
+void treeQualityReport(Node *root, const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                       int numThreads)
+{
+    static const char *labels[] = {"createRTree_STR_2", "createRTree_STR", "createRTree"};
+    const char *path = "Log/tree_quality.json";
+    mkdir("Log", 0777);
+    FILE *f = fopen(path, "w");
+    if (!f) perror("Unable to open tree quality file");
+    else fprintf(f, "[");
+
+    Rect *copy = (Rect *)malloc((size_t)numRects * sizeof(Rect));
+    if (!copy) {
+        perror("Unable to allocate rect copy");
+        exit(EXIT_FAILURE);
+    }
+    printf("\n[Tree quality] %d threads, dead space from %d samples per node\n", numThreads, QUALITY_SAMPLES);
+    for (int k = 0; k < 3; k++) {
+        Node *tree = root;
+        if (k > 0) {
+            memcpy(copy, rects, (size_t)numRects * sizeof(Rect));
+            tree = k == 1 ? createRTree_STR(copy, 0, numRects - 1) : createRTree(copy, 0, numRects - 1);
+        }
+        double t0 = nowSeconds();
+        TreeQuality *tq = analyzeRTree(tree, queries, numQuery, numThreads);
+        double dt = nowSeconds() - t0;
+        printTreeQuality(labels[k], tq);
+        printf("  analyzed in %.3f s\n", dt);
+        if (f) {
+            if (k) fprintf(f, ",\n");
+            writeTreeQualityJson(f, labels[k], tq);
+        }
+        freeTreeQuality(tq);
+        if (k > 0) freeRTree(tree);
+    }
+    free(copy);
+    if (f) {
+        fprintf(f, "]\n");
+        fclose(f);
+        printf("📁 Tree quality saved to: %s\n", path);
+    }
+}
@@ -0,0 +1,205 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "rtree.h"
+
+// ---------------- Quantized (compressed) boxes ----------------
+//
+// A QuantTree is an optional filter layer over a FlatTree. Every child box is
+// stored as 4 small integers on a grid spanning its parent's frame, and every
+// leaf rectangle on a grid spanning its leaf's frame: 8 bits per coordinate
+// (4 bytes per box) or 16 bits (8 bytes per box) instead of 16 bytes. Only
+// the root frame is exact; the frame of any other node is its quantized box
+// widened back to whole coordinates on the parent's frame, so the filter
+// walks an 8-byte QuantNode copy of the topology and never reads the exact
+// node MBRs.
+//
+// Both boxes and queries are mapped to cells with the same monotone function
+//     cell(x) = clamp(floor((x - base) * L / extent), 0, L)
+// so a box that truly overlaps the query also overlaps it on the grid: the
+// filter never misses a hit. When the cell comparison is strict on both axes
+// the overlap is certain too; only boundary cells are rechecked against the
+// exact rects of the underlying FlatTree, which stay in their own cold array.
+
+static inline uint32_t quantCell(int x, int base, int64_t extent, uint32_t levels)
+{
+    if (x <= base) return 0;
+    int64_t d = (int64_t)x - base;
+    if (d >= extent) return levels;
+    return (uint32_t)((d * levels) / extent);
+}
+
+// Smallest integer box containing every box with cells c on frame f
+static inline MBR quantFrame(const MBR *f, const uint32_t c[4], uint32_t levels)
+{
+    int64_t ex = (int64_t)f->xmax - f->xmin;
+    int64_t ey = (int64_t)f->ymax - f->ymin;
+    int64_t x1 = f->xmin + (int64_t)(c[2] + 1) * ex / levels, y1 = f->ymin + (int64_t)(c[3] + 1) * ey / levels;
+    MBR m = {(int)(f->xmin + (int64_t)c[0] * ex / levels), (int)(f->ymin + (int64_t)c[1] * ey / levels),
+             (int)(x1 < f->xmax ? x1 : f->xmax), (int)(y1 < f->ymax ? y1 : f->ymax)};
+    return m;
+}
+
+static inline void quantCells(const void *src, size_t i, int wide, uint32_t c[4])
+{
+    for (int k = 0; k < 4; k++)
+        c[k] = wide ? ((const uint16_t *)src)[4 * i + k] : ((const uint8_t *)src)[4 * i + k];
+}
+
+static inline void quantBox(void *dst, size_t i, int wide, const MBR *box, const MBR *frame)
+{
+    uint32_t levels = wide ? 0xFFFFu : 0xFFu;
+    int64_t ex = (int64_t)frame->xmax - frame->xmin;
+    int64_t ey = (int64_t)frame->ymax - frame->ymin;
+    uint32_t c[4] = {
+        quantCell(box->xmin, frame->xmin, ex, levels),
+        quantCell(box->ymin, frame->ymin, ey, levels),
+        quantCell(box->xmax, frame->xmin, ex, levels),
+        quantCell(box->ymax, frame->ymin, ey, levels)};
+    for (int k = 0; k < 4; k++) {
+        if (wide) ((uint16_t *)dst)[4 * i + k] = (uint16_t)c[k];
+        else      ((uint8_t *)dst)[4 * i + k] = (uint8_t)c[k];
+    }
+}
+
+QuantTree *createQuantTree(const FlatTree *flat, int bits)
+{
+    if (!flat || flat->numNodes == 0) return NULL;
+    if (bits != 8 && bits != 16) {
+        fprintf(stderr, "Quantized boxes support 8 or 16 bits, not %d\n", bits);
+        return NULL;
+    }
+
+    QuantTree *qt = (QuantTree *)calloc(1, sizeof(QuantTree));
+    if (!qt) {
+        perror("Unable to allocate quantized tree");
+        exit(EXIT_FAILURE);
+    }
+    int wide = bits == 16;
+    uint32_t levels = wide ? 0xFFFFu : 0xFFu;
+    size_t box = (size_t)(wide ? 8 : 4);
+    qt->flat = flat;
+    qt->bits = bits;
+    qt->rootFrame = flat->nodes[0].mbr;
+    qt->nodes = (QuantNode *)malloc((size_t)flat->numNodes * sizeof(QuantNode));
+    qt->nodeBoxes = malloc((size_t)flat->numNodes * box);
+    qt->rectBoxes = malloc((size_t)flat->numRects * box + 1);
+    MBR *frames = (MBR *)malloc((size_t)flat->numNodes * sizeof(MBR));
+    if (!qt->nodes || !qt->nodeBoxes || !qt->rectBoxes || !frames) {
+        perror("Unable to allocate quantized boxes");
+        exit(EXIT_FAILURE);
+    }
+
+    // Parents come before their children in both layouts, so each node's
+    // frame is known when its children are quantized on it
+    frames[0] = qt->rootFrame;
+    quantBox(qt->nodeBoxes, 0, wide, &flat->nodes[0].mbr, &frames[0]);
+    for (uint32_t p = 0; p < flat->numNodes; p++) {
+        const FlatNode *n = &flat->nodes[p];
+        qt->nodes[p] = (QuantNode){n->first, n->count, n->isLeaf};
+        if (n->isLeaf) {
+            for (uint32_t i = 0; i < n->count; i++)
+                quantBox(qt->rectBoxes, n->first + i, wide,
+                         (const MBR *)&flat->rects[n->first + i], &frames[p]);
+        } else {
+            for (uint32_t c = n->first; c < n->first + n->count; c++) {
+                uint32_t cells[4];
+                quantBox(qt->nodeBoxes, c, wide, &flat->nodes[c].mbr, &frames[p]);
+                quantCells(qt->nodeBoxes, c, wide, cells);
+                frames[c] = quantFrame(&frames[p], cells, levels);
+            }
+        }
+    }
+    free(frames);
+    return qt;
+}
+
+// One kernel for both widths; `wide` is a constant at each call site so the
+// compiler emits two specialized loops.
+static inline __attribute__((always_inline))
+int quantCount(const QuantTree *qt, Rect q, const int wide)
+{
+    const FlatTree *t = qt->flat;
+    const uint32_t levels = wide ? 0xFFFFu : 0xFFu;
+    const uint8_t *nb8 = (const uint8_t *)qt->nodeBoxes;
+    const uint16_t *nb16 = (const uint16_t *)qt->nodeBoxes;
+    const uint8_t *rb8 = (const uint8_t *)qt->rectBoxes;
+    const uint16_t *rb16 = (const uint16_t *)qt->rectBoxes;
+
+    if (!isOverlap_inline(&qt->rootFrame, q)) return 0;
+
+    struct { uint32_t node; MBR frame; } stack[2048];
+    int top = 0;
+    int count = 0;
+    stack[top].node = 0;
+    stack[top++].frame = qt->rootFrame;
+
+    while (top) {
+        top--;
+        const QuantNode *n = &qt->nodes[stack[top].node];
+        const MBR frame = stack[top].frame;
+        const MBR *m = &frame;
+        int64_t ex = (int64_t)m->xmax - m->xmin;
+        int64_t ey = (int64_t)m->ymax - m->ymin;
+        uint32_t qx0 = quantCell(q.xmin, m->xmin, ex, levels);
+        uint32_t qy0 = quantCell(q.ymin, m->ymin, ey, levels);
+        uint32_t qx1 = quantCell(q.xmax, m->xmin, ex, levels);
+        uint32_t qy1 = quantCell(q.ymax, m->ymin, ey, levels);
+
+        if (n->isLeaf) {
+            for (uint32_t i = n->first; i < n->first + n->count; i++) {
+                uint32_t bx0, by0, bx1, by1;
+                if (wide) { bx0 = rb16[4*i]; by0 = rb16[4*i+1]; bx1 = rb16[4*i+2]; by1 = rb16[4*i+3]; }
+                else      { bx0 = rb8[4*i];  by0 = rb8[4*i+1];  bx1 = rb8[4*i+2];  by1 = rb8[4*i+3]; }
+                if (bx1 < qx0 || bx0 > qx1 || by1 < qy0 || by0 > qy1)
+                    continue;
+                if (bx1 > qx0 && bx0 < qx1 && by1 > qy0 && by0 < qy1)
+                    count++;                                   // certain hit
+                else if (isOverlap_inline((const MBR *)&t->rects[i], q))
+                    count++;                                   // boundary cell: exact recheck
+            }
+            continue;
+        }
+
+        for (uint32_t c = n->first; c < n->first + n->count; c++) {
+            uint32_t bx0, by0, bx1, by1;
+            if (wide) { bx0 = nb16[4*c]; by0 = nb16[4*c+1]; bx1 = nb16[4*c+2]; by1 = nb16[4*c+3]; }
+            else      { bx0 = nb8[4*c];  by0 = nb8[4*c+1];  bx1 = nb8[4*c+2];  by1 = nb8[4*c+3]; }
+            if (bx1 < qx0 || bx0 > qx1 || by1 < qy0 || by0 > qy1)
+                continue;
+            if (top < (int)(sizeof(stack) / sizeof(stack[0]))) {
+                uint32_t cells[4] = {bx0, by0, bx1, by1};
+                stack[top].node = c;
+                stack[top++].frame = quantFrame(m, cells, levels);
+            } else
+                count += searchFlatTree_from(t, c, q);
+        }
+    }
+    return count;
+}
+
+int searchQuantTree(const QuantTree *qt, Rect queryRect)
+{
+    if (!qt) return 0;
+    return qt->bits == 16 ? quantCount(qt, queryRect, 1) : quantCount(qt, queryRect, 0);
+}
+
+// Bytes touched by the filter on every query (quantized boxes plus the
+// QuantNode topology); the exact rects are only read for boundary candidates.
+size_t quantTreeHotBytes(const QuantTree *qt)
+{
+    if (!qt) return 0;
+    size_t box = (size_t)(qt->bits == 16 ? 8 : 4);
+    return sizeof(QuantTree) +
+           (size_t)qt->flat->numNodes * (sizeof(QuantNode) + box) +
+           (size_t)qt->flat->numRects * box;
+}
+
+void freeQuantTree(QuantTree *qt)
+{
+    if (!qt) return;
+    free(qt->nodes);
+    free(qt->nodeBoxes);
+    free(qt->rectBoxes);
+    free(qt);
+}
@@ -25,13 +25,16 @@ typedef struct
     Node *root;
     int numQuery;
     int chunk_size;
-    char pad[20]; // prevent false sharing
+    int cpu;      // CPU to pin to, -1 for none
+    char pad[16]; // prevent false sharing
 } ThreadArgs __attribute__((aligned(64)));
 
 // Worker function with dynamic scheduling
 void *thread_worker_dynamic(void *arg)
 {
     ThreadArgs *args = (ThreadArgs *)arg;
+    if (args->cpu >= 0)
+        pinThreadToCpu(args->cpu);
 
     while (1)
     {
@@ -55,7 +58,9 @@ void *thread_worker_dynamic(void *arg)
     return NULL;
 }
 
- void run_thread_pool_query_dynamic(Rect *query_rects, int *results, Node *root, int numQuery, int numThreads, int chunk_size)
+// Thread t is pinned to cpus[t] when cpus is given (see placeThreads)
+void run_thread_pool_query_pinned(Rect *query_rects, int *results, Node *root, int numQuery, int numThreads,
+                                  int chunk_size, const int *cpus)
 {
     pthread_t threads[numThreads];
     ThreadArgs *args = aligned_alloc(64, numThreads * sizeof(ThreadArgs));
@@ -77,7 +82,8 @@ void *thread_worker_dynamic(void *arg)
             .results = results,
             .root = root,
             .numQuery = numQuery,
-            .chunk_size = chunk_size};
+            .chunk_size = chunk_size,
+            .cpu = cpus ? cpus[t] : -1};
         pthread_create(&threads[t], NULL, thread_worker_dynamic, &args[t]);
     }
 
@@ -90,8 +96,62 @@ void *thread_worker_dynamic(void *arg)
     free(args); // Free dynamically allocated thread arguments here
 }
 
-int main()
+void run_thread_pool_query_dynamic(Rect *query_rects, int *results, Node *root, int numQuery, int numThreads, int chunk_size)
 {
+    run_thread_pool_query_pinned(query_rects, results, root, numQuery, numThreads, chunk_size, NULL);
+}
+
+// Route each query to the SIMD scan or the tree as the planner decides; the
+// scan share runs as one batched multi-threaded pass over rects.
+int run_planned_queries(const QueryPlanner *planner, Rect *query_rects, int *results, Node *root,
+                        const Rect *rects, int numRects, int numQuery, int numThreads, int chunk_size)
+{
+    unsigned char *useScan = malloc(numQuery);
+    int numScan = planQueries(planner, query_rects, numQuery, useScan);
+    int numIndex = numQuery - numScan;
+
+    Rect *scanQ = malloc((numScan + 1) * sizeof(Rect));
+    Rect *indexQ = malloc((numIndex + 1) * sizeof(Rect));
+    int *scanR = malloc((numScan + 1) * sizeof(int));
+    int *indexR = malloc((numIndex + 1) * sizeof(int));
+    int s = 0, x = 0;
+    for (int i = 0; i < numQuery; i++)
+    {
+        if (useScan[i])
+            scanQ[s++] = query_rects[i];
+        else
+            indexQ[x++] = query_rects[i];
+    }
+
+    if (numScan > 0)
+        scanCountBatch(rects, numRects, scanQ, numScan, scanR, numThreads);
+    if (numIndex > 0)
+        run_thread_pool_query_dynamic(indexQ, indexR, root, numIndex, numThreads, chunk_size);
+
+    s = 0;
+    x = 0;
+    for (int i = 0; i < numQuery; i++)
+    {
+        results[i] = useScan[i] ? scanR[s++] : indexR[x++];
+    }
+
+    free(useScan);
+    free(scanQ);
+    free(indexQ);
+    free(scanR);
+    free(indexR);
+    return numScan;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "scaling") == 0)
+        return scalingMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+        return benchMain(argc, argv);
+    if (argc > 1)
+        return queryServerMain(argc, argv);
+
     struct timespec t0, t1, t2, t3, t4,t5;
     double rtree_construction_time;
     int numRects, numQuery, dataset_option = 0;
@@ -111,7 +171,9 @@ int main()
     }
 
     printf("Read %d rects successfully.\n", numRects);
-    printf("Total dataset size: %.2f MB\n", (numRects * sizeof(Rect)) / (1024.0 * 1024.0));
+    printf("Dataset array: %.2f MB (%d x %zu B, the tree keeps its own copy, see [Memory])\n",
+           (numRects * sizeof(Rect)) / (1024.0 * 1024.0), numRects, sizeof(Rect));
+    memoryPhase("load dataset");
     // R-tree construction (sequential)
     clock_gettime(CLOCK_MONOTONIC, &t0);
     //Node *root = createRTree(rects, 0, numRects - 1);
@@ -121,8 +183,10 @@ int main()
     rtree_construction_time = sec_since(t0,t1);
     printf("\nR-tree construction time = %.2f s\n", rtree_construction_time);
     printRTreeStats(root);
+    memoryPhase("build tree");
     // Load queries
-    Rect *query_rects = selectQueryDataset(&numQuery, dataset_option);
+    const char *query_path = selectQueryPath(dataset_option);
+    Rect *query_rects = readRectsFromFile(query_path, &numQuery);
 
     if (!query_rects)
     {
@@ -131,6 +195,24 @@ int main()
     }
     Zsorting(query_rects, numQuery);
     printf("Read %d query rects. Query data size: %.2f MB\n", numQuery, (numQuery * sizeof(Rect)) / (1024.0 * 1024.0));
+    memoryPhase("load + Z-sort queries");
+
+    // === Exact bytes per tree level and component, allocator overhead ===
+    TreeFootprint footprint;
+    measureTreeFootprint(root, &footprint);
+    printTreeFootprint(&footprint, numRects, numQuery);
+
+    // === Per-level quality of the bulk loaders, with modelled node accesses ===
+    if (qualityExtentCheck())
+        printf("✅ Tree quality areas are exact for extents near INT_MAX.\n");
+    else
+        printf("❌ Tree quality areas overflow for extents near INT_MAX.\n");
+    // Opt-in: it bulk loads two more trees, which takes minutes on Lakes
+    const char *quality = getenv("RTREE_QUALITY");
+    if (quality && *quality && strcmp(quality, "0") != 0) {
+        treeQualityReport(root, rects, numRects, query_rects, numQuery, (int)sysconf(_SC_NPROCESSORS_ONLN));
+        memoryPhase("quality report");
+    }
 
     // Allocate result array
     int *cpu_overlap_count = calloc(numQuery, sizeof(int));
@@ -151,13 +233,85 @@ int main()
     double seq_time = sec_since(t2,t3);
     printf("\n[Sequential] Overlaps = %lld, Time = %.2f s\n", found_seq, seq_time);
 
+    // === Interleaved (AMAC) Query Search, single thread ===
+    memset(cpu_overlap_count, 0, numQuery * sizeof(int));
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    searchRTree_AMAC(root, query_rects, cpu_overlap_count, numQuery, AMAC_GROUP);
+    clock_gettime(CLOCK_MONOTONIC, &t3);
+    long long found_amac = 0;
+    for (int i = 0; i < numQuery; i++)
+    {
+        found_amac += (long long)cpu_overlap_count[i];
+    }
+    double amac_time = sec_since(t2,t3);
+    printf("[Interleaved] Overlaps = %lld, Time = %.2f s (Group: %d, %.2fx vs sequential)\n",
+           found_amac, amac_time, AMAC_GROUP, seq_time / amac_time);
+    if (found_amac != found_seq)
+    {
+        printf("❌ Mismatch between sequential and interleaved results!\n");
+    }
+
+    // === Sorted leaves vs full leaf scan, single thread ===
+    leafScanBenchmark(root, query_rects, numQuery, found_seq);
+    memoryPhase("sequential queries");
+
+    // === Linearized layouts (BFS / vEB), single thread ===
+    printf("\n[Pointer tree] Footprint = %.2f MB\n", rtreeBytes(root) / (1024.0 * 1024.0));
+    const int flat_orders[] = {FLAT_BFS, FLAT_VEB};
+    const char *flat_names[] = {"Flat BFS", "Flat vEB"};
+    for (int o = 0; o < 2; o++)
+    {
+        FlatTree *flat = createFlatTree(root, flat_orders[o]);
+        long long found_flat = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        for (int i = 0; i < numQuery; i++)
+        {
+            found_flat += (long long)searchFlatTree(flat, query_rects[i]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t3);
+        double flat_time = sec_since(t2,t3);
+        printf("[%s]     Overlaps = %lld, Time = %.2f s (%.2fx vs sequential), Footprint = %.2f MB\n",
+               flat_names[o], found_flat, flat_time, seq_time / flat_time, flatTreeBytes(flat) / (1024.0 * 1024.0));
+        if (found_flat != found_seq)
+        {
+            printf("❌ Mismatch between sequential and %s results!\n", flat_names[o]);
+        }
+
+        // Quantized boxes on top of the BFS layout
+        for (int bits = 8; o == 0 && bits <= 16; bits += 8)
+        {
+            QuantTree *quant = createQuantTree(flat, bits);
+            long long found_quant = 0;
+            clock_gettime(CLOCK_MONOTONIC, &t2);
+            for (int i = 0; i < numQuery; i++)
+            {
+                found_quant += (long long)searchQuantTree(quant, query_rects[i]);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t3);
+            double quant_time = sec_since(t2,t3);
+            printf("[Quant %2d-bit] Overlaps = %lld, Time = %.2f s (%.2fx vs sequential), Filter = %.2f MB\n",
+                   bits, found_quant, quant_time, seq_time / quant_time, quantTreeHotBytes(quant) / (1024.0 * 1024.0));
+            if (found_quant != found_seq)
+            {
+                printf("❌ Mismatch between sequential and quantized results!\n");
+            }
+            freeQuantTree(quant);
+        }
+        freeFlatTree(flat);
+    }
+    printf("\n");
+    memoryPhase("linearized layouts");
+
     // === Parallel Query Search (Thread Pool) ===
     int numThreads = sysconf(_SC_NPROCESSORS_ONLN); // returns 12
     //int numThreads = 8;
+    CpuTopology *cpuTopo = readCpuTopology();
+    int pinPolicy;
+    int *pinCpus = pinPlacementFromEnv(cpuTopo, numThreads, &pinPolicy); // RTREE_PIN=compact|scatter|cores|0,2,4-7
     memset(cpu_overlap_count, 0, numQuery * sizeof(int));
     clock_gettime(CLOCK_MONOTONIC, &t4);
 
-    run_thread_pool_query_dynamic(query_rects, cpu_overlap_count, root, numQuery, numThreads, 10000);
+    run_thread_pool_query_pinned(query_rects, cpu_overlap_count, root, numQuery, numThreads, 10000, pinCpus);
 
     long long found_par = 0;
     for (int i = 0; i < numQuery; i++)
@@ -168,7 +322,10 @@ int main()
     double par_time = sec_since(t4,t5);
     double speedup = seq_time / par_time;
 
-    printf("[Parallel]   Overlaps = %lld, Time = %.2f s (Threads: %d)\n", found_par, par_time, numThreads);
+    printf("[Parallel]   Overlaps = %lld, Time = %.2f s (Threads: %d, pinning: %s)\n", found_par, par_time,
+           numThreads, pinPolicyName(pinPolicy));
+    free(pinCpus);
+    freeCpuTopology(cpuTopo);
     printf("⚡ Speedup = %.2fx\n", speedup);
 
     //  Result check
@@ -180,6 +337,88 @@ int main()
     {
         printf("✅ Results match between sequential and parallel runs.\n");
     }
+    memoryPhase("parallel queries");
+    // === Planned Query Search (scan vs index per query) ===
+    QueryPlanner *planner = createQueryPlanner(root, rects, numRects);
+    memset(cpu_overlap_count, 0, numQuery * sizeof(int));
+    clock_gettime(CLOCK_MONOTONIC, &t4);
+    int numScan = run_planned_queries(planner, query_rects, cpu_overlap_count, root, rects, numRects, numQuery, numThreads, 10000);
+    clock_gettime(CLOCK_MONOTONIC, &t5);
+    long long found_plan = 0;
+    for (int i = 0; i < numQuery; i++)
+    {
+        found_plan += (long long)cpu_overlap_count[i];
+    }
+    double plan_time = sec_since(t4,t5);
+    printf("\n[Planned]    Overlaps = %lld, Time = %.2f s (Threads: %d, %d of %d queries scanned, %.2fx vs parallel)\n",
+           found_plan, plan_time, numThreads, numScan, numQuery, par_time / plan_time);
+    if (found_plan != found_seq)
+    {
+        printf("❌ Mismatch between sequential and planned results!\n");
+    }
+    freeQueryPlanner(planner);
+    plannerCrossover(root, rects, numRects);
+
+    // === Approximate counts against the exact per-query results ===
+    ApproxEstimator *estimator = createApproxEstimator(root);
+    approxBenchmark(estimator, root, query_rects, numQuery, cpu_overlap_count, seq_time);
+    freeApproxEstimator(estimator);
+
+    // === Panning windows answered from the previous result ===
+    viewportBenchmark(root, query_rects, numQuery, cpu_overlap_count);
+    memoryPhase("planner/approx/viewport");
+
+    // === Updates under concurrent readers (on a private copy of the tree) ===
+    snapshotBenchmark(root, rects, numRects, query_rects, numQuery, numThreads, found_seq);
+
+    // === Buffered ingestion with background merges ===
+    lsmBenchmark(rects, numRects, query_rects, numQuery, numThreads, found_seq);
+
+    // === Batch updates re-packing only the touched subtrees ===
+    batchUpdateBenchmark(root, rects, numRects, query_rects, numQuery);
+    memoryPhase("updates");
+
+    // === Out-of-core tree read through a shrinking buffer pool ===
+    pagedTreeBenchmark(rects, numRects, query_rects, numQuery, found_seq);
+    memoryPhase("paged tree");
+
+    // === Pipelined startup against the sequential one ===
+    streamLoadBenchmark(dataDatasetPath(dataset_option), query_path, numThreads);
+    memoryPhase("pipelined startup");
+
+    // === NUMA placement: shared tree, per-node replicas, interleaved pages ===
+    numaBenchmark(root, query_rects, numQuery, numThreads, found_seq);
+    memoryPhase("NUMA placement");
+
+    // === Asynchronous submission with results consumed per chunk ===
+    asyncQueryBenchmark(root, query_rects, numQuery, numThreads, found_seq);
+
+    // === Same queries through the batching query server ===
+    queryServerBenchmark(root, rects, numRects, query_rects, numQuery, numThreads, found_seq);
+
+    // === Several named indexes on one shared pool ===
+    catalogBenchmark(root, numRects, query_rects, numQuery, dataset_option, numThreads, found_seq);
+    memoryPhase("pool/server/catalog");
+
+    // === R-tree, uniform grid and quadtree behind one interface ===
+    engineBenchmark(rects, numRects, query_rects, numQuery, numThreads, found_seq);
+
+    // === Result cache in front of the R-tree engine ===
+    resultCacheBenchmark(rects, numRects, query_rects, numQuery, numThreads);
+
+    // === Kernels specialized by coordinate type and capacity ===
+    kernelBenchmark(rects, numRects, query_rects, numQuery, found_seq, seq_time);
+    memoryPhase("engines/cache/kernels");
+
+    // === Exact polygon refinement after the MBR filter ===
+    polygonBenchmark(root, rects, numRects, query_rects, numQuery, found_seq);
+    memoryPhase("filter and refine");
+
+    // === Spatial shards in separate processes behind a coordinator ===
+    shardBenchmark(rects, numRects, query_rects, numQuery, found_seq);
+    memoryPhase("shards");
+    printMemoryPhases();
+
     // === Write timing results to file ===
     writeTimingLog(numRects, numQuery, numThreads, seq_time, par_time);
 
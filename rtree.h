@@ -3,9 +3,22 @@
 
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
 
 #define BUNDLEFACTOR 1024   // max rectangles per leaf
 #define FANOUT 128         // max children per internal node
+#define AMAC_GROUP 8       // queries kept in flight per thread by searchRTree_AMAC
+#ifndef KERNEL_LEAF
+#define KERNEL_LEAF 64      // leaf capacity of the default kernel instances (kernels.c)
+#endif
+#ifndef KERNEL_FANOUT
+#define KERNEL_FANOUT 16    // fanout of the default kernel instances
+#endif
+#define LEAF_PAGE 64        // rects per mini-page of a sorted leaf
+#define LEAF_SORTED 2       // isLeaf of a leaf sorted by ymin, mini-page MBRs after its rects
 
 typedef struct {
     int xmin, ymin, xmax, ymax;
@@ -20,6 +33,23 @@ typedef struct Node {
     };
     MBR mbr;
 } Node;
+
+// Monotonic wall clock in seconds, for the benchmarks
+static inline double nowSeconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Header copy of isOverlap so modules outside rtreefunction.c get it inlined
+// into their hot loops instead of paying a call per rectangle.
+static inline bool isOverlap_inline(const MBR *mbr, Rect r)
+{
+    return !(r.xmax < mbr->xmin || r.xmin > mbr->xmax ||
+             r.ymax < mbr->ymin || r.ymin > mbr->ymax);
+}
+
 typedef struct RTreeStats
 {
     int totalNodes;
@@ -27,6 +57,297 @@ typedef struct RTreeStats
     int internalNodes;
     int maxDepth;
 } RTreeStats;
+// Pointer-free node of a linearized tree (flattree.c). Children of an
+// internal node are contiguous, `first` is the index of the first child
+// node, or of the first rect in FlatTree.rects for a leaf.
+typedef struct {
+    MBR mbr;
+    uint32_t first;
+    uint16_t count;
+    uint16_t isLeaf;
+} FlatNode;
+
+enum { FLAT_BFS = 0, FLAT_VEB = 1 };
+
+typedef struct FlatTree {
+    FlatNode *nodes;      // nodes[0] is the root
+    Rect *rects;          // all leaf rectangles, in leaf order
+    uint32_t numNodes;
+    uint32_t numRects;
+    uint32_t height;
+    int order;            // FLAT_BFS or FLAT_VEB
+    void *mapping;        // non-NULL when loaded with loadFlatTree
+    size_t mappingSize;
+} FlatTree;
+
+// Quantized filter layer over a FlatTree (quanttree.c). Box i is 4 cells of
+// `bits` (8 or 16) each, relative to the parent's frame (nodeBoxes) or to
+// the leaf's frame (rectBoxes); flat->rects is kept for exact rechecks.
+typedef struct {
+    uint32_t first;
+    uint16_t count;
+    uint16_t isLeaf;
+} QuantNode;              // FlatNode topology without the exact MBR
+
+typedef struct QuantTree {
+    const FlatTree *flat;
+    int bits;
+    MBR rootFrame;        // the only exact box the filter reads
+    QuantNode *nodes;     // indexed like flat->nodes
+    void *nodeBoxes;      // numNodes boxes, indexed like flat->nodes
+    void *rectBoxes;      // numRects boxes, indexed like flat->rects
+} QuantTree;
+
+// Summary entry of the scan-vs-index planner (planner.c)
+typedef struct {
+    MBR mbr;
+    long long rects;      // rects below this node
+    int leaves;           // leaves below this node
+    double leafW, leafH;  // average leaf MBR extent
+} PlanEntry;
+
+typedef struct QueryPlanner {
+    PlanEntry *entries;
+    int numEntries;
+    int numRects;
+    double leafCost;      // seconds per rect tested inside a leaf
+    double scanCost;      // seconds per rect in scanCount
+} QueryPlanner;
+
+// Count summary of the tree used for approximate counts (estimate.c).
+// Leaves (first < 0) keep a small systematic sample of their rects.
+typedef struct {
+    MBR mbr;
+    int first;            // index of first child, -1 for a leaf
+    int count;            // number of children, or sample size for a leaf
+    long long rects;      // rects below this node
+    int sample;           // leaf: offset of its sample in ApproxEstimator.samples
+} ApproxNode;
+
+typedef struct ApproxEstimator {
+    ApproxNode *nodes;    // nodes[0] is the root
+    int numNodes;
+    Rect *samples;
+    int numSamples;
+} ApproxEstimator;
+
+typedef struct {
+    double estimate;
+    double low, high;               // model-based 95% interval, clipped to the bounds
+    long long lowerBound, upperBound; // guaranteed bounds
+    int exact;                      // 1 if the exact path answered
+} ApproxCount;
+
+// Continuous window queries (viewport.c): the last window and its count,
+// reused to answer the next window from the difference strips
+typedef struct {
+    Node *root;
+    Rect window;
+    int count;
+    int valid;                // 0 until the first window
+    double leafArea;          // mean leaf MBR area of the tree
+    long long queries;
+    long long incremental;    // windows answered from the previous one
+} ViewportSession;
+
+// Counters reported by rtreeBatchUpdate (batch.c)
+typedef struct {
+    int inserted;
+    int deleted;
+    int missing;              // deletes without an equal rect in the tree
+    int leavesRepacked;       // old leaves replaced by re-packed ones
+    long long rectsRepacked;  // rects that went through STR packing
+} BatchUpdateStats;
+
+// Result of the pipelined startup (streaming.c)
+typedef struct {
+    Node *root;
+    int numRects;
+    Rect *queries;        // Z-sorted
+    int numQuery;
+    double parseSeconds;  // parse and run sorting until the last bucket is sealed
+    double packSeconds;   // packing left after that, and the upper levels
+    double treeSeconds;   // start to finished tree
+    double querySeconds;  // query load + Z-sort, overlapped with the build
+    double totalSeconds;
+} StreamLoad;
+
+// NUMA nodes with CPUs, from sysfs (numa.c)
+typedef struct {
+    int numNodes;
+    int *nodeId;          // sysfs node number of each entry
+    int *cpuStart;        // CPUs of node n are cpus[cpuStart[n] .. cpuStart[n + 1])
+    int *cpus;
+} NumaTopology;
+
+// CPUs this process may run on, from sysfs (affinity.c). Entry i is CPU
+// cpu[i]; smt[i] is its rank among the SMT siblings of its core.
+typedef struct {
+    int numCpus;
+    int numCores;
+    int threadsPerCore;
+    int *cpu;
+    int *package;
+    int *core;
+    int *node;
+    int *smt;
+} CpuTopology;
+
+enum { PIN_NONE, PIN_COMPACT, PIN_SCATTER, PIN_CORES, PIN_LIST };
+
+// Bytes of one tree level by component (memory.c); usableBytes is the sum
+// of malloc_usable_size over its allocs allocations.
+#define MEM_MAX_LEVELS 32
+typedef struct {
+    long long nodes, entries, allocs;
+    size_t headerBytes;   // Node structs
+    size_t childBytes;    // children arrays
+    size_t rectBytes;     // leaf rects
+    size_t pageBytes;     // mini-page MBRs of sorted leaves
+    size_t usableBytes;
+} LevelFootprint;
+
+typedef struct {
+    int levels;
+    LevelFootprint level[MEM_MAX_LEVELS];  // root level first
+    LevelFootprint total;
+} TreeFootprint;
+
+// Flat tree over the MBRs with polygon geometry in columns (polygon.c).
+// Ring i is vertices start[i] .. start[i + 1] - 1 of xs / ys, closed, and
+// belongs to flat->rects[i], so a leaf's `first` indexes both.
+typedef struct {
+    FlatTree *flat;
+    uint32_t *start;
+    int32_t *xs, *ys;
+    uint32_t numPolygons, numVertices;
+} PolygonIndex;
+
+typedef struct {
+    long long candidates;  // MBR filter hits
+    long long contained;   // MBR inside the window, accepted without refining
+    long long refined;     // sent to the exact test
+    long long vertices;    // ring vertices read by the exact test
+    long long hits;
+} RefineStats;
+
+enum { NUMA_SHARED, NUMA_REPLICATE, NUMA_INTERLEAVE };
+
+// Query server wire format (server.c). A reply is followed by `returned`
+// Rects for QOP_WINDOW or `returned` uint32 rect ids for QOP_IDS; status 1
+// means the payload was truncated, 2 an unknown op.
+enum { QOP_COUNT = 1, QOP_WINDOW = 2, QOP_IDS = 3, QOP_SHUTDOWN = 4 };
+
+typedef struct {
+    uint32_t id;          // echoed in the reply
+    uint16_t op;
+    uint16_t flags;
+    Rect window;
+} QueryRequest;
+
+typedef struct {
+    uint32_t id;
+    uint16_t op;
+    uint16_t status;
+    uint32_t count;       // total hits
+    uint32_t returned;    // payload entries
+} QueryReply;
+
+typedef struct {
+    int fd;
+    int pos, len;
+    char buf[1 << 16];
+} SockReader;
+
+// Worker pool taking asynchronous query submissions (async.c). A completion
+// says results[first .. first + count) of submission `ticket` are final.
+typedef struct QueryPool QueryPool;
+
+typedef struct {
+    uint32_t ticket;
+    int first;
+    int count;
+    long long hits;       // sum of the chunk's results
+    long long ns;         // worker time spent on the chunk
+} QueryCompletion;
+
+typedef void (*QueryCallback)(const QueryCompletion *c, void *user);
+typedef int (*QuerySearchFn)(const void *index, Rect q);
+
+// Per-level tree statistics (quality.c); level 0 is the root. predicted and
+// measured are node accesses per query at that level.
+typedef struct {
+    int level;
+    int nodes;
+    long long entries;
+    long long capacity;
+    double fill;
+    double area;
+    double overlap;       // pairwise, among nodes with the same parent
+    double deadSpace;     // share of the area outside every entry
+    double margin;
+    double sumWidth, sumHeight;
+    double predicted;
+    double measured;
+} LevelQuality;
+
+typedef struct {
+    int height;
+    LevelQuality *levels;
+    MBR space;
+    int numQuery;         // queries behind predicted / measured
+    double predictedTotal;
+    double measuredTotal;
+} TreeQuality;
+
+// Common interface of the index engines (spatialindex.c, grid.c,
+// quadtree.c). report stores up to maxOut ids, positions in the rects given
+// to build, and returns the full hit count like count.
+typedef struct SpatialIndexOps {
+    const char *name;
+    void *(*build)(const Rect *rects, int n);
+    int (*count)(const void *index, Rect q);
+    int (*report)(const void *index, Rect q, uint32_t *ids, int maxOut);
+    size_t (*bytes)(const void *index);
+    void (*describe)(const void *index, char *buf, size_t len);
+    void (*destroy)(void *index);
+} SpatialIndexOps;
+
+typedef struct {
+    const SpatialIndexOps *ops;
+    void *impl;
+} SpatialIndex;
+
+extern const SpatialIndexOps rtreeIndexOps;
+extern const SpatialIndexOps gridIndexOps;
+extern const SpatialIndexOps quadtreeIndexOps;
+
+// Sharded cache of reported ids in front of a SpatialIndex (cache.c)
+typedef struct ResultCache ResultCache;
+
+// Named indexes sharing one QueryPool (catalog.c); a mixed batch tags each
+// window with the catalog index it goes to.
+typedef struct IndexCatalog IndexCatalog;
+
+typedef struct {
+    int index;
+    Rect window;
+} CatalogQuery;
+
+// Shards served by separate processes behind a coordinator (shard.c); the
+// sink gets each hit of a QOP_IDS query as a position in the input rects.
+typedef struct ShardSet ShardSet;
+typedef void (*ShardIdSink)(void *user, int query, int id);
+
+// Tree that can be updated under concurrent lock-free readers (snapshot.c)
+typedef struct RTreeHandle RTreeHandle;
+
+// Tree with write buffers merged in the background (lsm.c)
+typedef struct LsmTree LsmTree;
+
+// Disk-resident tree read through a buffer pool (pagedtree.c)
+typedef struct PagedTree PagedTree;
+
 typedef struct {
     int z_value;
     int index;
@@ -48,18 +369,218 @@ void initMBR(MBR *mbr);
 void updateMBRWithRect(MBR *mbr, Rect r);
 MBR unionJoin(MBR *mbr1, MBR *mbr2);
 Node *createLeaf(Rect *rectArr, int low, int high);
+Node *createLeaf_STR(Rect *rectArr, int low, int high);
 int compareByXCenter(const void *a, const void *b);
 int compareByYCenter(const void *a, const void *b);
+int compareRectLex(const void *a, const void *b);
+int subtractRects(Rect *rects, int n, Rect *remove, int nr, int *removed);
 Node *createRTree(Rect *rectArr, int low, int high);
 Node *createRTree_STR(Rect *rectArr, int low, int high);
 Node *createRTree_STR_2(Rect *rectArr, int low, int high);
+Node **packLeaves_STR(Rect *rectArr, int low, int high, int *outCount);
+Node **packLevel_STR(Node **nodes, int n, int cap, int *outCount);
+Node *group_nodes_STR(Node **nodes, int n, int cap);
 bool isOverlap(const MBR *mbr, Rect r);
 int searchRTree(Node *node, Rect queryRect, int q);
 void printRTreeStats(Node *root);
+void freeRTree(Node *node);
+Node *cloneRTree(const Node *node);
 void Zsorting(Rect rects[], int num_rects);
 void writeTimingLog(int numRects, int numQuery, int numThreads, double seq_time_ms, double par_time_ms);
 int searchRTree_iter(Node *root, Rect queryRect, int q);
+void searchRTree_AMAC(Node *root, const Rect *queries, int *results, int numQuery, int group);
+
+FlatTree *createFlatTree(Node *root, int order);
+int searchFlatTree(const FlatTree *t, Rect queryRect);
+int searchFlatTree_from(const FlatTree *t, uint32_t idx, Rect q);
+int searchFlatTree_collect(const FlatTree *t, Rect q, uint32_t *out, int maxOut);
+uint32_t *flatTreeRectIds(const FlatTree *t, const Rect *orig, int n);
+size_t flatTreeBytes(const FlatTree *t);
+size_t rtreeBytes(const Node *node);
+size_t leafAllocBytes(int count);
+size_t leafBytes(const Node *leaf);
+void sortLeaf(Node *leaf);
+int searchLeaf(const Node *leaf, Rect q);
+void leafScanBenchmark(Node *root, const Rect *queries, int numQuery, long long expected);
+ViewportSession *createViewportSession(Node *root);
+int viewportQuery(ViewportSession *s, Rect window);
+void resetViewportSession(ViewportSession *s, Node *root);
+void freeViewportSession(ViewportSession *s);
+void viewportBenchmark(Node *root, const Rect *queries, int numQuery, const int *exact);
+int saveFlatTree(const FlatTree *t, const char *path);
+FlatTree *loadFlatTree(const char *path);
+void freeFlatTree(FlatTree *t);
+QuantTree *createQuantTree(const FlatTree *flat, int bits);
+int searchQuantTree(const QuantTree *qt, Rect queryRect);
+size_t quantTreeHotBytes(const QuantTree *qt);
+void freeQuantTree(QuantTree *qt);
+int scanCount(const Rect *rects, int n, Rect q);
+void scanCountBatch(const Rect *rects, int n, const Rect *queries, int numQuery,
+                    int *results, int numThreads);
+QueryPlanner *createQueryPlanner(Node *root, const Rect *rects, int numRects);
+double plannerEstimateCandidates(const QueryPlanner *p, Rect q);
+int plannerChooseScan(const QueryPlanner *p, Rect q);
+int planQueries(const QueryPlanner *p, const Rect *queries, int numQuery, unsigned char *useScan);
+void freeQueryPlanner(QueryPlanner *p);
+void plannerCrossover(Node *root, const Rect *rects, int numRects);
+ApproxEstimator *createApproxEstimator(Node *root);
+ApproxCount approxCount(const ApproxEstimator *e, Node *root, Rect q, double targetRelErr);
+size_t approxEstimatorBytes(const ApproxEstimator *e);
+void freeApproxEstimator(ApproxEstimator *e);
+void approxBenchmark(const ApproxEstimator *e, Node *root, const Rect *queries, int numQuery,
+                     const int *exact, double exactTime);
+
+RTreeHandle *createRTreeHandle(Node *root);
+int snapshotRegisterReader(RTreeHandle *h);
+void snapshotUnregisterReader(RTreeHandle *h, int slot);
+Node *snapshotAcquire(RTreeHandle *h, int slot);
+void snapshotRelease(RTreeHandle *h, int slot);
+Node *snapshotRoot(RTreeHandle *h);
+void rtreeInsertCOW(RTreeHandle *h, Rect r);
+int rtreeDeleteCOW(RTreeHandle *h, Rect r);
+long long snapshotFreedNodes(RTreeHandle *h);
+int snapshotPendingNodes(RTreeHandle *h);
+void destroyRTreeHandle(RTreeHandle *h);
+void snapshotReplaceRoot(RTreeHandle *h, Node *newRoot);
+void snapshotBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries,
+                       int numQuery, int numThreads, long long expected);
+
+LsmTree *createLsmTree(Node *root);
+void lsmInsertBatch(LsmTree *t, const Rect *rects, int n);
+int lsmDelete(LsmTree *t, Rect r);
+int lsmRegisterReader(LsmTree *t);
+void lsmUnregisterReader(LsmTree *t, int slot);
+int lsmQuery(LsmTree *t, int slot, Rect q);
+void lsmFlush(LsmTree *t);
+void destroyLsmTree(LsmTree *t);
+Node *rtreeBatchUpdate(Node *root, Rect *inserts, int numInserts, Rect *deletes, int numDeletes,
+                       BatchUpdateStats *stats);
+int writePagedTree(const char *path, Rect *rects, int n);
+PagedTree *openPagedTree(const char *path, int poolPages);
+void searchPagedTreeBatch(PagedTree *t, const Rect *queries, int *results, int numQuery);
+uint32_t pagedTreePages(const PagedTree *t);
+void closePagedTree(PagedTree *t);
+void pagedTreeBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                        long long expected);
+void batchUpdateBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries, int numQuery);
+void lsmBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                  int numThreads, long long expected);
 
+const char *dataDatasetPath(int option);
+const char *selectQueryPath(int dataset_option);
 Rect *selectDataDataset(int *numRects, int option);
 Rect *selectQueryDataset(int *numQuery, int dataset_option);
+NumaTopology *readNumaTopology(void);
+void freeNumaTopology(NumaTopology *t);
+int pinThreadToNode(const NumaTopology *t, int node);
+Node **createNumaTrees(const NumaTopology *t, Node *root, int mode);
+void freeNumaTrees(const NumaTopology *t, Node **trees, int mode);
+void run_numa_queries(const NumaTopology *t, Node **trees, const Rect *queries, int *results,
+                      int numQuery, int numThreads, int chunk, long long *perNode);
+void numaBenchmark(Node *root, const Rect *queries, int numQuery, int numThreads, long long expected);
+CpuTopology *readCpuTopology(void);
+void freeCpuTopology(CpuTopology *t);
+int parsePinPolicy(const char *s);
+const char *pinPolicyName(int policy);
+int placeThreads(const CpuTopology *t, int policy, const char *list, int numThreads, int *out);
+int pinThreadToCpu(int cpu);
+int *pinPlacementFromEnv(const CpuTopology *t, int numThreads, int *policy);
+void run_thread_pool_query_pinned(Rect *query_rects, int *results, Node *root, int numQuery, int numThreads,
+                                  int chunk_size, const int *cpus);
+void scalingCurve(Node *root, Rect *queries, int numQuery, int maxThreads, const int *policies, int numPolicies,
+                  const char *const *lists, int every, long long expected);
+int scalingMain(int argc, char **argv);
+int benchMain(int argc, char **argv);
+PolygonIndex *createPolygonIndex(Node *root, const Rect *rects, int n);
+void freePolygonIndex(PolygonIndex *p);
+size_t polygonStoreBytes(const PolygonIndex *p);
+int polygonMeetsWindow(const PolygonIndex *p, uint32_t i, Rect q);
+int polygonRefine(const PolygonIndex *p, Rect q, const uint32_t *cand, int n, RefineStats *s);
+int polygonQuery(const PolygonIndex *p, Rect q, RefineStats *s);
+void polygonBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                      long long expected);
+void measureTreeFootprint(const Node *root, TreeFootprint *f);
+size_t footprintHeapBytes(const LevelFootprint *l);
+void printTreeFootprint(const TreeFootprint *f, int numRects, int numQuery);
+int readProcMemory(long *rssKb, long *hwmKb);
+void memoryPhase(const char *name);
+void printMemoryPhases(void);
+int streamLoad(const char *dataPath, const char *queryPath, int numThreads, StreamLoad *out);
+void streamLoadBenchmark(const char *dataPath, const char *queryPath, int numThreads);
+int computeCenterX(Rect r);
+int computeCenterY(Rect r);
+int Zval(int x, int y);
+int sockWriteAll(int fd, const void *buf, size_t len);
+int sockReadAll(int fd, void *buf, size_t len);
+int sockReaderGet(SockReader *r, void *dst, size_t n);
+int queryServerListen(const char *addr);
+int queryServerConnect(const char *addr);
+int runQueryServer(const char *addr, Node *root, const Rect *rects, int numRects, int numWorkers,
+                   int readyFd);
+long long runQueryClient(const char *addr, const Rect *queries, int numQuery, int op,
+                         int connections, int depth);
+int sendServerShutdown(const char *addr);
+void queryServerBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries,
+                          int numQuery, int numThreads, long long expected);
+int queryServerMain(int argc, char **argv);
+QueryPool *createQueryPool(Node *root, int numThreads, int queueCapacity);
+uint32_t submitQueries(QueryPool *p, const Rect *queries, int *results, int numQuery, int chunk,
+                       QueryCallback callback, void *user);
+uint32_t submitIndexQueries(QueryPool *p, QuerySearchFn search, const void *index, const Rect *queries,
+                            int *results, int numQuery, int chunk, QueryCallback callback, void *user);
+int pollCompletions(QueryPool *p, QueryCompletion *out, int max);
+int waitCompletions(QueryPool *p, QueryCompletion *out, int max);
+int ticketDone(QueryPool *p, uint32_t ticket);
+void waitTicket(QueryPool *p, uint32_t ticket);
+void destroyQueryPool(QueryPool *p);
+void asyncQueryBenchmark(Node *root, const Rect *queries, int numQuery, int numThreads,
+                         long long expected);
+ShardSet *createShardSet(const Rect *rects, int numRects, int numShards, int workersPerShard);
+int shardCount(const ShardSet *set);
+int shardFanout(const ShardSet *set, Rect q);
+long long shardedQuery(ShardSet *set, const Rect *queries, int numQuery, int op, int *counts,
+                       ShardIdSink sink, void *user);
+void destroyShardSet(ShardSet *set);
+IndexCatalog *createIndexCatalog(size_t memoryBudget, int numThreads);
+void catalogSetBudget(IndexCatalog *cat, size_t memoryBudget);
+size_t catalogBytes(const IndexCatalog *cat);
+int catalogFind(const IndexCatalog *cat, const char *name);
+int catalogAddTree(IndexCatalog *cat, const char *name, Node *root, int numRects, int owned);
+int catalogAddDataset(IndexCatalog *cat, const char *name, int option);
+int catalogAddSnapshot(IndexCatalog *cat, const char *name, const char *path);
+void catalogRemove(IndexCatalog *cat, int index);
+long long catalogQueryMixed(IndexCatalog *cat, const CatalogQuery *queries, int numQuery, int *results);
+void printIndexCatalog(const IndexCatalog *cat);
+void destroyIndexCatalog(IndexCatalog *cat);
+void catalogBenchmark(Node *root, int numRects, const Rect *queries, int numQuery, int dataset_option,
+                      int numThreads, long long expected);
+TreeQuality *analyzeRTree(Node *root, const Rect *queries, int numQuery, int numThreads);
+void freeTreeQuality(TreeQuality *tq);
+void writeTreeQualityJson(FILE *f, const char *label, const TreeQuality *tq);
+void printTreeQuality(const char *label, const TreeQuality *tq);
+int qualityExtentCheck(void);
+void treeQualityReport(Node *root, const Rect *rects, int numRects, const Rect *queries, int numQuery,
+                       int numThreads);
+SpatialIndex *buildSpatialIndex(const SpatialIndexOps *ops, const Rect *rects, int n);
+int spatialIndexSearch(const void *index, Rect q);
+int spatialIndexReport(const SpatialIndex *idx, Rect q, uint32_t *ids, int maxOut);
+size_t spatialIndexBytes(const SpatialIndex *idx);
+void freeSpatialIndex(SpatialIndex *idx);
+void engineBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, int numThreads,
+                     long long expected);
+void shardBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, long long expected);
+ResultCache *createResultCache(const SpatialIndex *index, const Rect *rects, int numRects, size_t budgetBytes);
+int resultCacheQuery(ResultCache *c, Rect q, uint32_t *ids, int maxOut);
+int resultCacheSearch(const void *cache, Rect q);
+void resultCacheInvalidate(ResultCache *c, const Rect *changed, int n);
+void resultCacheSetIndex(ResultCache *c, const SpatialIndex *index, const Rect *rects);
+size_t resultCacheBytes(const ResultCache *c);
+void printResultCacheStats(ResultCache *c);
+void destroyResultCache(ResultCache *c);
+void resultCacheBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, int numThreads);
+extern const SpatialIndexOps *const kernelInstances[];
+extern const int numKernelInstances;
+const SpatialIndexOps *selectKernelOps(const Rect *rects, int n);
+void kernelBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, long long expected,
+                     double seqTime);
 #endif
@@ -5,6 +5,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <math.h>
+#include <string.h>
 
 int countRectsInFile(const char *filename)
 {
@@ -117,7 +118,7 @@ Node *createLeaf(Rect *rectArr, int low, int high)
    Node *leaf = (Node *)malloc(sizeof(Node));
    leaf->isLeaf = 1;
    leaf->count = high - low + 1;
-   leaf->rects = (Rect *)malloc(leaf->count * sizeof(Rect));
+   leaf->rects = (Rect *)malloc(leafAllocBytes(leaf->count));
 
 
    // Initialize MBR and update with each rectangle
@@ -127,6 +128,7 @@ Node *createLeaf(Rect *rectArr, int low, int high)
        leaf->rects[i - low] = rectArr[i];
        updateMBRWithRect(&leaf->mbr, rectArr[i]);
    }
+   sortLeaf(leaf);
    return leaf;
 }
 // Safer leaf: also clear children pointer
@@ -136,13 +138,14 @@ Node *createLeaf_STR(Rect *rectArr, int low, int high)
     leaf->isLeaf = 1;
     leaf->children = NULL;                   // <-- important
     leaf->count = high - low + 1;
-    leaf->rects = (Rect *)malloc((size_t)leaf->count * sizeof(Rect));
+    leaf->rects = (Rect *)malloc(leafAllocBytes(leaf->count));
 
     initMBR(&leaf->mbr);
     for (int i = low; i <= high; i++) {
         leaf->rects[i - low] = rectArr[i];
         updateMBRWithRect(&leaf->mbr, rectArr[i]);
     }
+    sortLeaf(leaf);
     return leaf;
 }
 
@@ -167,6 +170,39 @@ int compareByYCenter(const void *a, const void *b)
    return cy1 - cy2;
 }
 
+// Total order on all four coordinates, used to match rects by value
+int compareRectLex(const void *a, const void *b)
+{
+   const Rect *r1 = (const Rect *)a;
+   const Rect *r2 = (const Rect *)b;
+   if (r1->xmin != r2->xmin) return (r1->xmin > r2->xmin) - (r1->xmin < r2->xmin);
+   if (r1->ymin != r2->ymin) return (r1->ymin > r2->ymin) - (r1->ymin < r2->ymin);
+   if (r1->xmax != r2->xmax) return (r1->xmax > r2->xmax) - (r1->xmax < r2->xmax);
+   return (r1->ymax > r2->ymax) - (r1->ymax < r2->ymax);
+}
+
+// Remove one rect of rects[0..n) for every equal rect in remove[0..nr).
+// Both arrays are sorted; returns the new count. *removed counts the matches.
+int subtractRects(Rect *rects, int n, Rect *remove, int nr, int *removed)
+{
+   qsort(rects, (size_t)n, sizeof(Rect), compareRectLex);
+   qsort(remove, (size_t)nr, sizeof(Rect), compareRectLex);
+   int w = 0, d = 0, hits = 0;
+   for (int i = 0; i < n; i++)
+   {
+      while (d < nr && compareRectLex(&remove[d], &rects[i]) < 0) d++;
+      if (d < nr && compareRectLex(&remove[d], &rects[i]) == 0)
+      {
+         d++;
+         hits++;
+         continue;
+      }
+      rects[w++] = rects[i];
+   }
+   if (removed) *removed = hits;
+   return w;
+}
+
 
 Node *createRTree(Rect *rectArr, int low, int high)
 {
@@ -444,34 +480,20 @@ static Node *createLeaf_safe(Rect *rectArr, int low, int high) {
     leaf->isLeaf = 1;
     leaf->children = NULL;
     leaf->count = high - low + 1;
-    leaf->rects = (Rect *)malloc((size_t)leaf->count * sizeof(Rect));
+    leaf->rects = (Rect *)malloc(leafAllocBytes(leaf->count));
     initMBR(&leaf->mbr);
     for (int i = low; i <= high; ++i) {
         leaf->rects[i - low] = rectArr[i];
         updateMBRWithRect(&leaf->mbr, rectArr[i]);
     }
+    sortLeaf(leaf);
     return leaf;
 }
 
-// Group an array of Node* into parents using STR at THIS level (recursive).
-// cap = max children per internal node (FANOUT).
-static Node *group_nodes_STR(Node **nodes, int n, int cap) {
-    if (n <= 0) return NULL;
-    if (n == 1) return nodes[0];                            // nothing to group
-    if (n <= cap) {                                         // single parent root
-        Node *p = (Node *)malloc(sizeof(Node));
-        p->isLeaf = 0;
-        p->rects = NULL;
-        p->count = n;
-        p->children = (Node **)malloc((size_t)n * sizeof(Node *));
-        initMBR(&p->mbr);
-        for (int i = 0; i < n; ++i) {
-            p->children[i] = nodes[i];
-            p->mbr = unionJoin(&p->mbr, &nodes[i]->mbr);
-        }
-        return p;
-    }
-
+// One STR level: tile `nodes` (sort by X, slice, within slice sort by Y) and
+// pack groups of `cap` into new parents. Returns the parents; *outCount is
+// their number. `nodes` is reordered.
+Node **packLevel_STR(Node **nodes, int n, int cap, int *outCount) {
     // STR tiling on nodes: sort by X, slice, within slice sort by Y, then pack groups of size 'cap'.
     qsort(nodes, (size_t)n, sizeof(Node *), cmpNodeX);
 
@@ -489,7 +511,7 @@ static Node *group_nodes_STR(Node **nodes, int n, int cap) {
         parentCount += (sc + cap - 1) / cap;               // ceil(sc / cap)
     }
 
-    Node **parents = (Node **)malloc((size_t)parentCount * sizeof(Node *));
+    Node **parents = (Node **)malloc((size_t)(parentCount > 0 ? parentCount : 1) * sizeof(Node *));
     int pc = 0;
 
     // Pass B: build parents
@@ -519,6 +541,31 @@ static Node *group_nodes_STR(Node **nodes, int n, int cap) {
             parents[pc++] = p;
         }
     }
+    *outCount = pc;
+    return parents;
+}
+
+// Group an array of Node* into parents using STR at THIS level (recursive).
+// cap = max children per internal node (FANOUT).
+Node *group_nodes_STR(Node **nodes, int n, int cap) {
+    if (n <= 0) return NULL;
+    if (n == 1) return nodes[0];                            // nothing to group
+    if (n <= cap) {                                         // single parent root
+        Node *p = (Node *)malloc(sizeof(Node));
+        p->isLeaf = 0;
+        p->rects = NULL;
+        p->count = n;
+        p->children = (Node **)malloc((size_t)n * sizeof(Node *));
+        initMBR(&p->mbr);
+        for (int i = 0; i < n; ++i) {
+            p->children[i] = nodes[i];
+            p->mbr = unionJoin(&p->mbr, &nodes[i]->mbr);
+        }
+        return p;
+    }
+
+    int pc;
+    Node **parents = packLevel_STR(nodes, n, cap, &pc);
 
     // Recurse upward
     Node *root = group_nodes_STR(parents, pc, cap);
@@ -526,13 +573,15 @@ static Node *group_nodes_STR(Node **nodes, int n, int cap) {
     return root;
 }
 
-// Fully recursive STR bulk loader (leaves + all upper levels use STR tiling).
-Node *createRTree_STR_2(Rect *rectArr, int low, int high)
+// STR leaf level over rectArr[low..high]: sort by X, slice, within slice sort
+// by Y, pack leaves of size BUNDLEFACTOR. Returns the leaves; *outCount is
+// their number. The range is reordered.
+Node **packLeaves_STR(Rect *rectArr, int low, int high, int *outCount)
 {
     int total = high - low + 1;
+    *outCount = 0;
     if (total <= 0) return NULL;
 
-    // Leaf-level STR: sort by X, slice, within slice sort by Y, pack leaves of size BUNDLEFACTOR.
     qsort(&rectArr[low], (size_t)total, sizeof(Rect), compareByXCenter);
 
     int S = (int)ceil(sqrt((double)total / BUNDLEFACTOR)); // recommended STR formula
@@ -570,6 +619,16 @@ Node *createRTree_STR_2(Rect *rectArr, int low, int high)
             leaves[L++] = createLeaf_safe(rectArr, i, end);
         }
     }
+    *outCount = L;
+    return leaves;
+}
+
+// Fully recursive STR bulk loader (leaves + all upper levels use STR tiling).
+Node *createRTree_STR_2(Rect *rectArr, int low, int high)
+{
+    int L;
+    Node **leaves = packLeaves_STR(rectArr, low, high, &L);
+    if (!leaves) return NULL;
 
     // Upper levels: recursively group leaves with STR using FANOUT as capacity.
     Node *root = group_nodes_STR(leaves, L, FANOUT);
@@ -633,17 +692,7 @@ int searchRTree(Node *node, Rect queryRect, int q)
         return 0;
 
     if (node->isLeaf) {
-        for (int i = 0; i < node->count; i++) {
-            const Rect *r = &node->rects[i];
-            if (isOverlap((const MBR *)r, queryRect)) {
-                // Optional debug logging for a specific query ID
-                // if (q == 6)
-                //     printf("\nQuery[%d]=[%d,%d-%d,%d] overlapped with Rect[%d,%d-%d,%d]", q,
-                //         queryRect.xmin, queryRect.ymin, queryRect.xmax, queryRect.ymax,
-                //         r->xmin, r->ymin, r->xmax, r->ymax);
-                count++;
-            }
-        }
+        count = searchLeaf(node, queryRect);
     } else {
         for (int i = 0; i < node->count; i++) {
             count += searchRTree(node->children[i], queryRect, q);
@@ -673,11 +722,7 @@ int searchRTree_iter(Node *root, Rect queryRect, int q)
 
         if (node->isLeaf) {
             // Scan leaf
-            for (int i = 0; i < node->count; i++) {
-                const Rect *r = &node->rects[i];
-                if (isOverlap((const MBR *)r, queryRect))
-                    count++;
-            }
+            count += searchLeaf(node, queryRect);
         } else {
             // Push (lightly prefetched) children
             // Optional prefetch of the first child MBR to hide latency:
@@ -740,6 +785,48 @@ void printRTreeStats(Node *root)
 }
 
 
+// Free a tree built by any of the loaders (nodes, children arrays, leaf rects)
+void freeRTree(Node *node)
+{
+    if (!node)
+        return;
+    if (node->isLeaf)
+    {
+        free(node->rects);
+    }
+    else
+    {
+        for (int i = 0; i < node->count; i++)
+        {
+            freeRTree(node->children[i]);
+        }
+        free(node->children);
+    }
+    free(node);
+}
+
+// Deep copy of a tree, so a mutable copy can be handed to the update paths
+Node *cloneRTree(const Node *node)
+{
+    if (!node)
+        return NULL;
+    Node *copy = (Node *)malloc(sizeof(Node));
+    *copy = *node;
+    if (node->isLeaf)
+    {
+        copy->rects = (Rect *)malloc(leafBytes(node));
+        memcpy(copy->rects, node->rects, leafBytes(node));
+    }
+    else
+    {
+        copy->children = (Node **)malloc((size_t)node->count * sizeof(Node *));
+        for (int i = 0; i < node->count; i++)
+        {
+            copy->children[i] = cloneRTree(node->children[i]);
+        }
+    }
+    return copy;
+}
 
 void writeTimingLog(int numRects, int numQuery, int numThreads, double seq_time_ms, double par_time_ms)
 {
@@ -783,7 +870,7 @@ void writeTimingLog(int numRects, int numQuery, int numThreads, double seq_time_
     }
 }
 
-Rect *selectDataDataset(int *numRects, int option)
+const char *dataDatasetPath(int option)
 {
     const char *paths[] = {
         "Data/Uniform_Box_6M_int.csv",
@@ -799,10 +886,16 @@ Rect *selectDataDataset(int *numRects, int option)
         exit(1);
     }
 
-    return readRectsFromFile(paths[option - 1], numRects);
+    return paths[option - 1];
 }
 
-Rect *selectQueryDataset(int *numQuery, int dataset_option)
+Rect *selectDataDataset(int *numRects, int option)
+{
+    return readRectsFromFile(dataDatasetPath(option), numRects);
+}
+
+// Prompt for one of the query files of a dataset and return its path
+const char *selectQueryPath(int dataset_option)
 {
     int option = 0;
 
@@ -946,6 +1039,11 @@ Rect *selectQueryDataset(int *numQuery, int dataset_option)
         exit(1);
     }
 
+    return paths[option - 1];
+}
+
+Rect *selectQueryDataset(int *numQuery, int dataset_option)
+{
     /* Load and return the chosen query file */
-    return readRectsFromFile(paths[option - 1], numQuery);
+    return readRectsFromFile(selectQueryPath(dataset_option), numQuery);
 }
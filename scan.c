@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "rtree.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// ---------------- Brute-force scan engine ----------------
+//
+// Streams the flat rects array and counts overlaps. With SSE2 (always there
+// on x86-64, so no -march is needed) four rectangles are loaded, transposed
+// into xmin/ymin/xmax/ymax lanes and tested with four compares. For very large
+// windows this beats walking the tree: there is no pruning left to gain and the
+// scan is a perfectly sequential, branch-free stream.
+
+#define SCAN_BLOCK 2048   // rects per block in the batched scan (32 KB)
+
+int scanCount(const Rect *rects, int n, Rect q)
+{
+    int i = 0;
+    int count = 0;
+#ifdef __SSE2__
+    const __m128i qxmin = _mm_set1_epi32(q.xmin);
+    const __m128i qymin = _mm_set1_epi32(q.ymin);
+    const __m128i qxmax = _mm_set1_epi32(q.xmax);
+    const __m128i qymax = _mm_set1_epi32(q.ymax);
+    __m128i misses = _mm_setzero_si128();
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)&rects[i]);
+        __m128i r1 = _mm_loadu_si128((const __m128i *)&rects[i + 1]);
+        __m128i r2 = _mm_loadu_si128((const __m128i *)&rects[i + 2]);
+        __m128i r3 = _mm_loadu_si128((const __m128i *)&rects[i + 3]);
+
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);   // xmin0 xmin1 ymin0 ymin1
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);   // xmin2 xmin3 ymin2 ymin3
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);   // xmax0 xmax1 ymax0 ymax1
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);   // xmax2 xmax3 ymax2 ymax3
+
+        __m128i xmin = _mm_unpacklo_epi64(t0, t1);
+        __m128i ymin = _mm_unpackhi_epi64(t0, t1);
+        __m128i xmax = _mm_unpacklo_epi64(t2, t3);
+        __m128i ymax = _mm_unpackhi_epi64(t2, t3);
+
+        __m128i miss = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(xmin, qxmax), _mm_cmpgt_epi32(ymin, qymax)),
+            _mm_or_si128(_mm_cmpgt_epi32(qxmin, xmax), _mm_cmpgt_epi32(qymin, ymax)));
+        misses = _mm_sub_epi32(misses, miss);      // miss lanes are -1
+    }
+
+    int lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, misses);
+    count = i - (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+    for (; i < n; i++)
+        if (isOverlap_inline((const MBR *)&rects[i], q))
+            count++;
+    return count;
+}
+
+typedef struct {
+    const Rect *rects;
+    int low, high;          // [low, high) share of the rects array
+    const Rect *queries;
+    int numQuery;
+    int *local;             // per-thread partial counts
+} ScanArgs;
+
+static void *scan_worker(void *arg)
+{
+    ScanArgs *a = (ScanArgs *)arg;
+    // Block-at-a-time: every query in the batch is run over one cache-sized
+    // block before moving on, so the rects are streamed from memory once.
+    for (int b = a->low; b < a->high; b += SCAN_BLOCK) {
+        int len = a->high - b < SCAN_BLOCK ? a->high - b : SCAN_BLOCK;
+        for (int q = 0; q < a->numQuery; q++)
+            a->local[q] += scanCount(a->rects + b, len, a->queries[q]);
+    }
+    return NULL;
+}
+
+// Count overlaps of every query in the batch by scanning rects[0..n) once,
+// split into contiguous ranges over numThreads threads.
+void scanCountBatch(const Rect *rects, int n, const Rect *queries, int numQuery,
+                    int *results, int numThreads)
+{
+    if (numQuery <= 0) return;
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > n / SCAN_BLOCK + 1) numThreads = n / SCAN_BLOCK + 1;
+
+    pthread_t threads[numThreads];
+    ScanArgs args[numThreads];
+    int *locals = (int *)calloc((size_t)numThreads * numQuery, sizeof(int));
+    if (!locals) {
+        perror("Unable to allocate scan partials");
+        exit(EXIT_FAILURE);
+    }
+
+    int share = (n + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        int lo = t * share;
+        int hi = lo + share > n ? n : lo + share;
+        args[t] = (ScanArgs){
+            .rects = rects,
+            .low = lo < n ? lo : n,
+            .high = hi,
+            .queries = queries,
+            .numQuery = numQuery,
+            .local = locals + (size_t)t * numQuery};
+        pthread_create(&threads[t], NULL, scan_worker, &args[t]);
+    }
+    for (int t = 0; t < numThreads; t++)
+        pthread_join(threads[t], NULL);
+
+    for (int q = 0; q < numQuery; q++) {
+        int sum = 0;
+        for (int t = 0; t < numThreads; t++)
+            sum += locals[(size_t)t * numQuery + q];
+        results[q] = sum;
+    }
+    free(locals);
+}
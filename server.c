@@ -0,0 +1,796 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "rtree.h"
+
+// ---------------- Query server and load generator ----------------
+//
+// runQueryServer keeps one tree (as a FlatTree plus original rect ids) and
+// answers QueryRequests from any number of connections. The address is a
+// Unix socket path ("unix:/path" or a plain path) or "tcp:PORT" on localhost.
+//
+//   connection threads   read fixed-size requests, stamp them with the Z
+//                        value of the window center, append to the inbox
+//   batcher              takes the inbox once it is SERVER_BATCH_US old or
+//                        SERVER_BATCH_MAX long, sorts it by Z value and cuts
+//                        it into chunks for the workers
+//   workers              answer a chunk and write every reply to its
+//                        connection under that connection's write lock
+//
+// Z-ordering a batch makes consecutive queries walk mostly the same nodes,
+// so a worker's chunk reuses what its predecessor pulled into cache.
+//
+// QOP_SHUTDOWN is only honoured on a Unix socket, whose file permissions
+// decide who may connect; over TCP it is answered as an unknown op.
+// On QOP_SHUTDOWN the accept loop stops and every connection is shut for
+// reading. Once the readers are joined the batcher flushes the inbox, the
+// workers answer what is queued, and all threads are joined before
+// runQueryServer frees the tree copy and returns.
+//
+// Replies are a QueryReply header followed by `returned` Rects (QOP_WINDOW)
+// or uint32 ids (QOP_IDS); `count` is always the full number of hits.
+// Worker buffers start at SERVER_INITIAL_RESULTS and grow to the largest
+// reply seen so far, capped at SERVER_MAX_RESULTS.
+
+#define SERVER_BATCH_US 200
+#define SERVER_BATCH_MAX 4096
+#define SERVER_CHUNK 64
+#define SERVER_INITIAL_RESULTS 4096
+#define SERVER_MAX_RESULTS (1 << 20)
+
+typedef struct Conn {
+    int fd;
+    pthread_mutex_t writeLock;
+    _Atomic int refs;             // reader + queued requests
+    pthread_t reader;
+    struct Conn *next;            // in Server.live or Server.done
+} Conn;
+
+typedef struct {
+    QueryRequest req;
+    Conn *conn;
+    int z;
+} Pending;
+
+typedef struct {
+    Pending *items;
+    _Atomic int chunksLeft;
+} Batch;
+
+typedef struct {
+    Batch *batch;
+    int first, count;
+} Job;
+
+typedef struct {
+    const FlatTree *flat;
+    const uint32_t *ids;
+    int listenFd;
+    int allowShutdown;            // Unix socket: QOP_SHUTDOWN stops the server
+    _Atomic int stop;
+
+    pthread_mutex_t connLock;
+    pthread_cond_t connCond;      // signalled when `live` empties
+    Conn *live;                   // connections with a running reader
+    Conn *done;                   // readers that finished, to be joined
+
+    pthread_mutex_t inboxLock;
+    pthread_cond_t inboxCond;
+    Pending *inbox;
+    int inboxCount, inboxCap;
+    double inboxSince;            // arrival time of the oldest queued request
+    int inboxClosed;              // readers joined, no more requests
+
+    pthread_mutex_t jobLock;
+    pthread_cond_t jobCond;
+    Job *jobs;
+    int jobHead, jobCount, jobCap;
+    int jobsClosed;               // batcher joined, no more jobs
+} Server;
+
+int sockWriteAll(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t w = send(fd, p, len, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+int sockReadAll(int fd, void *buf, size_t len)
+{
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t r = read(fd, p, len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+// ---- addresses ----
+
+static int makeAddress(const char *addr, struct sockaddr_storage *sa, socklen_t *len)
+{
+    memset(sa, 0, sizeof(*sa));
+    if (strncmp(addr, "tcp:", 4) == 0) {
+        struct sockaddr_in *in = (struct sockaddr_in *)sa;
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)atoi(addr + 4));
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        *len = sizeof(*in);
+        return AF_INET;
+    }
+    if (strncmp(addr, "unix:", 5) == 0) addr += 5;
+    struct sockaddr_un *un = (struct sockaddr_un *)sa;
+    un->sun_family = AF_UNIX;
+    if (strlen(addr) >= sizeof(un->sun_path)) return -1;
+    strcpy(un->sun_path, addr);
+    *len = sizeof(*un);
+    return AF_UNIX;
+}
+
+int queryServerListen(const char *addr)
+{
+    struct sockaddr_storage sa;
+    socklen_t len;
+    int family = makeAddress(addr, &sa, &len);
+    if (family < 0) {
+        fprintf(stderr, "Bad server address %s\n", addr);
+        return -1;
+    }
+    int fd = socket(family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Unable to create server socket");
+        return -1;
+    }
+    if (family == AF_UNIX) {
+        unlink(((struct sockaddr_un *)&sa)->sun_path);
+    } else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(fd, (struct sockaddr *)&sa, len) != 0 || listen(fd, 128) != 0) {
+        perror("Unable to listen on server address");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int queryServerConnect(const char *addr)
+{
+    struct sockaddr_storage sa;
+    socklen_t len;
+    int family = makeAddress(addr, &sa, &len);
+    if (family < 0) return -1;
+    int fd = socket(family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&sa, len) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (family == AF_INET) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// ---- server ----
+
+static void connRelease(Conn *c)
+{
+    if (atomic_fetch_sub(&c->refs, 1) == 1) {
+        close(c->fd);
+        pthread_mutex_destroy(&c->writeLock);
+        free(c);
+    }
+}
+
+typedef struct {
+    Server *s;
+    Conn *conn;
+} ReaderArgs;
+
+static void *conn_reader(void *arg)
+{
+    ReaderArgs *ra = (ReaderArgs *)arg;
+    Server *s = ra->s;
+    Conn *c = ra->conn;
+    free(ra);
+    QueryRequest reqs[64];
+    for (;;) {
+        ssize_t r = read(c->fd, reqs, sizeof(reqs));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        // Complete the last partial request
+        size_t have = (size_t)r;
+        if (have % sizeof(QueryRequest) &&
+            sockReadAll(c->fd, (char *)reqs + have, sizeof(QueryRequest) - have % sizeof(QueryRequest)) != 0)
+            break;
+        int n = (int)((have + sizeof(QueryRequest) - 1) / sizeof(QueryRequest));
+
+        pthread_mutex_lock(&s->inboxLock);
+        for (int i = 0; i < n; i++) {
+            if (reqs[i].op == QOP_SHUTDOWN && s->allowShutdown) {
+                atomic_store(&s->stop, 1);
+                shutdown(s->listenFd, SHUT_RDWR);
+                continue;
+            }
+            if (s->inboxCount == s->inboxCap) {
+                s->inboxCap = s->inboxCap ? s->inboxCap * 2 : 1024;
+                s->inbox = (Pending *)realloc(s->inbox, (size_t)s->inboxCap * sizeof(Pending));
+                if (!s->inbox) {
+                    perror("Unable to grow server inbox");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (s->inboxCount == 0) s->inboxSince = nowSeconds();
+            Rect w = reqs[i].window;
+            atomic_fetch_add(&c->refs, 1);
+            s->inbox[s->inboxCount++] = (Pending){
+                .req = reqs[i], .conn = c, .z = Zval(computeCenterX(w), computeCenterY(w))};
+            // The batcher waits for the first request, then for a full batch
+            if (s->inboxCount == 1 || s->inboxCount == SERVER_BATCH_MAX) pthread_cond_signal(&s->inboxCond);
+        }
+        pthread_mutex_unlock(&s->inboxLock);
+    }
+    // Hand the connection to the accept thread, which joins this thread
+    // and drops the reader's reference
+    pthread_mutex_lock(&s->connLock);
+    Conn **pp = &s->live;
+    while (*pp != c) pp = &(*pp)->next;
+    *pp = c->next;
+    c->next = s->done;
+    s->done = c;
+    if (!s->live) pthread_cond_broadcast(&s->connCond);
+    pthread_mutex_unlock(&s->connLock);
+    return NULL;
+}
+
+static void reapReaders(Server *s)
+{
+    pthread_mutex_lock(&s->connLock);
+    Conn *c = s->done;
+    s->done = NULL;
+    pthread_mutex_unlock(&s->connLock);
+    while (c) {
+        Conn *next = c->next;
+        pthread_join(c->reader, NULL);
+        connRelease(c);
+        c = next;
+    }
+}
+
+static int cmpPendingZ(const void *A, const void *B)
+{
+    const Pending *a = (const Pending *)A, *b = (const Pending *)B;
+    return (a->z > b->z) - (a->z < b->z);
+}
+
+static void *batcher(void *arg)
+{
+    Server *s = (Server *)arg;
+    for (;;) {
+        pthread_mutex_lock(&s->inboxLock);
+        while (s->inboxCount == 0 && !s->inboxClosed)
+            pthread_cond_wait(&s->inboxCond, &s->inboxLock);
+        if (s->inboxCount == 0) {
+            pthread_mutex_unlock(&s->inboxLock);
+            break;
+        }
+        // Let the batch fill until it is old or large enough
+        double wait = s->inboxSince + SERVER_BATCH_US * 1e-6 - nowSeconds();
+        if (wait > 0 && s->inboxCount < SERVER_BATCH_MAX && !s->inboxClosed) {
+            double due = s->inboxSince + SERVER_BATCH_US * 1e-6;
+            struct timespec deadline = {(time_t)due, (long)((due - (time_t)due) * 1e9)};
+            pthread_cond_timedwait(&s->inboxCond, &s->inboxLock, &deadline);
+            pthread_mutex_unlock(&s->inboxLock);
+            continue;
+        }
+        Batch *b = (Batch *)malloc(sizeof(Batch));
+        if (!b) {
+            perror("Unable to allocate server batch");
+            exit(EXIT_FAILURE);
+        }
+        int n = s->inboxCount;
+        b->items = s->inbox;
+        s->inbox = NULL;
+        s->inboxCount = s->inboxCap = 0;
+        pthread_mutex_unlock(&s->inboxLock);
+
+        qsort(b->items, (size_t)n, sizeof(Pending), cmpPendingZ);
+        int chunks = (n + SERVER_CHUNK - 1) / SERVER_CHUNK;
+        atomic_init(&b->chunksLeft, chunks);
+
+        pthread_mutex_lock(&s->jobLock);
+        if (s->jobCount + chunks > s->jobCap) {
+            // Grow the ring and unwrap it
+            int cap = (s->jobCount + chunks) * 2;
+            Job *jobs = (Job *)malloc((size_t)cap * sizeof(Job));
+            if (!jobs) {
+                perror("Unable to grow server job queue");
+                exit(EXIT_FAILURE);
+            }
+            for (int i = 0; i < s->jobCount; i++) jobs[i] = s->jobs[(s->jobHead + i) % s->jobCap];
+            free(s->jobs);
+            s->jobs = jobs;
+            s->jobHead = 0;
+            s->jobCap = cap;
+        }
+        for (int c = 0; c < chunks; c++) {
+            int first = c * SERVER_CHUNK;
+            s->jobs[(s->jobHead + s->jobCount++) % s->jobCap] =
+                (Job){b, first, n - first < SERVER_CHUNK ? n - first : SERVER_CHUNK};
+        }
+        pthread_cond_broadcast(&s->jobCond);
+        pthread_mutex_unlock(&s->jobLock);
+    }
+    return NULL;
+}
+
+static void *growBuffer(void *p, size_t bytes)
+{
+    p = realloc(p, bytes);
+    if (!p) {
+        perror("Unable to grow server worker buffers");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void *server_worker(void *arg)
+{
+    Server *s = (Server *)arg;
+    int hitCap = SERVER_INITIAL_RESULTS;
+    size_t outCap = sizeof(QueryReply) + (size_t)hitCap * sizeof(Rect);
+    uint32_t *hits = (uint32_t *)growBuffer(NULL, (size_t)hitCap * sizeof(uint32_t));
+    char *out = (char *)growBuffer(NULL, outCap);
+    for (;;) {
+        pthread_mutex_lock(&s->jobLock);
+        while (s->jobCount == 0 && !s->jobsClosed) pthread_cond_wait(&s->jobCond, &s->jobLock);
+        if (s->jobCount == 0) {
+            pthread_mutex_unlock(&s->jobLock);
+            break;
+        }
+        Job job = s->jobs[s->jobHead];
+        s->jobHead = (s->jobHead + 1) % s->jobCap;
+        s->jobCount--;
+        pthread_mutex_unlock(&s->jobLock);
+
+        for (int i = job.first; i < job.first + job.count; i++) {
+            Pending *p = &job.batch->items[i];
+            QueryReply rep = {.id = p->req.id, .op = p->req.op};
+            size_t len = sizeof(QueryReply);
+            if (p->req.op == QOP_COUNT) {
+                rep.count = (uint32_t)searchFlatTree(s->flat, p->req.window);
+            } else if (p->req.op == QOP_WINDOW || p->req.op == QOP_IDS) {
+                int n = searchFlatTree_collect(s->flat, p->req.window, hits, hitCap);
+                if (n > hitCap && hitCap < SERVER_MAX_RESULTS) {
+                    // Larger than any reply so far: grow and collect again
+                    hitCap = n < SERVER_MAX_RESULTS ? n : SERVER_MAX_RESULTS;
+                    hits = (uint32_t *)growBuffer(hits, (size_t)hitCap * sizeof(uint32_t));
+                    n = searchFlatTree_collect(s->flat, p->req.window, hits, hitCap);
+                }
+                rep.count = (uint32_t)n;
+                rep.returned = (uint32_t)(n < SERVER_MAX_RESULTS ? n : SERVER_MAX_RESULTS);
+                rep.status = n > SERVER_MAX_RESULTS;
+                len += rep.returned * (p->req.op == QOP_WINDOW ? sizeof(Rect) : sizeof(uint32_t));
+                if (len > outCap) {
+                    outCap = len;
+                    out = (char *)growBuffer(out, outCap);
+                }
+                for (uint32_t k = 0; k < rep.returned; k++) {
+                    if (p->req.op == QOP_WINDOW)
+                        ((Rect *)(out + sizeof(QueryReply)))[k] = s->flat->rects[hits[k]];
+                    else
+                        ((uint32_t *)(out + sizeof(QueryReply)))[k] = s->ids[hits[k]];
+                }
+            } else {
+                rep.status = 2;                      // unknown op
+            }
+            memcpy(out, &rep, sizeof(rep));
+            pthread_mutex_lock(&p->conn->writeLock);
+            sockWriteAll(p->conn->fd, out, len);
+            pthread_mutex_unlock(&p->conn->writeLock);
+            connRelease(p->conn);
+        }
+        if (atomic_fetch_sub(&job.batch->chunksLeft, 1) == 1) {
+            free(job.batch->items);
+            free(job.batch);
+        }
+    }
+    free(hits);
+    free(out);
+    return NULL;
+}
+
+// Serve `root` on `addr` until a QOP_SHUTDOWN arrives (Unix sockets only). rects[0..numRects)
+// defines the ids returned by QOP_IDS. If readyFd >= 0 one byte is written
+// to it once the socket listens. Returns 0 after a shutdown request.
+int runQueryServer(const char *addr, Node *root, const Rect *rects, int numRects, int numWorkers,
+                   int readyFd)
+{
+    Server *s = (Server *)calloc(1, sizeof(Server));
+    if (!s) {
+        perror("Unable to allocate server");
+        exit(EXIT_FAILURE);
+    }
+    s->listenFd = queryServerListen(addr);
+    if (s->listenFd < 0) {
+        free(s);
+        return -1;
+    }
+    s->allowShutdown = strncmp(addr, "tcp:", 4) != 0;
+    FlatTree *flat = createFlatTree(root, FLAT_BFS);
+    uint32_t *ids = flatTreeRectIds(flat, rects, numRects);
+    s->flat = flat;
+    s->ids = ids;
+    atomic_init(&s->stop, 0);
+    pthread_mutex_init(&s->connLock, NULL);
+    pthread_cond_init(&s->connCond, NULL);
+    // The batcher's deadlines come from nowSeconds, so wait on that clock
+    pthread_condattr_t monotonic;
+    pthread_condattr_init(&monotonic);
+    pthread_condattr_setclock(&monotonic, CLOCK_MONOTONIC);
+    pthread_mutex_init(&s->inboxLock, NULL);
+    pthread_cond_init(&s->inboxCond, &monotonic);
+    pthread_condattr_destroy(&monotonic);
+    pthread_mutex_init(&s->jobLock, NULL);
+    pthread_cond_init(&s->jobCond, NULL);
+
+    if (numWorkers < 1) numWorkers = 1;
+    pthread_t batchThread, workers[numWorkers];
+    pthread_create(&batchThread, NULL, batcher, s);
+    for (int w = 0; w < numWorkers; w++) pthread_create(&workers[w], NULL, server_worker, s);
+    if (readyFd >= 0) {
+        char ok = 1;
+        if (write(readyFd, &ok, 1) != 1) perror("Unable to signal server start");
+    }
+
+    while (!atomic_load(&s->stop)) {
+        int fd = accept(s->listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        Conn *c = (Conn *)malloc(sizeof(Conn));
+        ReaderArgs *ra = (ReaderArgs *)malloc(sizeof(ReaderArgs));
+        if (!c || !ra) {
+            perror("Unable to allocate connection");
+            exit(EXIT_FAILURE);
+        }
+        c->fd = fd;
+        pthread_mutex_init(&c->writeLock, NULL);
+        atomic_init(&c->refs, 1);
+        *ra = (ReaderArgs){s, c};
+        reapReaders(s);
+        pthread_mutex_lock(&s->connLock);
+        c->next = s->live;
+        s->live = c;
+        pthread_create(&c->reader, NULL, conn_reader, ra);
+        pthread_mutex_unlock(&s->connLock);
+    }
+    close(s->listenFd);
+    if (strncmp(addr, "tcp:", 4) != 0) unlink(strncmp(addr, "unix:", 5) == 0 ? addr + 5 : addr);
+
+    // Stop the readers; queued requests are still answered
+    pthread_mutex_lock(&s->connLock);
+    for (Conn *c = s->live; c; c = c->next) shutdown(c->fd, SHUT_RD);
+    while (s->live) pthread_cond_wait(&s->connCond, &s->connLock);
+    pthread_mutex_unlock(&s->connLock);
+    reapReaders(s);
+
+    pthread_mutex_lock(&s->inboxLock);
+    s->inboxClosed = 1;
+    pthread_cond_broadcast(&s->inboxCond);
+    pthread_mutex_unlock(&s->inboxLock);
+    pthread_join(batchThread, NULL);
+
+    pthread_mutex_lock(&s->jobLock);
+    s->jobsClosed = 1;
+    pthread_cond_broadcast(&s->jobCond);
+    pthread_mutex_unlock(&s->jobLock);
+    for (int w = 0; w < numWorkers; w++) pthread_join(workers[w], NULL);
+
+    pthread_mutex_destroy(&s->connLock);
+    pthread_cond_destroy(&s->connCond);
+    pthread_mutex_destroy(&s->inboxLock);
+    pthread_cond_destroy(&s->inboxCond);
+    pthread_mutex_destroy(&s->jobLock);
+    pthread_cond_destroy(&s->jobCond);
+    free(s->inbox);
+    free(s->jobs);
+    free(ids);
+    freeFlatTree(flat);
+    free(s);
+    return 0;
+}
+
+// ---- load generator ----
+
+typedef struct {
+    const char *addr;
+    const Rect *queries;
+    int first, stride, numQuery;
+    int depth;
+    int op;
+    long long hits;
+    long long mismatched;       // replies whose payload disagreed with count
+    float *lat;                 // microseconds
+    int numLat;
+    int failed;
+} ClientConn;
+
+// Buffered read of n bytes from a reply stream; dst NULL skips them.
+int sockReaderGet(SockReader *r, void *dst, size_t n)
+{
+    char *d = (char *)dst;
+    while (n > 0) {
+        if (r->pos == r->len) {
+            ssize_t got = read(r->fd, r->buf, sizeof(r->buf));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return -1;
+            r->pos = 0;
+            r->len = (int)got;
+        }
+        size_t take = (size_t)(r->len - r->pos) < n ? (size_t)(r->len - r->pos) : n;
+        if (d) {
+            memcpy(d, r->buf + r->pos, take);
+            d += take;
+        }
+        r->pos += (int)take;
+        n -= take;
+    }
+    return 0;
+}
+
+static void *client_conn(void *arg)
+{
+    ClientConn *c = (ClientConn *)arg;
+    SockReader *rd = (SockReader *)malloc(sizeof(SockReader));
+    double *sent = (double *)malloc((size_t)c->numQuery * sizeof(double));
+    QueryRequest *out = (QueryRequest *)malloc((size_t)c->depth * sizeof(QueryRequest));
+    rd->fd = queryServerConnect(c->addr);
+    rd->pos = rd->len = 0;
+    if (rd->fd < 0) {
+        c->failed = 1;
+        free(rd);
+        free(sent);
+        free(out);
+        return NULL;
+    }
+    int next = c->first, outstanding = 0, total = 0;
+    for (int i = c->first; i < c->numQuery; i += c->stride) total++;
+    int received = 0;
+    while (received < total) {
+        // Keep `depth` requests in flight, sent in one write
+        int n = 0;
+        double now = nowSeconds();
+        while (outstanding + n < c->depth && next < c->numQuery) {
+            out[n] = (QueryRequest){.id = (uint32_t)next, .op = (uint16_t)c->op, .window = c->queries[next]};
+            sent[next] = now;
+            n++;
+            next += c->stride;
+        }
+        if (n > 0 && sockWriteAll(rd->fd, out, (size_t)n * sizeof(QueryRequest)) != 0) {
+            c->failed = 1;
+            break;
+        }
+        outstanding += n;
+
+        QueryReply rep;
+        if (sockReaderGet(rd, &rep, sizeof(rep)) != 0) {
+            c->failed = 1;
+            break;
+        }
+        size_t item = rep.op == QOP_WINDOW ? sizeof(Rect) : sizeof(uint32_t);
+        if (rep.returned && sockReaderGet(rd, NULL, rep.returned * item) != 0) {
+            c->failed = 1;
+            break;
+        }
+        c->lat[c->numLat++] = (float)((nowSeconds() - sent[rep.id]) * 1e6);
+        c->hits += rep.count;
+        if (rep.op != QOP_COUNT && rep.returned != rep.count && !rep.status) c->mismatched++;
+        outstanding--;
+        received++;
+    }
+    close(rd->fd);
+    free(rd);
+    free(sent);
+    free(out);
+    return NULL;
+}
+
+static int cmpFloatAsc(const void *A, const void *B)
+{
+    float a = *(const float *)A, b = *(const float *)B;
+    return (a > b) - (a < b);
+}
+
+// Send every query once over `connections` sockets with up to `depth`
+// requests in flight each; print throughput and latency percentiles.
+// Returns the summed hit counts, or -1 if a connection failed.
+long long runQueryClient(const char *addr, const Rect *queries, int numQuery, int op,
+                         int connections, int depth)
+{
+    if (connections < 1) connections = 1;
+    if (depth < 1) depth = 1;
+    pthread_t threads[connections];
+    ClientConn *cc = (ClientConn *)calloc((size_t)connections, sizeof(ClientConn));
+    for (int i = 0; i < connections; i++) {
+        cc[i] = (ClientConn){.addr = addr, .queries = queries, .first = i, .stride = connections,
+                             .numQuery = numQuery, .depth = depth, .op = op};
+        cc[i].lat = (float *)malloc((size_t)(numQuery / connections + 1) * sizeof(float));
+    }
+    double t0 = nowSeconds();
+    for (int i = 0; i < connections; i++) pthread_create(&threads[i], NULL, client_conn, &cc[i]);
+    long long hits = 0, mismatched = 0;
+    int failed = 0, numLat = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+        hits += cc[i].hits;
+        mismatched += cc[i].mismatched;
+        failed |= cc[i].failed;
+        numLat += cc[i].numLat;
+    }
+    double dt = nowSeconds() - t0;
+
+    float *lat = (float *)malloc((size_t)(numLat > 0 ? numLat : 1) * sizeof(float));
+    int k = 0;
+    for (int i = 0; i < connections; i++) {
+        memcpy(lat + k, cc[i].lat, (size_t)cc[i].numLat * sizeof(float));
+        k += cc[i].numLat;
+        free(cc[i].lat);
+    }
+    free(cc);
+    qsort(lat, (size_t)numLat, sizeof(float), cmpFloatAsc);
+    static const char *opNames[] = {"?", "count", "window", "ids"};
+    printf("%-7s %4d conn x %3d deep: %9.0f queries/s, p50 %8.1f us, p99 %8.1f us, %lld hits%s\n",
+           opNames[op >= QOP_COUNT && op <= QOP_IDS ? op : 0], connections, depth, numLat / dt,
+           numLat ? lat[numLat / 2] : 0.0f, numLat ? lat[(long long)numLat * 99 / 100] : 0.0f, hits,
+           mismatched ? " (payload mismatch)" : "");
+    free(lat);
+    return failed || mismatched ? -1 : hits;
+}
+
+int sendServerShutdown(const char *addr)
+{
+    int fd = queryServerConnect(addr);
+    if (fd < 0) return -1;
+    QueryRequest req = {.op = QOP_SHUTDOWN};
+    int rc = sockWriteAll(fd, &req, sizeof(req));
+    close(fd);
+    return rc;
+}
+
+// Fork a server on a private Unix socket, drive it with the load generator
+// at a few pipeline depths, check the totals and ids, then shut it down.
+void queryServerBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries,
+                          int numQuery, int numThreads, long long expected)
+{
+    char addr[64];
+    snprintf(addr, sizeof(addr), "/tmp/rtree_query_%d.sock", (int)getpid());
+    int ready[2];
+    if (pipe(ready) != 0) {
+        perror("Unable to create server pipe");
+        return;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Unable to fork query server");
+        return;
+    }
+    if (pid == 0) {
+        close(ready[0]);
+        int rc = runQueryServer(addr, root, rects, numRects, numThreads, ready[1]);
+        _exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(ready[1]);
+    char ok = 0;
+    if (read(ready[0], &ok, 1) != 1) {
+        fprintf(stderr, "Query server failed to start\n");
+        close(ready[0]);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+    close(ready[0]);
+
+    printf("\n[Query server] %s, %d workers, batches of up to %d us / %d requests\n",
+           addr, numThreads, SERVER_BATCH_US, SERVER_BATCH_MAX);
+    static const int depths[] = {1, 16, 128};
+    int correct = 1;
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        long long hits = runQueryClient(addr, queries, numQuery, QOP_COUNT, 4, depths[d]);
+        correct &= hits == expected;
+    }
+    // Payload paths on a slice of the queries: every returned id must
+    // name a rect that overlaps the window it answered
+    int sample = numQuery < 2000 ? numQuery : 2000;
+    correct &= runQueryClient(addr, queries, sample, QOP_WINDOW, 2, 32) >= 0;
+    correct &= runQueryClient(addr, queries, sample, QOP_IDS, 2, 32) >= 0;
+    int fd = queryServerConnect(addr);
+    for (int i = 0; fd >= 0 && i < sample; i += 97) {
+        QueryRequest req = {.id = (uint32_t)i, .op = QOP_IDS, .window = queries[i]};
+        QueryReply rep;
+        if (sockWriteAll(fd, &req, sizeof(req)) != 0 || sockReadAll(fd, &rep, sizeof(rep)) != 0) {
+            correct = 0;
+            break;
+        }
+        for (uint32_t k = 0; k < rep.returned; k++) {
+            uint32_t id;
+            if (sockReadAll(fd, &id, sizeof(id)) != 0 || id >= (uint32_t)numRects ||
+                !isOverlap_inline(&rects[id], queries[i])) {
+                correct = 0;
+                break;
+            }
+        }
+        if (!correct) break;
+    }
+    if (fd >= 0) close(fd);
+    sendServerShutdown(addr);
+    waitpid(pid, NULL, 0);
+    printf("%s Server results %s the sequential search\n", correct ? "✅" : "❌",
+           correct ? "match" : "do NOT match");
+}
+
+// ./rtree_cpu_baseline serve <data.csv> [addr] [workers]
+// ./rtree_cpu_baseline client <queries.csv> [addr] [connections] [depth] [count|window|ids]
+// ./rtree_cpu_baseline stop [addr]
+int queryServerMain(int argc, char **argv)
+{
+    const char *defaultAddr = "/tmp/rtree_query.sock";
+    if (argc >= 3 && strcmp(argv[1], "serve") == 0) {
+        int numRects;
+        Rect *rects = readRectsFromFile(argv[2], &numRects);
+        if (!rects) return EXIT_FAILURE;
+        Rect *copy = (Rect *)malloc((size_t)numRects * sizeof(Rect));
+        memcpy(copy, rects, (size_t)numRects * sizeof(Rect));
+        Node *root = createRTree_STR_2(copy, 0, numRects - 1);
+        int workers = argc >= 5 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        const char *addr = argc >= 4 ? argv[3] : defaultAddr;
+        printf("Serving %d rects on %s with %d workers\n", numRects, addr, workers);
+        fflush(stdout);
+        return runQueryServer(addr, root, rects, numRects, workers, -1) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc >= 3 && strcmp(argv[1], "client") == 0) {
+        int numQuery;
+        Rect *queries = readRectsFromFile(argv[2], &numQuery);
+        if (!queries) return EXIT_FAILURE;
+        int op = QOP_COUNT;
+        if (argc >= 7) op = strcmp(argv[6], "window") == 0 ? QOP_WINDOW : strcmp(argv[6], "ids") == 0 ? QOP_IDS : QOP_COUNT;
+        long long hits = runQueryClient(argc >= 4 ? argv[3] : defaultAddr, queries, numQuery, op,
+                                        argc >= 5 ? atoi(argv[4]) : 4, argc >= 6 ? atoi(argv[5]) : 32);
+        free(queries);
+        return hits < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (argc >= 2 && strcmp(argv[1], "stop") == 0)
+        return sendServerShutdown(argc >= 3 ? argv[2] : defaultAddr) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    fprintf(stderr, "usage: %s serve <data.csv> [addr] [workers]\n"
+                    "       %s client <queries.csv> [addr] [connections] [depth] [count|window|ids]\n"
+                    "       %s stop [addr]\n"
+                    "       %s scaling <data.csv> <queries.csv> [maxThreads] [all|none|compact|scatter|cores|cpu-list]...\n"
+                    "       %s bench <out.json> [baseline.json]\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,383 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "rtree.h"
+
+// ---------------- Spatially sharded index ----------------
+//
+// createShardSet cuts the data into numShards STR tiles: ceil(sqrt(numShards))
+// vertical slices by X center, each split by Y center into as many shards as
+// it was given, all tiles holding about the same number of rects. Every shard
+// is a child process running runQueryServer on its own Unix socket, so the
+// shards share nothing but the wire protocol of server.c.
+//
+// The coordinator keeps the MBR of each shard's data. shardedQuery sends a
+// query only to the shards whose MBR it overlaps, with one thread and one
+// pipelined connection per shard, and sums the per-shard counts. Each rect
+// lives in exactly one shard, so the sums are exact even where shard MBRs
+// overlap. With QOP_IDS the shard-local ids are mapped back to positions in
+// the rect array given to createShardSet.
+
+#define SHARD_WINDOW 512
+
+typedef struct {
+    Rect r;
+    int id;
+} ShardItem;
+
+struct ShardSet {
+    int numShards;
+    pid_t *pids;
+    char (*addrs)[64];
+    MBR *mbrs;
+    int **globalIds;          // shard-local id -> input position
+    int *sizes;
+    int *fds;
+};
+
+typedef struct {
+    ShardSet *set;
+    int shard;
+    const Rect *queries;
+    const int *route;         // queries sent to this shard
+    int numRoute;
+    int op;
+    int *counts;
+    ShardIdSink sink;
+    void *user;
+    int failed;
+} ShardCall;
+
+static int cmpItemX(const void *A, const void *B)
+{
+    const ShardItem *a = (const ShardItem *)A, *b = (const ShardItem *)B;
+    long ca = (long)a->r.xmin + a->r.xmax, cb = (long)b->r.xmin + b->r.xmax;
+    return (ca > cb) - (ca < cb);
+}
+
+static int cmpItemY(const void *A, const void *B)
+{
+    const ShardItem *a = (const ShardItem *)A, *b = (const ShardItem *)B;
+    long ca = (long)a->r.ymin + a->r.ymax, cb = (long)b->r.ymin + b->r.ymax;
+    return (ca > cb) - (ca < cb);
+}
+
+// STR tiling of rects into numShards groups; start[s] .. start[s + 1] of
+// the returned array belong to shard s.
+static ShardItem *partitionShards(const Rect *rects, int n, int numShards, int *start)
+{
+    ShardItem *items = (ShardItem *)malloc((size_t)n * sizeof(ShardItem));
+    if (!items) {
+        perror("Unable to allocate shard partition");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) items[i] = (ShardItem){rects[i], i};
+    qsort(items, (size_t)n, sizeof(ShardItem), cmpItemX);
+
+    int slices = (int)ceil(sqrt((double)numShards));
+    int shard = 0;
+    for (int s = 0; s < slices; s++) {
+        int k = numShards / slices + (s < numShards % slices);
+        int lo = (int)((long long)n * shard / numShards);
+        int hi = (int)((long long)n * (shard + k) / numShards);
+        qsort(items + lo, (size_t)(hi - lo), sizeof(ShardItem), cmpItemY);
+        for (int j = 0; j < k; j++) start[shard + j] = (int)((long long)n * (shard + j) / numShards);
+        shard += k;
+    }
+    start[numShards] = n;
+    return items;
+}
+
+// Fork one query server per shard; returns once every shard listens.
+ShardSet *createShardSet(const Rect *rects, int numRects, int numShards, int workersPerShard)
+{
+    if (numShards > numRects) numShards = numRects > 0 ? numRects : 1;
+    ShardSet *set = (ShardSet *)calloc(1, sizeof(ShardSet));
+    int *start = (int *)malloc((size_t)(numShards + 1) * sizeof(int));
+    if (!set || !start) {
+        perror("Unable to allocate shard set");
+        exit(EXIT_FAILURE);
+    }
+    set->numShards = numShards;
+    set->pids = (pid_t *)malloc((size_t)numShards * sizeof(pid_t));
+    set->addrs = (char (*)[64])malloc((size_t)numShards * sizeof(*set->addrs));
+    set->mbrs = (MBR *)malloc((size_t)numShards * sizeof(MBR));
+    set->globalIds = (int **)malloc((size_t)numShards * sizeof(int *));
+    set->sizes = (int *)malloc((size_t)numShards * sizeof(int));
+    set->fds = (int *)malloc((size_t)numShards * sizeof(int));
+    if (!set->pids || !set->addrs || !set->mbrs || !set->globalIds || !set->sizes || !set->fds) {
+        perror("Unable to allocate shard set");
+        exit(EXIT_FAILURE);
+    }
+    ShardItem *items = partitionShards(rects, numRects, numShards, start);
+
+    for (int s = 0; s < numShards; s++) {
+        int n = start[s + 1] - start[s];
+        Rect *shardRects = (Rect *)malloc((size_t)(n > 0 ? n : 1) * sizeof(Rect));
+        set->globalIds[s] = (int *)malloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+        if (!shardRects || !set->globalIds[s]) {
+            perror("Unable to allocate shard rects");
+            exit(EXIT_FAILURE);
+        }
+        MBR m = {0, 0, -1, -1};
+        for (int i = 0; i < n; i++) {
+            shardRects[i] = items[start[s] + i].r;
+            set->globalIds[s][i] = items[start[s] + i].id;
+            if (i == 0) {
+                m = shardRects[i];
+            } else {
+                if (shardRects[i].xmin < m.xmin) m.xmin = shardRects[i].xmin;
+                if (shardRects[i].ymin < m.ymin) m.ymin = shardRects[i].ymin;
+                if (shardRects[i].xmax > m.xmax) m.xmax = shardRects[i].xmax;
+                if (shardRects[i].ymax > m.ymax) m.ymax = shardRects[i].ymax;
+            }
+        }
+        set->mbrs[s] = m;
+        set->sizes[s] = n;
+        snprintf(set->addrs[s], sizeof(set->addrs[s]), "/tmp/rtree_shard_%d_%d.sock", (int)getpid(), s);
+
+        int ready[2];
+        if (pipe(ready) != 0) {
+            perror("Unable to create shard pipe");
+            exit(EXIT_FAILURE);
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Unable to fork shard");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            close(ready[0]);
+            for (int prev = 0; prev < s; prev++) close(set->fds[prev]);
+            // The shard server answers ids as positions in its own rect array
+            Rect *build = (Rect *)malloc((size_t)(n > 0 ? n : 1) * sizeof(Rect));
+            memcpy(build, shardRects, (size_t)n * sizeof(Rect));
+            Node *root = createRTree_STR_2(build, 0, n - 1);
+            int rc = runQueryServer(set->addrs[s], root, shardRects, n, workersPerShard, ready[1]);
+            _exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(ready[1]);
+        char ok;
+        if (read(ready[0], &ok, 1) != 1) {
+            fprintf(stderr, "Shard %d failed to start\n", s);
+            exit(EXIT_FAILURE);
+        }
+        close(ready[0]);
+        set->pids[s] = pid;
+        free(shardRects);
+        set->fds[s] = queryServerConnect(set->addrs[s]);
+        if (set->fds[s] < 0) {
+            fprintf(stderr, "Unable to connect to shard %d\n", s);
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(items);
+    free(start);
+    return set;
+}
+
+int shardCount(const ShardSet *set)
+{
+    return set->numShards;
+}
+
+// Number of shards a query is sent to.
+int shardFanout(const ShardSet *set, Rect q)
+{
+    int f = 0;
+    for (int s = 0; s < set->numShards; s++)
+        if (set->sizes[s] > 0 && isOverlap_inline(&set->mbrs[s], q)) f++;
+    return f;
+}
+
+static void *shard_call(void *arg)
+{
+    ShardCall *c = (ShardCall *)arg;
+    ShardSet *set = c->set;
+    int fd = set->fds[c->shard];
+    SockReader *rd = (SockReader *)malloc(sizeof(SockReader));
+    QueryRequest *out = (QueryRequest *)malloc(SHARD_WINDOW * sizeof(QueryRequest));
+    if (!rd || !out) {
+        perror("Unable to allocate shard call buffers");
+        exit(EXIT_FAILURE);
+    }
+    rd->fd = fd;
+    rd->pos = rd->len = 0;
+    const int *ids = set->globalIds[c->shard];
+    for (int base = 0; base < c->numRoute && !c->failed; base += SHARD_WINDOW) {
+        int n = c->numRoute - base < SHARD_WINDOW ? c->numRoute - base : SHARD_WINDOW;
+        for (int i = 0; i < n; i++) {
+            int q = c->route[base + i];
+            out[i] = (QueryRequest){.id = (uint32_t)q, .op = (uint16_t)c->op, .window = c->queries[q]};
+        }
+        if (sockWriteAll(fd, out, (size_t)n * sizeof(QueryRequest)) != 0) {
+            c->failed = 1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            QueryReply rep;
+            if (sockReaderGet(rd, &rep, sizeof(rep)) != 0) {
+                c->failed = 1;
+                break;
+            }
+            __atomic_fetch_add(&c->counts[rep.id], (int)rep.count, __ATOMIC_RELAXED);
+            for (uint32_t k = 0; k < rep.returned; k++) {
+                uint32_t local;
+                if (sockReaderGet(rd, &local, sizeof(local)) != 0) {
+                    c->failed = 1;
+                    break;
+                }
+                if (c->sink) c->sink(c->user, (int)rep.id, local < (uint32_t)set->sizes[c->shard] ? ids[local] : -1);
+            }
+            if (rep.status) c->failed = 1;
+        }
+    }
+    free(rd);
+    free(out);
+    return NULL;
+}
+
+// Scatter queries to the shards they overlap and gather the counts into
+// counts[0 .. numQuery). op is QOP_COUNT or QOP_IDS; with QOP_IDS every hit is
+// passed to sink (from the per-shard threads, so concurrently). Returns the
+// total count, or -1 if a shard failed or truncated a reply.
+long long shardedQuery(ShardSet *set, const Rect *queries, int numQuery, int op, int *counts,
+                       ShardIdSink sink, void *user)
+{
+    int S = set->numShards;
+    int **route = (int **)malloc((size_t)S * sizeof(int *));
+    int *numRoute = (int *)calloc((size_t)S, sizeof(int));
+    ShardCall *calls = (ShardCall *)calloc((size_t)S, sizeof(ShardCall));
+    pthread_t *threads = (pthread_t *)malloc((size_t)S * sizeof(pthread_t));
+    if (!route || !numRoute || !calls || !threads) {
+        perror("Unable to allocate shard routes");
+        exit(EXIT_FAILURE);
+    }
+    for (int s = 0; s < S; s++) {
+        route[s] = (int *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(int));
+        if (!route[s]) {
+            perror("Unable to allocate shard routes");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int q = 0; q < numQuery; q++) {
+        counts[q] = 0;
+        for (int s = 0; s < S; s++)
+            if (set->sizes[s] > 0 && isOverlap_inline(&set->mbrs[s], queries[q])) route[s][numRoute[s]++] = q;
+    }
+    for (int s = 0; s < S; s++) {
+        calls[s] = (ShardCall){.set = set, .shard = s, .queries = queries, .route = route[s],
+                               .numRoute = numRoute[s], .op = op, .counts = counts, .sink = sink, .user = user};
+        pthread_create(&threads[s], NULL, shard_call, &calls[s]);
+    }
+    int failed = 0;
+    for (int s = 0; s < S; s++) {
+        pthread_join(threads[s], NULL);
+        failed |= calls[s].failed;
+        free(route[s]);
+    }
+    free(route);
+    free(numRoute);
+    free(calls);
+    free(threads);
+    if (failed) return -1;
+    long long total = 0;
+    for (int q = 0; q < numQuery; q++) total += counts[q];
+    return total;
+}
+
+void destroyShardSet(ShardSet *set)
+{
+    for (int s = 0; s < set->numShards; s++) {
+        close(set->fds[s]);
+        sendServerShutdown(set->addrs[s]);
+        waitpid(set->pids[s], NULL, 0);
+        free(set->globalIds[s]);
+    }
+    free(set->pids);
+    free(set->addrs);
+    free(set->mbrs);
+    free(set->globalIds);
+    free(set->sizes);
+    free(set->fds);
+    free(set);
+}
+
+// ---- benchmark ----
+
+typedef struct {
+    const Rect *rects;
+    const Rect *queries;
+    int numRects;
+    long long bad;
+} IdCheck;
+
+static void checkId(void *user, int query, int id)
+{
+    IdCheck *c = (IdCheck *)user;
+    if (id < 0 || id >= c->numRects || !isOverlap_inline(&c->rects[id], c->queries[query]))
+        __atomic_fetch_add(&c->bad, 1, __ATOMIC_RELAXED);
+}
+
+// Throughput against shard count, then queries inside one shard against
+// queries that cross shard boundaries, timed separately.
+void shardBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, long long expected)
+{
+    static const int shardCounts[] = {1, 2, 4, 8};
+    int *counts = (int *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(int));
+    Rect *single = (Rect *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(Rect));
+    Rect *cross = (Rect *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(Rect));
+    if (!counts || !single || !cross) {
+        perror("Unable to allocate shard benchmark buffers");
+        exit(EXIT_FAILURE);
+    }
+    int ok = 1;
+    printf("\n[Sharded index] one server process per shard, scatter-gather over Unix sockets\n");
+    printf("%6s %10s %12s %9s %12s %12s %14s\n", "shards", "time (s)", "queries/s", "fan-out",
+           "cross share", "cross us/q", "single us/q");
+    for (size_t k = 0; k < sizeof(shardCounts) / sizeof(shardCounts[0]); k++) {
+        ShardSet *set = createShardSet(rects, numRects, shardCounts[k], 1);
+        long long sent = 0;
+        int numSingle = 0, numCross = 0;
+        for (int q = 0; q < numQuery; q++) {
+            int f = shardFanout(set, queries[q]);
+            sent += f;
+            if (f > 1) cross[numCross++] = queries[q];
+            else single[numSingle++] = queries[q];
+        }
+        double t0 = nowSeconds();
+        long long total = shardedQuery(set, queries, numQuery, QOP_COUNT, counts, NULL, NULL);
+        double dt = nowSeconds() - t0;
+        ok &= total == expected;
+
+        t0 = nowSeconds();
+        shardedQuery(set, single, numSingle, QOP_COUNT, counts, NULL, NULL);
+        double singleTime = nowSeconds() - t0;
+        t0 = nowSeconds();
+        shardedQuery(set, cross, numCross, QOP_COUNT, counts, NULL, NULL);
+        double crossTime = nowSeconds() - t0;
+
+        // Ids come back as input positions and must overlap their query
+        int sample = numQuery < 1000 ? numQuery : 1000;
+        IdCheck check = {rects, queries, numRects, 0};
+        long long idHits = shardedQuery(set, queries, sample, QOP_IDS, counts, checkId, &check);
+        ok &= idHits >= 0 && check.bad == 0;
+
+        printf("%6d %10.4f %12.0f %9.2f %11.1f%% %12.1f %14.1f\n", shardCounts[k], dt,
+               numQuery / dt, numQuery ? (double)sent / numQuery : 0.0,
+               numQuery ? 100.0 * numCross / numQuery : 0.0,
+               numCross ? crossTime * 1e6 / numCross : 0.0, numSingle ? singleTime * 1e6 / numSingle : 0.0);
+        destroyShardSet(set);
+    }
+    free(counts);
+    free(single);
+    free(cross);
+    printf("%s Sharded results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+}
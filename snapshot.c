@@ -0,0 +1,565 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "rtree.h"
+
+// ---------------- Copy-on-write snapshots with epoch reclamation ----------------
+//
+// An RTreeHandle owns a tree that can be updated while queries run on it.
+// Published nodes are never modified: an insert or delete copies the nodes on
+// its root-to-leaf path, links the copies to the untouched subtrees, and
+// publishes the new root with one atomic store. A reader simply loads the
+// root and runs searchRTree on whatever version it got, without any lock.
+//
+// Replaced path nodes are retired, not freed. Readers announce the global
+// epoch they started in; a writer tags retired nodes with the epoch current
+// at publication and then advances the epoch. A retired node is freed once
+// every active reader announced a later epoch, because such readers can only
+// have loaded a root published after the node was unlinked.
+//
+// Writers are serialized by a mutex; readers never touch it.
+//
+// A reading thread claims a free epoch slot on registration and gives it
+// back when it unregisters, so slots are reused by later threads. There are
+// EPOCH_MAX_READERS slots, or one per online CPU plus one if that is more.
+
+#define EPOCH_MAX_READERS 128
+
+typedef struct {
+    _Atomic unsigned long epoch;   // 0 = not in a read section
+    _Atomic int inUse;             // claimed by a registered reader
+    char pad[64 - sizeof(unsigned long) - sizeof(int)];
+} EpochSlot;
+
+typedef struct {
+    Node *node;
+    unsigned long epoch;
+} Retired;
+
+struct RTreeHandle {
+    _Atomic(Node *) root;
+    _Atomic unsigned long epoch;
+    _Atomic int numReaders;        // slots ever claimed: reclaim scans [0, numReaders)
+    pthread_mutex_t writeLock;
+    Retired *retired;
+    int numRetired, capRetired;
+    long long numFreed;
+    int numSlots;
+    EpochSlot *slots;
+};
+
+RTreeHandle *createRTreeHandle(Node *root)
+{
+    RTreeHandle *h = (RTreeHandle *)calloc(1, sizeof(RTreeHandle));
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN) + 1;
+    int numSlots = cpus > EPOCH_MAX_READERS ? cpus : EPOCH_MAX_READERS;
+    EpochSlot *slots = (EpochSlot *)aligned_alloc(64, (size_t)numSlots * sizeof(EpochSlot));
+    if (!h || !slots) {
+        perror("Unable to allocate tree handle");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&h->root, root);
+    atomic_init(&h->epoch, 1);
+    atomic_init(&h->numReaders, 0);
+    h->numSlots = numSlots;
+    h->slots = slots;
+    for (int i = 0; i < numSlots; i++) {
+        atomic_init(&h->slots[i].epoch, 0);
+        atomic_init(&h->slots[i].inUse, 0);
+    }
+    pthread_mutex_init(&h->writeLock, NULL);
+    return h;
+}
+
+// Every reading thread takes one free slot until snapshotUnregisterReader.
+int snapshotRegisterReader(RTreeHandle *h)
+{
+    for (int slot = 0; slot < h->numSlots; slot++) {
+        int idle = 0;
+        if (atomic_load(&h->slots[slot].inUse) || !atomic_compare_exchange_strong(&h->slots[slot].inUse, &idle, 1))
+            continue;
+        // Make sure reclaim scans this slot from now on
+        int seen = atomic_load(&h->numReaders);
+        while (seen <= slot && !atomic_compare_exchange_weak(&h->numReaders, &seen, slot + 1)) {}
+        return slot;
+    }
+    fprintf(stderr, "Too many concurrent snapshot readers (max %d)\n", h->numSlots);
+    exit(EXIT_FAILURE);
+}
+
+// Give the slot back; the thread must not be in a read section.
+void snapshotUnregisterReader(RTreeHandle *h, int slot)
+{
+    atomic_store(&h->slots[slot].epoch, 0);
+    atomic_store(&h->slots[slot].inUse, 0);
+}
+
+// Enter a read section and return the current root. The tree reachable from it
+// stays valid until snapshotRelease.
+Node *snapshotAcquire(RTreeHandle *h, int slot)
+{
+    atomic_store(&h->slots[slot].epoch, atomic_load(&h->epoch));
+    return atomic_load(&h->root);
+}
+
+void snapshotRelease(RTreeHandle *h, int slot)
+{
+    atomic_store_explicit(&h->slots[slot].epoch, 0, memory_order_release);
+}
+
+// Current root for single-threaded use (no read section).
+Node *snapshotRoot(RTreeHandle *h)
+{
+    return atomic_load(&h->root);
+}
+
+// ---- retirement ----
+
+static void retireNode(RTreeHandle *h, Node *n)
+{
+    if (h->numRetired == h->capRetired) {
+        h->capRetired = h->capRetired ? h->capRetired * 2 : 256;
+        h->retired = (Retired *)realloc(h->retired, (size_t)h->capRetired * sizeof(Retired));
+        if (!h->retired) {
+            perror("Unable to grow retired list");
+            exit(EXIT_FAILURE);
+        }
+    }
+    h->retired[h->numRetired].node = n;
+    h->retired[h->numRetired].epoch = 0;   // stamped at publication
+    h->numRetired++;
+}
+
+// Frees only the node and its own array; children are shared with newer versions.
+static void freeRetiredNode(Node *n)
+{
+    if (n->isLeaf) free(n->rects);
+    else free(n->children);
+    free(n);
+}
+
+// Free every retired node no active reader can still reach. Writer lock held.
+static void reclaim(RTreeHandle *h)
+{
+    unsigned long minActive = atomic_load(&h->epoch);
+    int readers = atomic_load(&h->numReaders);
+    for (int i = 0; i < readers; i++) {
+        unsigned long e = atomic_load(&h->slots[i].epoch);
+        if (e != 0 && e < minActive) minActive = e;
+    }
+    int kept = 0;
+    for (int i = 0; i < h->numRetired; i++) {
+        if (h->retired[i].epoch < minActive) {
+            freeRetiredNode(h->retired[i].node);
+            h->numFreed++;
+        } else {
+            h->retired[kept++] = h->retired[i];
+        }
+    }
+    h->numRetired = kept;
+}
+
+// Publish `newRoot`, stamp the nodes retired by this update, advance the epoch.
+static void publish(RTreeHandle *h, Node *newRoot, int firstRetired)
+{
+    atomic_store(&h->root, newRoot);
+    unsigned long e = atomic_fetch_add(&h->epoch, 1);
+    for (int i = firstRetired; i < h->numRetired; i++)
+        h->retired[i].epoch = e;
+    reclaim(h);
+}
+
+// ---- path copying ----
+
+static void recomputeMBR(Node *n)
+{
+    initMBR(&n->mbr);
+    if (n->isLeaf) {
+        for (int i = 0; i < n->count; i++) updateMBRWithRect(&n->mbr, n->rects[i]);
+    } else {
+        for (int i = 0; i < n->count; i++) n->mbr = unionJoin(&n->mbr, &n->children[i]->mbr);
+    }
+}
+
+static Node *newLeaf(const Rect *rects, int count)
+{
+    Node *n = (Node *)malloc(sizeof(Node));
+    n->isLeaf = 1;
+    n->count = count;
+    n->rects = (Rect *)malloc((size_t)(count > 0 ? count : 1) * sizeof(Rect));
+    memcpy(n->rects, rects, (size_t)count * sizeof(Rect));
+    recomputeMBR(n);
+    return n;
+}
+
+static Node *newInternal(Node *const *children, int count)
+{
+    Node *n = (Node *)malloc(sizeof(Node));
+    n->isLeaf = 0;
+    n->count = count;
+    n->children = (Node **)malloc((size_t)count * sizeof(Node *));
+    memcpy(n->children, children, (size_t)count * sizeof(Node *));
+    recomputeMBR(n);
+    return n;
+}
+
+static int cmpChildX(const void *A, const void *B)
+{
+    const Node *a = *(Node *const *)A, *b = *(Node *const *)B;
+    long ca = (long)a->mbr.xmin + a->mbr.xmax, cb = (long)b->mbr.xmin + b->mbr.xmax;
+    return (ca > cb) - (ca < cb);
+}
+
+static int cmpChildY(const void *A, const void *B)
+{
+    const Node *a = *(Node *const *)A, *b = *(Node *const *)B;
+    long ca = (long)a->mbr.ymin + a->mbr.ymax, cb = (long)b->mbr.ymin + b->mbr.ymax;
+    return (ca > cb) - (ca < cb);
+}
+
+// Split an overfull fresh (unpublished) node in place into itself and a new
+// sibling, halving along the longer side of its MBR.
+static Node *splitNode(Node *n)
+{
+    int alongX = (long)n->mbr.xmax - n->mbr.xmin >= (long)n->mbr.ymax - n->mbr.ymin;
+    int half = n->count / 2;
+    Node *sib;
+    if (n->isLeaf) {
+        qsort(n->rects, (size_t)n->count, sizeof(Rect), alongX ? compareByXCenter : compareByYCenter);
+        sib = newLeaf(n->rects + half, n->count - half);
+    } else {
+        qsort(n->children, (size_t)n->count, sizeof(Node *), alongX ? cmpChildX : cmpChildY);
+        sib = newInternal(n->children + half, n->count - half);
+    }
+    n->count = half;
+    recomputeMBR(n);
+    return sib;
+}
+
+static long long enlargement(const MBR *m, Rect r, long long *area)
+{
+    long long w = (long long)m->xmax - m->xmin, hgt = (long long)m->ymax - m->ymin;
+    MBR u = unionJoin((MBR *)m, &r);
+    *area = w * hgt;
+    return ((long long)u.xmax - u.xmin) * ((long long)u.ymax - u.ymin) - *area;
+}
+
+// Returns the copy of `n` with `r` added; an overflow split returns the new
+// sibling through *split.
+static Node *cowInsert(RTreeHandle *h, Node *n, Rect r, Node **split)
+{
+    *split = NULL;
+    Node *copy;
+    if (n->isLeaf) {
+        copy = (Node *)malloc(sizeof(Node));
+        copy->isLeaf = 1;
+        copy->count = n->count + 1;
+        copy->rects = (Rect *)malloc((size_t)copy->count * sizeof(Rect));
+        memcpy(copy->rects, n->rects, (size_t)n->count * sizeof(Rect));
+        copy->rects[n->count] = r;
+        copy->mbr = n->mbr;
+        updateMBRWithRect(&copy->mbr, r);
+        if (copy->count > BUNDLEFACTOR) *split = splitNode(copy);
+    } else {
+        // Least enlargement, ties by smallest area
+        int best = 0;
+        long long bestEnl = 0, bestArea = 0;
+        for (int i = 0; i < n->count; i++) {
+            long long area, enl = enlargement(&n->children[i]->mbr, r, &area);
+            if (i == 0 || enl < bestEnl || (enl == bestEnl && area < bestArea)) {
+                best = i;
+                bestEnl = enl;
+                bestArea = area;
+            }
+        }
+        Node *childSplit;
+        Node *child = cowInsert(h, n->children[best], r, &childSplit);
+
+        copy = (Node *)malloc(sizeof(Node));
+        copy->isLeaf = 0;
+        copy->count = n->count + (childSplit ? 1 : 0);
+        copy->children = (Node **)malloc((size_t)copy->count * sizeof(Node *));
+        memcpy(copy->children, n->children, (size_t)n->count * sizeof(Node *));
+        copy->children[best] = child;
+        if (childSplit) copy->children[n->count] = childSplit;
+        recomputeMBR(copy);
+        if (copy->count > FANOUT) *split = splitNode(copy);
+    }
+    retireNode(h, n);
+    return copy;
+}
+
+void rtreeInsertCOW(RTreeHandle *h, Rect r)
+{
+    pthread_mutex_lock(&h->writeLock);
+    int firstRetired = h->numRetired;
+    Node *root = atomic_load(&h->root);
+    Node *newRoot;
+    if (!root) {
+        newRoot = newLeaf(&r, 1);
+    } else {
+        Node *split;
+        newRoot = cowInsert(h, root, r, &split);
+        if (split) {
+            Node *pair[2] = {newRoot, split};
+            newRoot = newInternal(pair, 2);
+        }
+    }
+    publish(h, newRoot, firstRetired);
+    pthread_mutex_unlock(&h->writeLock);
+}
+
+static inline int mbrCoversRect(const MBR *m, Rect r)
+{
+    return m->xmin <= r.xmin && m->ymin <= r.ymin && m->xmax >= r.xmax && m->ymax >= r.ymax;
+}
+
+static inline int sameRect(Rect a, Rect b)
+{
+    return a.xmin == b.xmin && a.ymin == b.ymin && a.xmax == b.xmax && a.ymax == b.ymax;
+}
+
+// Remove one rect equal to `r` below `n`. Returns 1 if found; *out is the
+// copy of `n` without it, or NULL if `n` became empty.
+static int cowDelete(RTreeHandle *h, Node *n, Rect r, Node **out)
+{
+    if (!mbrCoversRect(&n->mbr, r)) return 0;
+
+    if (n->isLeaf) {
+        for (int i = 0; i < n->count; i++) {
+            if (!sameRect(n->rects[i], r)) continue;
+            if (n->count == 1) {
+                *out = NULL;
+            } else {
+                Node *copy = (Node *)malloc(sizeof(Node));
+                copy->isLeaf = 1;
+                copy->count = n->count - 1;
+                copy->rects = (Rect *)malloc((size_t)copy->count * sizeof(Rect));
+                memcpy(copy->rects, n->rects, (size_t)i * sizeof(Rect));
+                memcpy(copy->rects + i, n->rects + i + 1, (size_t)(n->count - i - 1) * sizeof(Rect));
+                recomputeMBR(copy);
+                *out = copy;
+            }
+            retireNode(h, n);
+            return 1;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < n->count; i++) {
+        Node *child;
+        if (!cowDelete(h, n->children[i], r, &child)) continue;
+        if (!child && n->count == 1) {
+            *out = NULL;
+        } else {
+            Node *copy = (Node *)malloc(sizeof(Node));
+            copy->isLeaf = 0;
+            copy->count = child ? n->count : n->count - 1;
+            copy->children = (Node **)malloc((size_t)copy->count * sizeof(Node *));
+            int k = 0;
+            for (int j = 0; j < n->count; j++) {
+                if (j == i) {
+                    if (child) copy->children[k++] = child;
+                } else {
+                    copy->children[k++] = n->children[j];
+                }
+            }
+            recomputeMBR(copy);
+            *out = copy;
+        }
+        retireNode(h, n);
+        return 1;
+    }
+    return 0;
+}
+
+// Delete one rect equal to `r`. Returns 1 if it was present.
+int rtreeDeleteCOW(RTreeHandle *h, Rect r)
+{
+    pthread_mutex_lock(&h->writeLock);
+    int firstRetired = h->numRetired;
+    Node *root = atomic_load(&h->root);
+    Node *newRoot = NULL;
+    int found = root ? cowDelete(h, root, r, &newRoot) : 0;
+    if (found) {
+        // Collapse a fresh root copy left with a single child
+        if (newRoot && !newRoot->isLeaf && newRoot->count == 1) {
+            Node *only = newRoot->children[0];
+            free(newRoot->children);
+            free(newRoot);
+            newRoot = only;
+        }
+        publish(h, newRoot, firstRetired);
+    }
+    pthread_mutex_unlock(&h->writeLock);
+    return found;
+}
+
+static void retireTree(RTreeHandle *h, Node *n)
+{
+    if (!n) return;
+    if (!n->isLeaf)
+        for (int i = 0; i < n->count; i++) retireTree(h, n->children[i]);
+    retireNode(h, n);
+}
+
+// Publish a separately built tree; every node of the old one is retired.
+void snapshotReplaceRoot(RTreeHandle *h, Node *newRoot)
+{
+    pthread_mutex_lock(&h->writeLock);
+    int firstRetired = h->numRetired;
+    retireTree(h, atomic_load(&h->root));
+    publish(h, newRoot, firstRetired);
+    pthread_mutex_unlock(&h->writeLock);
+}
+
+long long snapshotFreedNodes(RTreeHandle *h)
+{
+    pthread_mutex_lock(&h->writeLock);
+    long long n = h->numFreed;
+    pthread_mutex_unlock(&h->writeLock);
+    return n;
+}
+
+int snapshotPendingNodes(RTreeHandle *h)
+{
+    pthread_mutex_lock(&h->writeLock);
+    int n = h->numRetired;
+    pthread_mutex_unlock(&h->writeLock);
+    return n;
+}
+
+// Free the current tree and everything still retired. No readers may be active.
+void destroyRTreeHandle(RTreeHandle *h)
+{
+    if (!h) return;
+    for (int i = 0; i < h->numRetired; i++)
+        freeRetiredNode(h->retired[i].node);
+    free(h->retired);
+    freeRTree(atomic_load(&h->root));
+    pthread_mutex_destroy(&h->writeLock);
+    free(h->slots);
+    free(h);
+}
+
+// ---- benchmark: readers running while a writer updates ----
+
+typedef struct {
+    RTreeHandle *h;
+    const Rect *queries;
+    int numQuery;
+    int start;
+    int minPasses;            // queries to answer at least, in passes over the set
+    _Atomic int *stop;        // set once the writer is done
+    long long answered;
+    char pad[64];
+} SnapReader;
+
+typedef struct {
+    RTreeHandle *h;
+    const Rect *rects;
+    int numRects;
+    int numUpdates;
+    double seconds;
+} SnapWriter;
+
+static void *snap_reader(void *arg)
+{
+    SnapReader *r = (SnapReader *)arg;
+    int slot = snapshotRegisterReader(r->h);
+    long long done = 0, sink = 0;
+    int i = r->start;
+    while (done < (long long)r->minPasses * r->numQuery || !atomic_load(r->stop)) {
+        Node *root = snapshotAcquire(r->h, slot);
+        sink += searchRTree(root, r->queries[i], i);
+        snapshotRelease(r->h, slot);
+        if (++i == r->numQuery) i = 0;
+        done++;
+        if (atomic_load(r->stop) && done >= r->numQuery) break;
+    }
+    snapshotUnregisterReader(r->h, slot);
+    r->answered = done + (sink < 0);
+    return NULL;
+}
+
+static void *snap_writer(void *arg)
+{
+    SnapWriter *w = (SnapWriter *)arg;
+    double t0 = nowSeconds();
+    // Insert copies of existing rects, then delete the same values again
+    for (int i = 0; i < w->numUpdates; i++)
+        rtreeInsertCOW(w->h, w->rects[(long long)i * w->numRects / w->numUpdates]);
+    for (int i = 0; i < w->numUpdates; i++)
+        rtreeDeleteCOW(w->h, w->rects[(long long)i * w->numRects / w->numUpdates]);
+    w->seconds = nowSeconds() - t0;
+    return NULL;
+}
+
+static double runReaders(RTreeHandle *h, const Rect *queries, int numQuery, int numThreads,
+                         SnapWriter *writer, long long *answered)
+{
+    pthread_t threads[numThreads + 1];
+    SnapReader *readers = (SnapReader *)calloc((size_t)numThreads, sizeof(SnapReader));
+    _Atomic int stop;
+    atomic_init(&stop, writer ? 0 : 1);
+
+    double t0 = nowSeconds();
+    for (int t = 0; t < numThreads; t++) {
+        readers[t] = (SnapReader){
+            .h = h, .queries = queries, .numQuery = numQuery,
+            .start = (int)((long long)t * numQuery / numThreads),
+            .minPasses = 1, .stop = &stop};
+        pthread_create(&threads[t], NULL, snap_reader, &readers[t]);
+    }
+    if (writer) {
+        pthread_create(&threads[numThreads], NULL, snap_writer, writer);
+        pthread_join(threads[numThreads], NULL);
+        atomic_store(&stop, 1);
+    }
+    *answered = 0;
+    for (int t = 0; t < numThreads; t++) {
+        pthread_join(threads[t], NULL);
+        *answered += readers[t].answered;
+    }
+    double dt = nowSeconds() - t0;
+    free(readers);
+    return dt;
+}
+
+// Compare lock-free reader throughput with and without a concurrent writer,
+// then check the tree answers the query set as before (every insert was
+// undone by a delete).
+void snapshotBenchmark(Node *root, const Rect *rects, int numRects, const Rect *queries,
+                       int numQuery, int numThreads, long long expected)
+{
+    if (!root || numQuery <= 0 || numRects <= 0) return;
+    RTreeHandle *h = createRTreeHandle(cloneRTree(root));
+    int numUpdates = numRects < 20000 ? numRects : 20000;
+    long long answered;
+
+    printf("\n=== Concurrent updates (copy-on-write snapshots, %d readers) ===\n", numThreads);
+    double t = runReaders(h, queries, numQuery, numThreads, NULL, &answered);
+    printf("Readers alone       : %.0f queries/s\n", answered / t);
+
+    SnapWriter w = {.h = h, .rects = rects, .numRects = numRects, .numUpdates = numUpdates};
+    t = runReaders(h, queries, numQuery, numThreads, &w, &answered);
+    printf("Readers with writer : %.0f queries/s\n", answered / t);
+    printf("Writer              : %d inserts + %d deletes in %.2f s (%.0f updates/s)\n",
+           numUpdates, numUpdates, w.seconds, 2.0 * numUpdates / w.seconds);
+    printf("Reclaimed nodes     : %lld freed, %d still retired\n",
+           snapshotFreedNodes(h), snapshotPendingNodes(h));
+
+    long long found = 0;
+    Node *cur = snapshotRoot(h);
+    for (int i = 0; i < numQuery; i++)
+        found += searchRTree(cur, queries[i], i);
+    if (found == expected)
+        printf("✅ Tree after insert+delete round trip matches the sequential results.\n");
+    else
+        printf("❌ Tree after insert+delete round trip: %lld overlaps, expected %lld\n", found, expected);
+    destroyRTreeHandle(h);
+}
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Common index interface ----------------
+//
+// A SpatialIndex is an engine's SpatialIndexOps table plus its private
+// state, so callers can build, count, report ids and size any engine the
+// same way. Ids are positions in the rect array given to build. Engines:
+//
+//   rtreeIndexOps     createRTree_STR_2 tree for counts; ids through a
+//                     FlatTree copy mapped back with flatTreeRectIds
+//   gridIndexOps      uniform grid (grid.c)
+//   quadtreeIndexOps  PR quadtree on rect centers (quadtree.c)
+//
+// spatialIndexSearch has the QuerySearchFn signature, so every engine runs
+// on the same QueryPool in engineBenchmark.
+
+typedef struct {
+    Node *root;
+    FlatTree *flat;
+    uint32_t *ids;
+    int numRects;
+} RTreeEngine;
+
+// ---- R-tree engine ----
+
+static void *rtreeEngineBuild(const Rect *rects, int n)
+{
+    RTreeEngine *e = (RTreeEngine *)calloc(1, sizeof(RTreeEngine));
+    Rect *copy = (Rect *)malloc((size_t)(n > 0 ? n : 1) * sizeof(Rect));
+    if (!e || !copy) {
+        perror("Unable to allocate R-tree engine");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, rects, (size_t)n * sizeof(Rect));
+    e->root = createRTree_STR_2(copy, 0, n - 1);
+    free(copy);
+    e->flat = createFlatTree(e->root, FLAT_BFS);
+    e->ids = flatTreeRectIds(e->flat, rects, n);
+    e->numRects = n;
+    return e;
+}
+
+static int rtreeEngineCount(const void *index, Rect q)
+{
+    return searchRTree(((const RTreeEngine *)index)->root, q, 0);
+}
+
+static int rtreeEngineReport(const void *index, Rect q, uint32_t *ids, int maxOut)
+{
+    const RTreeEngine *e = (const RTreeEngine *)index;
+    int n = searchFlatTree_collect(e->flat, q, ids, maxOut);
+    int stored = n < maxOut ? n : maxOut;
+    for (int i = 0; i < stored; i++) ids[i] = e->ids[ids[i]];
+    return n;
+}
+
+static size_t rtreeEngineBytes(const void *index)
+{
+    const RTreeEngine *e = (const RTreeEngine *)index;
+    return rtreeBytes(e->root) + flatTreeBytes(e->flat) + e->flat->numRects * sizeof(uint32_t);
+}
+
+static void rtreeEngineDescribe(const void *index, char *buf, size_t len)
+{
+    const RTreeEngine *e = (const RTreeEngine *)index;
+    snprintf(buf, len, "height %u, %u nodes, flat copy for ids", e->flat->height, e->flat->numNodes);
+}
+
+static void rtreeEngineDestroy(void *index)
+{
+    RTreeEngine *e = (RTreeEngine *)index;
+    freeRTree(e->root);
+    freeFlatTree(e->flat);
+    free(e->ids);
+    free(e);
+}
+
+const SpatialIndexOps rtreeIndexOps = {
+    "rtree", rtreeEngineBuild, rtreeEngineCount, rtreeEngineReport,
+    rtreeEngineBytes, rtreeEngineDescribe, rtreeEngineDestroy};
+
+// ---- interface ----
+
+SpatialIndex *buildSpatialIndex(const SpatialIndexOps *ops, const Rect *rects, int n)
+{
+    SpatialIndex *idx = (SpatialIndex *)malloc(sizeof(SpatialIndex));
+    if (!idx) {
+        perror("Unable to allocate spatial index");
+        exit(EXIT_FAILURE);
+    }
+    idx->ops = ops;
+    idx->impl = ops->build(rects, n);
+    return idx;
+}
+
+int spatialIndexSearch(const void *index, Rect q)
+{
+    const SpatialIndex *idx = (const SpatialIndex *)index;
+    return idx->ops->count(idx->impl, q);
+}
+
+int spatialIndexReport(const SpatialIndex *idx, Rect q, uint32_t *ids, int maxOut)
+{
+    return idx->ops->report(idx->impl, q, ids, maxOut);
+}
+
+size_t spatialIndexBytes(const SpatialIndex *idx)
+{
+    return idx->ops->bytes(idx->impl);
+}
+
+void freeSpatialIndex(SpatialIndex *idx)
+{
+    if (!idx) return;
+    idx->ops->destroy(idx->impl);
+    free(idx);
+}
+
+// ---- benchmark ----
+
+static int cmpU32(const void *A, const void *B)
+{
+    uint32_t a = *(const uint32_t *)A, b = *(const uint32_t *)B;
+    return (a > b) - (a < b);
+}
+
+// Build every engine on the same rects, run the queries through one shared
+// QueryPool, check counts and reported ids, and name the fastest engine.
+void engineBenchmark(const Rect *rects, int numRects, const Rect *queries, int numQuery, int numThreads,
+                     long long expected)
+{
+    const SpatialIndexOps *engines[] = {&rtreeIndexOps, &gridIndexOps, &quadtreeIndexOps};
+    int numEngines = (int)(sizeof(engines) / sizeof(engines[0]));
+    int *results = (int *)malloc((size_t)(numQuery > 0 ? numQuery : 1) * sizeof(int));
+    uint32_t *ids = (uint32_t *)malloc((size_t)(numRects > 0 ? numRects : 1) * sizeof(uint32_t));
+    if (!results || !ids) {
+        perror("Unable to allocate engine benchmark buffers");
+        exit(EXIT_FAILURE);
+    }
+    QueryPool *pool = createQueryPool(NULL, numThreads, 4096);
+    QueryCompletion sink[256];
+    int ok = 1, best = -1;
+    double bestTime = 0;
+
+    printf("\n[Index engines] %d threads on one shared pool\n", numThreads);
+    printf("%-9s %9s %9s %10s %12s %14s  %s\n", "engine", "build (s)", "MB", "query (s)", "queries/s",
+           "overlaps", "structure");
+    for (int k = 0; k < numEngines; k++) {
+        double t0 = nowSeconds();
+        SpatialIndex *idx = buildSpatialIndex(engines[k], rects, numRects);
+        double buildTime = nowSeconds() - t0;
+
+        t0 = nowSeconds();
+        uint32_t ticket = submitIndexQueries(pool, spatialIndexSearch, idx, queries, results, numQuery, 1000,
+                                             NULL, NULL);
+        long long hits = 0;
+        int n;
+        while ((n = waitCompletions(pool, sink, 256)) > 0)
+            for (int i = 0; i < n; i++) hits += sink[i].hits;
+        waitTicket(pool, ticket);
+        double queryTime = nowSeconds() - t0;
+        int engineOk = hits == expected;
+
+        // Reported ids: as many as the count, distinct, each overlapping
+        for (int q = 0; q < numQuery && engineOk; q += numQuery / 200 + 1) {
+            int c = spatialIndexReport(idx, queries[q], ids, numRects);
+            engineOk &= c == results[q];
+            qsort(ids, (size_t)c, sizeof(uint32_t), cmpU32);
+            for (int i = 0; i < c && engineOk; i++)
+                engineOk &= ids[i] < (uint32_t)numRects && (i == 0 || ids[i] != ids[i - 1]) &&
+                            isOverlap_inline(&rects[ids[i]], queries[q]);
+        }
+        char desc[128];
+        idx->ops->describe(idx->impl, desc, sizeof(desc));
+        printf("%-9s %9.3f %9.2f %10.4f %12.0f %14lld  %s%s\n", engines[k]->name, buildTime,
+               spatialIndexBytes(idx) / (1024.0 * 1024.0), queryTime, numQuery / queryTime, hits, desc,
+               engineOk ? "" : "  MISMATCH");
+        ok &= engineOk;
+        if (engineOk && (best < 0 || queryTime < bestTime)) {
+            best = k;
+            bestTime = queryTime;
+        }
+        freeSpatialIndex(idx);
+    }
+    destroyQueryPool(pool);
+    free(results);
+    free(ids);
+    if (best >= 0) printf("Fastest engine for these queries: %s\n", engines[best]->name);
+    printf("%s Engine results %s the sequential search\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+}
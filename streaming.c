@@ -0,0 +1,491 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rtree.h"
+
+// ---------------- Pipelined startup: streaming parse into STR slices ----------------
+//
+// The sequential startup reads the whole data file (counting lines, then
+// fscanf), bulk loads with createRTree_STR_2, and only then reads and
+// Z-sorts the queries. streamLoad overlaps these stages:
+//
+//   1. The data file is mapped and ~4096 evenly spaced lines are sampled to
+//      estimate the number of rects and the X-center quantiles that cut the
+//      data into the S vertical slices STR would use.
+//   2. Parser threads each take a byte range of the file, parse it block by
+//      block and append every rect to its slice bucket (one set of buckets
+//      per thread, so no locks). After each block a thread sorts what the
+//      block added to each bucket by Y center and records it as a run, so
+//      the sorting is done while the file is still being parsed. When its
+//      range is done, the thread seals its buckets.
+//   3. A parser that has sealed its buckets turns into a packer. Packers
+//      claim slices in order and wait until every parser has sealed the
+//      slice. Any line of the file can fall in any slice, so no slice is
+//      complete before the slowest parser is done. The packer then merges
+//      the slice's sorted runs with a min-heap and cuts it into leaves of
+//      BUNDLEFACTOR. group_nodes_STR builds the upper levels.
+//
+// Meanwhile another thread reads and Z-sorts the query file. The slices come
+// from sampled quantiles, so they hold about (not exactly) equal counts.
+
+#define STREAM_SAMPLES 4096
+#define STREAM_BLOCK_LINES 65536
+
+typedef struct {
+    Rect *rects;
+    int count, cap;
+    int *runStart;              // run r is [runStart[r], runStart[r + 1] or count)
+    int numRuns, runCap;
+} StreamBucket;
+
+typedef struct {
+    const Rect *next, *end;
+} RunCursor;
+
+typedef struct {
+    StreamBucket *buckets;      // [thread * numSlices + slice]
+    int numParsers, numSlices;
+    _Atomic int nextSlice;
+    Node ***sliceLeaves;        // leaves of every slice
+    int *sliceLeafCount;
+
+    pthread_mutex_t sealLock;
+    pthread_cond_t sealed;
+    int *pending;               // parsers that have not sealed each slice
+    int parsing;                // parsers with unsealed buckets
+    double parseDone;           // when the last bucket was sealed
+} PackArgs;
+
+typedef struct {
+    const char *data;
+    size_t lo, hi;              // byte range, both at line starts
+    const int *bounds;          // S - 1 X-center cut points
+    int numSlices;
+    StreamBucket *buckets;      // numSlices buckets of this thread
+    PackArgs *pack;
+    long long parsed;
+} ParseArgs;
+
+typedef struct {
+    const char *path;
+    Rect *queries;
+    int numQuery;
+    double seconds;
+} QueryLoadArgs;
+
+static const char *parseInt(const char *p, const char *end, int *v)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    if (p == end || *p < '0' || *p > '9') return NULL;
+    long x = 0;
+    while (p < end && *p >= '0' && *p <= '9') x = x * 10 + (*p++ - '0');
+    *v = (int)(neg ? -x : x);
+    return p;
+}
+
+// Parse "x1,y1,x2,y2" at p (normalized like readRectsFromFile). Returns the
+// start of the next line; *ok is 0 for a line that is not a rectangle.
+static const char *parseRectLine(const char *p, const char *end, Rect *r, int *ok)
+{
+    int v[4];
+    const char *q = p;
+    *ok = 1;
+    for (int i = 0; i < 4 && q; i++) {
+        q = parseInt(q, end, &v[i]);
+        if (q && i < 3) {
+            while (q < end && (*q == ' ' || *q == '\t')) q++;
+            q = (q < end && *q == ',') ? q + 1 : NULL;
+        }
+    }
+    if (!q) {
+        *ok = 0;
+        q = p;
+    } else {
+        r->xmin = v[0] < v[2] ? v[0] : v[2];
+        r->ymin = v[1] < v[3] ? v[1] : v[3];
+        r->xmax = v[0] > v[2] ? v[0] : v[2];
+        r->ymax = v[1] > v[3] ? v[1] : v[3];
+    }
+    const char *nl = memchr(q, '\n', (size_t)(end - q));
+    return nl ? nl + 1 : end;
+}
+
+static size_t nextLineStart(const char *data, size_t size, size_t pos)
+{
+    if (pos == 0) return 0;
+    const char *nl = memchr(data + pos - 1, '\n', size - pos + 1);
+    return nl ? (size_t)(nl - data) + 1 : size;
+}
+
+static int cmpInt(const void *A, const void *B)
+{
+    int a = *(const int *)A, b = *(const int *)B;
+    return (a > b) - (a < b);
+}
+
+static inline int sliceOf(const int *bounds, int numSlices, Rect r)
+{
+    int xc = (r.xmin + r.xmax) / 2;                 // same center as compareByXCenter
+    int lo = 0, hi = numSlices - 1;                 // first bound > xc
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (bounds[mid] > xc) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+static void bucketPush(StreamBucket *b, Rect r)
+{
+    if (b->count == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 1024;
+        b->rects = (Rect *)realloc(b->rects, (size_t)b->cap * sizeof(Rect));
+        if (!b->rects) {
+            perror("Unable to grow slice bucket");
+            exit(EXIT_FAILURE);
+        }
+    }
+    b->rects[b->count++] = r;
+}
+
+static void bucketAddRun(StreamBucket *b, int start)
+{
+    if (b->numRuns == b->runCap) {
+        b->runCap = b->runCap ? b->runCap * 2 : 16;
+        b->runStart = (int *)realloc(b->runStart, (size_t)b->runCap * sizeof(int));
+        if (!b->runStart) {
+            perror("Unable to grow run list");
+            exit(EXIT_FAILURE);
+        }
+    }
+    b->runStart[b->numRuns++] = start;
+}
+
+// Restore the min-heap of run heads below position i
+static void runSiftDown(RunCursor *heap, int n, int i)
+{
+    for (;;) {
+        int l = 2 * i + 1, m = i;
+        if (l < n && compareByYCenter(heap[l].next, heap[m].next) < 0) m = l;
+        if (l + 1 < n && compareByYCenter(heap[l + 1].next, heap[m].next) < 0) m = l + 1;
+        if (m == i) return;
+        RunCursor t = heap[i];
+        heap[i] = heap[m];
+        heap[m] = t;
+        i = m;
+    }
+}
+
+static void *pack_worker(void *arg);
+
+static void *parse_worker(void *arg)
+{
+    ParseArgs *a = (ParseArgs *)arg;
+    const char *p = a->data + a->lo, *end = a->data + a->hi;
+    Rect *block = (Rect *)malloc(STREAM_BLOCK_LINES * sizeof(Rect));
+    int *mark = (int *)malloc((size_t)a->numSlices * sizeof(int));
+    if (!block || !mark) {
+        perror("Unable to allocate parse block");
+        exit(EXIT_FAILURE);
+    }
+    while (p < end) {
+        // Parse one block, then scatter it into the slice buckets
+        int n = 0, ok;
+        while (p < end && n < STREAM_BLOCK_LINES) {
+            p = parseRectLine(p, end, &block[n], &ok);
+            n += ok;
+        }
+        for (int s = 0; s < a->numSlices; s++) mark[s] = a->buckets[s].count;
+        for (int i = 0; i < n; i++)
+            bucketPush(&a->buckets[sliceOf(a->bounds, a->numSlices, block[i])], block[i]);
+        // What this block added to each slice becomes one sorted run
+        for (int s = 0; s < a->numSlices; s++) {
+            StreamBucket *b = &a->buckets[s];
+            if (b->count == mark[s]) continue;
+            qsort(b->rects + mark[s], (size_t)(b->count - mark[s]), sizeof(Rect), compareByYCenter);
+            bucketAddRun(b, mark[s]);
+        }
+        a->parsed += n;
+    }
+    free(mark);
+    free(block);
+    // Seal in the order the packers claim the slices
+    PackArgs *pk = a->pack;
+    for (int s = 0; s < a->numSlices; s++) {
+        pthread_mutex_lock(&pk->sealLock);
+        if (--pk->pending[s] == 0) pthread_cond_broadcast(&pk->sealed);
+        pthread_mutex_unlock(&pk->sealLock);
+    }
+    pthread_mutex_lock(&pk->sealLock);
+    if (--pk->parsing == 0) pk->parseDone = nowSeconds();
+    pthread_mutex_unlock(&pk->sealLock);
+    return pack_worker(pk);
+}
+
+static void *pack_worker(void *arg)
+{
+    PackArgs *a = (PackArgs *)arg;
+    RunCursor *heap = NULL;
+    int heapCap = 0;
+    for (;;) {
+        int s = atomic_fetch_add(&a->nextSlice, 1);
+        if (s >= a->numSlices) break;
+        pthread_mutex_lock(&a->sealLock);
+        while (a->pending[s] > 0) pthread_cond_wait(&a->sealed, &a->sealLock);
+        pthread_mutex_unlock(&a->sealLock);
+
+        int total = 0, runs = 0;
+        for (int t = 0; t < a->numParsers; t++) {
+            total += a->buckets[t * a->numSlices + s].count;
+            runs += a->buckets[t * a->numSlices + s].numRuns;
+        }
+        a->sliceLeafCount[s] = 0;
+        if (total == 0) continue;
+
+        // k-way merge of the runs of every parser, each in Y-center order
+        if (runs > heapCap) {
+            heapCap = runs;
+            free(heap);
+            heap = (RunCursor *)malloc((size_t)heapCap * sizeof(RunCursor));
+        }
+        Rect *slice = (Rect *)malloc((size_t)total * sizeof(Rect));
+        if (!heap || !slice) {
+            perror("Unable to allocate slice");
+            exit(EXIT_FAILURE);
+        }
+        int n = 0;
+        for (int t = 0; t < a->numParsers; t++) {
+            const StreamBucket *b = &a->buckets[t * a->numSlices + s];
+            for (int r = 0; r < b->numRuns; r++) {
+                heap[n].next = b->rects + b->runStart[r];
+                heap[n].end = b->rects + (r + 1 < b->numRuns ? b->runStart[r + 1] : b->count);
+                n++;
+            }
+        }
+        for (int i = n / 2 - 1; i >= 0; i--) runSiftDown(heap, n, i);
+        for (int k = 0; k < total; k++) {
+            slice[k] = *heap[0].next++;
+            if (heap[0].next == heap[0].end) heap[0] = heap[--n];
+            runSiftDown(heap, n, 0);
+        }
+
+        int nl = (total + BUNDLEFACTOR - 1) / BUNDLEFACTOR;
+        Node **leaves = (Node **)malloc((size_t)nl * sizeof(Node *));
+        for (int l = 0; l < nl; l++) {
+            int lo = l * BUNDLEFACTOR;
+            int hi = lo + BUNDLEFACTOR - 1 < total - 1 ? lo + BUNDLEFACTOR - 1 : total - 1;
+            leaves[l] = createLeaf_STR(slice, lo, hi);
+        }
+        free(slice);
+        a->sliceLeaves[s] = leaves;
+        a->sliceLeafCount[s] = nl;
+    }
+    free(heap);
+    return NULL;
+}
+
+static void *query_load_worker(void *arg)
+{
+    QueryLoadArgs *a = (QueryLoadArgs *)arg;
+    double t0 = nowSeconds();
+    a->queries = readRectsFromFile(a->path, &a->numQuery);
+    if (a->queries) Zsorting(a->queries, a->numQuery);
+    a->seconds = nowSeconds() - t0;
+    return NULL;
+}
+
+// Build the tree from dataPath while loading and Z-sorting the queries from
+// queryPath. Returns 0 on success.
+int streamLoad(const char *dataPath, const char *queryPath, int numThreads, StreamLoad *out)
+{
+    memset(out, 0, sizeof(*out));
+    double t0 = nowSeconds();
+    if (numThreads < 1) numThreads = 1;
+
+    QueryLoadArgs qa = {.path = queryPath};
+    pthread_t queryThread;
+    pthread_create(&queryThread, NULL, query_load_worker, &qa);
+
+    int fd = open(dataPath, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        perror("Unable to open data file for streaming");
+        if (fd >= 0) close(fd);
+        pthread_join(queryThread, NULL);
+        free(qa.queries);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    const char *data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Unable to map data file");
+        pthread_join(queryThread, NULL);
+        free(qa.queries);
+        return -1;
+    }
+    posix_madvise((void *)data, size, POSIX_MADV_SEQUENTIAL);
+
+    // Sample lines for the rect count and the slice cut points
+    int *centers = (int *)malloc(STREAM_SAMPLES * sizeof(int));
+    int ns = 0;
+    size_t sampledBytes = 0;
+    for (int i = 0; i < STREAM_SAMPLES; i++) {
+        size_t pos = nextLineStart(data, size, (size_t)((double)size * i / STREAM_SAMPLES));
+        if (pos >= size) continue;
+        Rect r;
+        int ok;
+        const char *nextLine = parseRectLine(data + pos, data + size, &r, &ok);
+        if (!ok) continue;
+        sampledBytes += (size_t)(nextLine - (data + pos));
+        centers[ns++] = (r.xmin + r.xmax) / 2;
+    }
+    double estRects = ns ? (double)size / ((double)sampledBytes / ns) : 1;
+    int numSlices = (int)ceil(sqrt(estRects / BUNDLEFACTOR));
+    if (numSlices < 1) numSlices = 1;
+    if (numSlices > ns) numSlices = ns > 0 ? ns : 1;
+    qsort(centers, (size_t)ns, sizeof(int), cmpInt);
+    int *bounds = (int *)malloc((size_t)numSlices * sizeof(int));
+    for (int s = 0; s + 1 < numSlices; s++)
+        bounds[s] = centers[(long long)(s + 1) * ns / numSlices];
+    free(centers);
+
+    // Parse in parallel into per-thread slice buckets; each thread then
+    // packs sealed slices until none are left
+    double t1 = nowSeconds();
+    pthread_t threads[numThreads];
+    ParseArgs pargs[numThreads];
+    StreamBucket *buckets = (StreamBucket *)calloc((size_t)numThreads * numSlices, sizeof(StreamBucket));
+    PackArgs pk = {
+        .buckets = buckets, .numParsers = numThreads, .numSlices = numSlices,
+        .sliceLeaves = (Node ***)calloc((size_t)numSlices, sizeof(Node **)),
+        .sliceLeafCount = (int *)calloc((size_t)numSlices, sizeof(int)),
+        .pending = (int *)malloc((size_t)numSlices * sizeof(int)),
+        .parsing = numThreads};
+    if (!bounds || !buckets || !pk.sliceLeaves || !pk.sliceLeafCount || !pk.pending) {
+        perror("Unable to allocate slice buckets");
+        exit(EXIT_FAILURE);
+    }
+    for (int s = 0; s < numSlices; s++) pk.pending[s] = numThreads;
+    atomic_init(&pk.nextSlice, 0);
+    pthread_mutex_init(&pk.sealLock, NULL);
+    pthread_cond_init(&pk.sealed, NULL);
+    for (int t = 0; t < numThreads; t++) {
+        pargs[t] = (ParseArgs){
+            .data = data,
+            .lo = nextLineStart(data, size, size * t / numThreads),
+            .hi = nextLineStart(data, size, size * (t + 1) / numThreads),
+            .bounds = bounds,
+            .numSlices = numSlices,
+            .buckets = buckets + (size_t)t * numSlices,
+            .pack = &pk};
+        pthread_create(&threads[t], NULL, parse_worker, &pargs[t]);
+    }
+    long long numRects = 0;
+    for (int t = 0; t < numThreads; t++) {
+        pthread_join(threads[t], NULL);
+        numRects += pargs[t].parsed;
+    }
+    munmap((void *)data, size);
+    free(bounds);
+    pthread_mutex_destroy(&pk.sealLock);
+    pthread_cond_destroy(&pk.sealed);
+    free(pk.pending);
+    out->parseSeconds = pk.parseDone - t1;
+
+    int numLeaves = 0;
+    for (int s = 0; s < numSlices; s++) numLeaves += pk.sliceLeafCount[s];
+    Node **leaves = (Node **)malloc((size_t)(numLeaves > 0 ? numLeaves : 1) * sizeof(Node *));
+    int L = 0;
+    for (int s = 0; s < numSlices; s++) {
+        for (int l = 0; l < pk.sliceLeafCount[s]; l++) leaves[L++] = pk.sliceLeaves[s][l];
+        free(pk.sliceLeaves[s]);
+    }
+    out->root = group_nodes_STR(leaves, L, FANOUT);
+    free(leaves);
+    free(pk.sliceLeaves);
+    free(pk.sliceLeafCount);
+    for (size_t b = 0; b < (size_t)numThreads * numSlices; b++) {
+        free(buckets[b].rects);
+        free(buckets[b].runStart);
+    }
+    free(buckets);
+    out->packSeconds = nowSeconds() - pk.parseDone;
+    out->treeSeconds = nowSeconds() - t0;
+    out->numRects = (int)numRects;
+
+    pthread_join(queryThread, NULL);
+    out->queries = qa.queries;
+    out->numQuery = qa.numQuery;
+    out->querySeconds = qa.seconds;
+    out->totalSeconds = nowSeconds() - t0;
+    return qa.queries ? 0 : -1;
+}
+
+// Time to first query: today's sequential startup against streamLoad, on the
+// same files; both trees must answer the whole query set alike.
+void streamLoadBenchmark(const char *dataPath, const char *queryPath, int numThreads)
+{
+    printf("\n=== Startup: sequential vs pipelined load (time to first query) ===\n");
+
+    double t0 = nowSeconds();
+    int numRects = 0, numQuery = 0;
+    Rect *rects = readRectsFromFile(dataPath, &numRects);
+    double tRead = nowSeconds();
+    Node *root = rects ? createRTree_STR_2(rects, 0, numRects - 1) : NULL;
+    double tBuild = nowSeconds();
+    Rect *queries = readRectsFromFile(queryPath, &numQuery);
+    if (!rects || !queries) {
+        printf("Unable to read %s or %s\n", dataPath, queryPath);
+        free(rects);
+        free(queries);
+        freeRTree(root);
+        return;
+    }
+    Zsorting(queries, numQuery);
+    volatile int first = searchRTree(root, queries[0], 0);
+    double seqTotal = nowSeconds() - t0;
+    printf("Sequential : read %.3f s, build %.3f s, queries %.3f s -> first query at %.3f s\n",
+           tRead - t0, tBuild - tRead, seqTotal - (tBuild - t0), seqTotal);
+
+    StreamLoad sl;
+    t0 = nowSeconds();
+    if (streamLoad(dataPath, queryPath, numThreads, &sl) != 0) {
+        free(rects);
+        free(queries);
+        freeRTree(root);
+        return;
+    }
+    first = searchRTree(sl.root, sl.queries[0], 0);
+    double pipeTotal = nowSeconds() - t0;
+    (void)first;
+    printf("Pipelined  : parse %.3f s, merge+pack after parse %.3f s, tree ready %.3f s, queries %.3f s (overlapped)"
+           " -> first query at %.3f s (%.2fx)\n",
+           sl.parseSeconds, sl.packSeconds, sl.treeSeconds, sl.querySeconds, pipeTotal, seqTotal / pipeTotal);
+
+    long long a = 0, b = 0;
+    for (int i = 0; i < numQuery; i++) a += searchRTree(root, queries[i], i);
+    for (int i = 0; i < sl.numQuery; i++) b += searchRTree(sl.root, sl.queries[i], i);
+    if (a == b && sl.numRects == numRects)
+        printf("✅ Pipelined tree (%d rects) gives the same totals as the sequential one.\n", sl.numRects);
+    else
+        printf("❌ Pipelined tree: %d rects, %lld overlaps; sequential: %d rects, %lld overlaps\n",
+               sl.numRects, b, numRects, a);
+
+    freeRTree(root);
+    freeRTree(sl.root);
+    free(rects);
+    free(queries);
+    free(sl.queries);
+}
@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "rtree.h"
+
+// ---------------- Continuous viewport queries ----------------
+//
+// A ViewportSession remembers the last window it answered and its count.
+// For the next window N after P:
+//
+//   count(N) = count(P) + #{r : r meets N, not P} - #{r : r meets P, not N}
+//
+// A rect that meets A but not B meets A minus B, which is at most four
+// strips, so each difference term is a traversal that only enters nodes
+// overlapping a strip. Nodes and mini-pages inside the other window are
+// skipped too, since all their rects meet it. The difference walks still
+// cross every leaf on the window border, so they only pay off for windows
+// of several leaves that moved a little: otherwise (window under
+// VIEWPORT_MIN_LEAVES mean leaf areas, or strips over VIEWPORT_MAX_CHANGE
+// of its area) the session runs a full query. The tree must not change
+// while a session is open; resetViewportSession drops the previous window.
+
+#define VIEWPORT_MIN_LEAVES 4.0   // smallest window, in mean leaf areas, answered incrementally
+#define VIEWPORT_MAX_CHANGE 0.25  // largest changed area, as a share of the window
+
+// Strips of a minus b (closed integer rects); returns how many
+static int windowMinus(Rect a, Rect b, Rect *out)
+{
+    if (!isOverlap_inline(&a, b)) {
+        out[0] = a;
+        return 1;
+    }
+    Rect c = {a.xmin > b.xmin ? a.xmin : b.xmin, a.ymin > b.ymin ? a.ymin : b.ymin,
+              a.xmax < b.xmax ? a.xmax : b.xmax, a.ymax < b.ymax ? a.ymax : b.ymax};
+    int n = 0;
+    if (c.xmin > a.xmin) out[n++] = (Rect){a.xmin, a.ymin, c.xmin - 1, a.ymax};
+    if (c.xmax < a.xmax) out[n++] = (Rect){c.xmax + 1, a.ymin, a.xmax, a.ymax};
+    if (c.ymin > a.ymin) out[n++] = (Rect){c.xmin, a.ymin, c.xmax, c.ymin - 1};
+    if (c.ymax < a.ymax) out[n++] = (Rect){c.xmin, c.ymax + 1, c.xmax, a.ymax};
+    return n;
+}
+
+static double windowArea(Rect r)
+{
+    return ((double)r.xmax - r.xmin + 1) * ((double)r.ymax - r.ymin + 1);
+}
+
+static inline int insideWindow(const MBR *m, Rect w)
+{
+    return m->xmin >= w.xmin && m->xmax <= w.xmax && m->ymin >= w.ymin && m->ymax <= w.ymax;
+}
+
+static int meetsStrips(const MBR *m, const Rect *strips, int ns)
+{
+    for (int i = 0; i < ns; i++)
+        if (isOverlap_inline(m, strips[i])) return 1;
+    return 0;
+}
+
+// Rects below n that overlap a but not b; `strips` is a minus b and `box`
+// their bounding box. Everything inside b overlaps b, so boxes inside b
+// are skipped like boxes that miss the strips.
+static int countMinus(const Node *n, Rect a, Rect b, const Rect *strips, int ns, Rect box)
+{
+    if (!isOverlap_inline(&n->mbr, box) || insideWindow(&n->mbr, b) || !meetsStrips(&n->mbr, strips, ns))
+        return 0;
+    int count = 0;
+    if (!n->isLeaf) {
+        for (int i = 0; i < n->count; i++) count += countMinus(n->children[i], a, b, strips, ns, box);
+        return count;
+    }
+    if (n->isLeaf != LEAF_SORTED) {
+        for (int i = 0; i < n->count; i++)
+            if (isOverlap_inline(&n->rects[i], a) && !isOverlap_inline(&n->rects[i], b)) count++;
+        return count;
+    }
+    const MBR *pages = (const MBR *)(n->rects + n->count);
+    for (int first = 0, p = 0; first < n->count; first += LEAF_PAGE, p++) {
+        if (pages[p].ymin > box.ymax) break;
+        if (!isOverlap_inline(&pages[p], box) || insideWindow(&pages[p], b) ||
+            !meetsStrips(&pages[p], strips, ns))
+            continue;
+        int end = first + LEAF_PAGE < n->count ? first + LEAF_PAGE : n->count;
+        for (int i = first; i < end; i++) {
+            const Rect *r = &n->rects[i];
+            if (r->ymin > box.ymax) return count;
+            if (isOverlap_inline(r, a) && !isOverlap_inline(r, b)) count++;
+        }
+    }
+    return count;
+}
+
+static int countWindowMinus(const Node *root, Rect a, Rect b)
+{
+    Rect strips[4];
+    int ns = windowMinus(a, b, strips);
+    if (ns == 0) return 0;
+    Rect box = strips[0];
+    for (int i = 1; i < ns; i++) box = unionJoin(&box, &strips[i]);
+    return countMinus(root, a, b, strips, ns, box);
+}
+
+static void sumLeafArea(const Node *n, double *sum, int *leaves)
+{
+    if (!n) return;
+    if (n->isLeaf) {
+        *sum += windowArea(n->mbr);
+        (*leaves)++;
+        return;
+    }
+    for (int i = 0; i < n->count; i++) sumLeafArea(n->children[i], sum, leaves);
+}
+
+ViewportSession *createViewportSession(Node *root)
+{
+    ViewportSession *s = (ViewportSession *)calloc(1, sizeof(ViewportSession));
+    if (!s) {
+        perror("Unable to allocate viewport session");
+        exit(EXIT_FAILURE);
+    }
+    s->root = root;
+    double sum = 0;
+    int leaves = 0;
+    sumLeafArea(root, &sum, &leaves);
+    s->leafArea = leaves ? sum / leaves : 0;
+    return s;
+}
+
+int viewportQuery(ViewportSession *s, Rect window)
+{
+    s->queries++;
+    if (!s->root) return 0;
+    double changed = 0;
+    if (s->valid) {
+        Rect c = {window.xmin > s->window.xmin ? window.xmin : s->window.xmin,
+                  window.ymin > s->window.ymin ? window.ymin : s->window.ymin,
+                  window.xmax < s->window.xmax ? window.xmax : s->window.xmax,
+                  window.ymax < s->window.ymax ? window.ymax : s->window.ymax};
+        double common = isOverlap_inline(&window, s->window) ? windowArea(c) : 0;
+        changed = windowArea(window) + windowArea(s->window) - 2 * common;
+    }
+    if (s->valid && windowArea(window) >= VIEWPORT_MIN_LEAVES * s->leafArea &&
+        changed < VIEWPORT_MAX_CHANGE * windowArea(window)) {
+        s->count += countWindowMinus(s->root, window, s->window) - countWindowMinus(s->root, s->window, window);
+        s->incremental++;
+    } else {
+        s->count = searchRTree(s->root, window, 0);
+    }
+    s->window = window;
+    s->valid = 1;
+    return s->count;
+}
+
+// Forget the previous window, e.g. after the tree was replaced
+void resetViewportSession(ViewportSession *s, Node *root)
+{
+    s->root = root;
+    s->valid = 0;
+}
+
+void freeViewportSession(ViewportSession *s)
+{
+    free(s);
+}
+
+// ---- benchmark ----
+
+#define VIEWPORT_CHAINS 200
+#define VIEWPORT_STEPS 50
+
+// Pan chains: each starts at a query window and moves it by `step` of its
+// width and height per move, in a random direction.
+static Rect *makePanChains(const Rect *queries, int numQuery, double step, int *outCount)
+{
+    int n = VIEWPORT_CHAINS * VIEWPORT_STEPS;
+    Rect *w = (Rect *)malloc((size_t)n * sizeof(Rect));
+    if (!w) {
+        perror("Unable to allocate viewport windows");
+        exit(EXIT_FAILURE);
+    }
+    unsigned int seed = 44u;
+    for (int c = 0; c < VIEWPORT_CHAINS; c++) {
+        Rect r = queries[(long long)c * numQuery / VIEWPORT_CHAINS];
+        int dx = (int)((r.xmax - r.xmin) * step) + 1, dy = (int)((r.ymax - r.ymin) * step) + 1;
+        for (int k = 0; k < VIEWPORT_STEPS; k++) {
+            w[c * VIEWPORT_STEPS + k] = r;
+            seed = seed * 1103515245u + 12345u;
+            int sx = (int)((seed >> 16) % 3) - 1, sy = (int)((seed >> 20) % 3) - 1;
+            r.xmin += sx * dx;
+            r.xmax += sx * dx;
+            r.ymin += sy * dy;
+            r.ymax += sy * dy;
+        }
+    }
+    *outCount = n;
+    return w;
+}
+
+// Pan chains at several step sizes, then the query set itself as one
+// session, each checked against full searchRTree counts.
+void viewportBenchmark(Node *root, const Rect *queries, int numQuery, const int *exact)
+{
+    static const double steps[] = {0.01, 0.05, 0.20, 0.50};
+    if (numQuery <= 0) return;
+    int ok = 1;
+
+    printf("\n[Viewport sessions] %d chains of %d windows, single thread\n", VIEWPORT_CHAINS, VIEWPORT_STEPS);
+    printf("%8s %12s %12s %9s %12s\n", "pan", "full (s)", "session (s)", "speedup", "incremental");
+    for (int k = 0; k < (int)(sizeof(steps) / sizeof(steps[0])); k++) {
+        int n;
+        Rect *w = makePanChains(queries, numQuery, steps[k], &n);
+        int *full = (int *)malloc((size_t)n * sizeof(int));
+        if (!full) {
+            perror("Unable to allocate viewport results");
+            exit(EXIT_FAILURE);
+        }
+        double t0 = nowSeconds();
+        for (int i = 0; i < n; i++) full[i] = searchRTree(root, w[i], i);
+        double fullTime = nowSeconds() - t0;
+
+        long long incremental = 0;
+        t0 = nowSeconds();
+        for (int c = 0; c < VIEWPORT_CHAINS; c++) {
+            ViewportSession *s = createViewportSession(root);
+            for (int i = c * VIEWPORT_STEPS; i < (c + 1) * VIEWPORT_STEPS; i++)
+                ok &= viewportQuery(s, w[i]) == full[i];
+            incremental += s->incremental;
+            freeViewportSession(s);
+        }
+        double sessionTime = nowSeconds() - t0;
+        printf("%7.0f%% %12.4f %12.4f %8.2fx %11.1f%%\n", steps[k] * 100, fullTime, sessionTime,
+               sessionTime > 0 ? fullTime / sessionTime : 0.0, 100.0 * incremental / n);
+        free(full);
+        free(w);
+    }
+
+    // Consecutive queries of the (Z-sorted) query set
+    ViewportSession *s = createViewportSession(root);
+    double t0 = nowSeconds();
+    for (int i = 0; i < numQuery; i++) ok &= viewportQuery(s, queries[i]) == exact[i];
+    double streamTime = nowSeconds() - t0;
+    printf("Query set as one session: %.4f s, %.1f%% of windows answered incrementally\n", streamTime,
+           100.0 * s->incremental / numQuery);
+    freeViewportSession(s);
+    printf("%s Viewport results %s the full queries\n", ok ? "✅" : "❌", ok ? "match" : "do NOT match");
+}